@@ -0,0 +1,19 @@
+#!/bin/bash
+# Fetches the robots.txt of every host in robots_hosts.txt into a directory, to have a real
+# world corpus for robots_bench and robots_compare.sh
+#
+# Usage: fetch_robots.sh [hosts file] [directory]
+
+HOSTS=${1:-$(dirname "$0")/robots_hosts.txt}
+DIR=${2:-robots_corpus}
+
+mkdir -p "$DIR"
+grep -v '^#' "$HOSTS" | while read host; do
+    [ -n "$host" ] || continue
+    if curl -sfL --max-time 20 -A 'mycelium' -o "$DIR/$host.txt" "http://$host/robots.txt"; then
+        echo "$host: $(wc -c < "$DIR/$host.txt") bytes"
+    else
+        echo "$host: failed" >&2
+        rm -f "$DIR/$host.txt"
+    fi
+done
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @brief HTML lexing throughput benchmark
+ *
+ * Usage: html_lex_bench [-n passes] [file.html ...]
+ *
+ * Lexes the files given, or a generated page with text, links, entities and scripts, and reports
+ * MB/s for the stream interface (istringstream in, ostringstreams out, as html_lex used to be) and
+ * for html_lex, which reads the buffer through a streambuf instead of copying the whole document
+ * into an istringstream and appends the output to the result. flex still copies each chunk it
+ * reads into its own buffer.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "HTML_lexer.hh"
+#include "timer.hh"
+
+using namespace std;
+
+namespace {
+    const string BASE_URL = "http://www.example.com/news/index.html";
+
+    string generated_page()
+    {
+        ostringstream os;
+        os << "<!DOCTYPE html>\n<html><head><title>Benchmark page &amp; friends</title>\n"
+            << "<meta http-equiv=\"Content-Type\" content=\"text/html; charset=utf-8\">\n"
+            << "<link rel=\"alternate\" type=\"application/rss+xml\" href=\"/feed.xml\">\n"
+            << "<script type=\"text/javascript\">var a = 1 < 2; document.write('<b>x</b>');</script>\n"
+            << "<style>body { margin: 0 }</style></head>\n<body>\n";
+        for (int i = 0; i < 200; ++i) {
+            os << "<div class=\"item\"><h1>Article number " << i << "</h1>\n"
+                << "<p>Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor "
+                << "incididunt ut labore et dolore magna aliqua &mdash; caf&eacute; cr&egrave;me &#8364;10.</p>\n"
+                << "<p>See <a href=\"../article/" << i << ".html?ref=home&amp;page=2\">the full story</a> or "
+                << "<a href=\"http://other.example.org/" << i << "\" rel=\"nofollow\">elsewhere</a>.</p>\n"
+                << "<!-- comment " << i << " --><img src=\"/img/" << i << ".png\" alt=\"picture\"><br/>\n"
+                << "<table><tr><td>cell</td><td>another cell</td></tr></table></div>\n";
+        }
+        os << "</body></html>\n";
+        return os.str();
+    }
+
+    size_t lex_streams(const string& html)
+    {
+        istringstream in(html);
+        ostringstream txt;
+        ostringstream lnk;
+        ostringstream warn;
+        Analysis analysis;
+        HTML_lexer lexer(&in, &txt, &BASE_URL, &lnk, &warn, &analysis, false);
+        lexer.yylex();
+        return txt.str().size() + lnk.str().size();
+    }
+
+    size_t lex_buffer(const string& html)
+    {
+        ProcHTML result = html_lex(html, BASE_URL);
+        return result.text.size() + result.links.size();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t passes = 200;
+    vector<string> docs;
+    for (int i = 1; i < argc; ++i) {
+        if (! strcmp(argv[i], "-n") && i + 1 < argc) {
+            passes = strtoul(argv[++i], 0, 10);
+        } else {
+            ifstream f(argv[i], ios::binary);
+            if (! f) {
+                cerr << "can't open " << argv[i] << endl;
+                return EXIT_FAILURE;
+            }
+            ostringstream os;
+            os << f.rdbuf();
+            docs.push_back(os.str());
+        }
+    }
+    if (docs.empty())
+        docs.push_back(generated_page());
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < docs.size(); ++i)
+        bytes += docs[i].size();
+    const double mb = static_cast<double>(bytes) * passes / (1024 * 1024);
+
+    size_t out_streams = 0;
+    utils::timer t0 = utils::timer::current();
+    for (size_t p = 0; p < passes; ++p)
+        for (size_t i = 0; i < docs.size(); ++i)
+            out_streams += lex_streams(docs[i]);
+    utils::timer t1 = utils::timer::current();
+    size_t out_buffer = 0;
+    for (size_t p = 0; p < passes; ++p)
+        for (size_t i = 0; i < docs.size(); ++i)
+            out_buffer += lex_buffer(docs[i]);
+    utils::timer t2 = utils::timer::current();
+
+    cout << "documents: " << docs.size() << " bytes: " << bytes << " passes: " << passes << endl;
+    cout << "streams: " << mb / ((t1 - t0).usec() / 1e6) << " MB/s (" << out_streams << " bytes out)" << endl;
+    cout << "buffer:  " << mb / ((t2 - t1).usec() / 1e6) << " MB/s (" << out_buffer << " bytes out)" << endl;
+    return EXIT_SUCCESS;
+}
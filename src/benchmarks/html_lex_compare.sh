@@ -0,0 +1,46 @@
+#!/bin/bash
+# Runs html_lex_bench on the same documents with the lexer of the tree and with the lexer as it
+# was before html_lex lexed in-memory documents into a Lex_sink, both built here with the same flags
+#
+# Usage: html_lex_compare.sh [-n passes] [file.html ...]
+# Needs flex and git. The "streams" line of each run is the stream interface, the "buffer" one html_lex.
+set -e
+
+TOP=$(cd "$(dirname "$0")" && git rev-parse --show-toplevel)
+# the lexer is in the parent of the commit that added the benchmark
+OLD=$(git -C "$TOP" rev-list --reverse HEAD -- src/benchmarks/html_lex_bench.cc | head -n 1)^
+CXX=${CXX:-g++}
+# the older sources use the TRUE of ICU before 68
+CXXFLAGS="-std=c++0x -O3 -march=native -DNDEBUG -DU_DEFINE_FALSE_AND_TRUE=1 -w"
+LIBS="-lboost_thread -lboost_system -lboost_regex -licuuc -lz -lpthread"
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# build src out: html_lex_bench against the common and html_lexer sources of src
+build()
+{
+    local src=$1 out=$2
+    local inc="-I$src/common -I$src/crawler -I$src/html_lexer"
+    mkdir -p "$out"
+    flex -Cf --outfile="$out/HTML_flex_lexer.cc" "$src/html_lexer/html.ll"
+    for f in "$src"/common/*.cc "$src"/html_lexer/*.cc "$out/HTML_flex_lexer.cc"; do
+        [ "$(basename "$f")" != common_python.cc ] || continue
+        $CXX $CXXFLAGS $inc -c "$f" -o "$out/$(basename "$f" .cc).o"
+    done
+    ar rcs "$out/libcommon.a" "$out"/*.o
+    $CXX $CXXFLAGS $inc "$TOP/src/benchmarks/html_lex_bench.cc" "$out/libcommon.a" $LIBS -o "$out/html_lex_bench"
+}
+
+echo "building the lexer of $(git -C "$TOP" rev-parse --short "$OLD")"
+mkdir -p "$WORK/old"
+git -C "$TOP" archive "$OLD" src | tar -x -C "$WORK/old"
+build "$WORK/old/src" "$WORK/old/obj"
+
+echo "building the lexer of the tree"
+build "$TOP/src" "$WORK/new/obj"
+
+echo "== before"
+"$WORK/old/obj/html_lex_bench" "$@"
+echo "== tree"
+"$WORK/new/obj/html_lex_bench" "$@"
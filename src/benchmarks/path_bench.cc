@@ -0,0 +1,94 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @brief relative reference resolution benchmark
+ *
+ * Usage: path_bench [-n references] [base url]
+ *
+ * Resolves references against a base as HTML_lexer::link_add does with the links of a page:
+ * parse, normalize, merge with the base and serialize. The references are a fixed mix of the
+ * kinds found in pages, with dot segments, queries and fragments.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Url.hh"
+#include "timer.hh"
+
+using namespace std;
+
+namespace {
+    const char* const REFS[] = {
+        "page.html",
+        "../images/logo.png",
+        "./section/index.html?lang=en",
+        "/about/team/",
+        "../../archive/2012/05/article-name.html#comments",
+        "sub/dir/./../file.php?id=42&sort=asc",
+        "?page=2",
+        "#top",
+        "../..",
+        "a/b/c/d/e/f/../../../g.html",
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = 1000000;
+    string base_s = "http://www.example.com/news/world/europe/2012/index.html?edition=int";
+    for (int i = 1; i < argc; ++i) {
+        if (! strcmp(argv[i], "-n") && i + 1 < argc)
+            n = strtoul(argv[++i], 0, 10);
+        else
+            base_s = argv[i];
+    }
+
+    Url base;
+    try {
+        base.assign(base_s);
+        base.normalize();
+    } catch (BadUrl& e) {
+        cerr << "bad base url " << base_s << ": " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    const size_t nrefs = sizeof(REFS) / sizeof(REFS[0]);
+    vector<Url> refs;
+    for (size_t i = 0; i < nrefs; ++i) {
+        refs.push_back(Url(REFS[i]));
+        refs.back().normalize();
+    }
+
+    size_t bytes = 0;
+    utils::timer t0 = utils::timer::current();
+    for (size_t i = 0; i < n; ++i) {
+        Url ref(REFS[i % nrefs]);
+        ref.normalize();
+        Url full = base;
+        full.merge_ref(ref);
+        bytes += full.get().size();
+    }
+    utils::timer t1 = utils::timer::current();
+    for (size_t i = 0; i < n; ++i) {
+        Url full = base;
+        full.merge_ref(refs[i % nrefs]);
+        full.normalize();
+        bytes += full.get().size();
+    }
+    utils::timer t2 = utils::timer::current();
+
+    cout << "base: " << base.get() << " references: " << n << endl;
+    cout << "parse + normalize + merge: " << (t1 - t0).usec() * 1000.0 / n << " ns/ref" << endl;
+    cout << "merge + normalize: " << (t2 - t1).usec() * 1000.0 / n << " ns/ref (" << bytes << " bytes)" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @brief robots.txt parsing and matching benchmark
+ *
+ * Usage: robots_bench [-n iterations] robots.txt...
+ *
+ * Every file of the corpus is loaded in memory and then parsed, compiled for the crawler user
+ * agent and matched against the paths that appear in its own rules, iterations times.
+ *
+ * Built with ROBOTS_FLEX it drives the flex scanner that parsed robots.txt before, through its
+ * istream interface, robots_compare.sh builds both and runs them on the same corpus.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Robots.hh"
+#include "timer.hh"
+
+using namespace std;
+
+namespace {
+    const char USER_AGENT[] = "mycelium";
+
+    /// paths to check for a robots.txt: "/" and the literal part of its rules
+    void paths(const string& content, vector<string>& res)
+    {
+        res.push_back("/");
+        string::size_type pos = 0;
+        while ((pos = content.find("llow:", pos)) != string::npos) {
+            pos += 5;
+            string::size_type b = content.find_first_not_of(" \t", pos);
+            if (b == string::npos)
+                break;
+            string::size_type e = content.find_first_of("*$# \t\r\n", b);
+            if (e == string::npos)
+                e = content.size();
+            if (e > b && content[b] == '/')
+                res.push_back(content.substr(b, e - b) + "index.html");
+        }
+    }
+
+    double mbs(size_t bytes, const utils::timer& t)
+    {
+        return t.usec() ? bytes / (t.usec() / 1e6) / (1 << 20) : 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t iterations = 100;
+    vector<string> corpus;
+    for (int i = 1; i < argc; ++i) {
+        if (! strcmp(argv[i], "-n") && i + 1 < argc) {
+            iterations = strtoul(argv[++i], 0, 10);
+            continue;
+        }
+        ifstream f(argv[i], ios::binary);
+        if (! f) {
+            cerr << "can't open " << argv[i] << endl;
+            return EXIT_FAILURE;
+        }
+        corpus.push_back(string((istreambuf_iterator<char>(f)), istreambuf_iterator<char>()));
+    }
+    if (corpus.empty()) {
+        cerr << "usage: " << argv[0] << " [-n iterations] robots.txt..." << endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t bytes = 0;
+    vector<vector<string> > corpus_paths(corpus.size());
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        bytes += corpus[i].size();
+        paths(corpus[i], corpus_paths[i]);
+    }
+
+    size_t rules = 0;
+    utils::timer parse_t(0);
+    utils::timer compile_t(0);
+    utils::timer match_t(0);
+    size_t checks = 0;
+    size_t allowed = 0;
+    for (size_t it = 0; it < iterations; ++it) {
+        for (size_t i = 0; i < corpus.size(); ++i) {
+            utils::timer t0 = utils::timer::current();
+#ifdef ROBOTS_FLEX
+            istringstream in(corpus[i]);
+            robots::Robots r(&in);
+            r.yylex();
+#else
+            robots::Robots r;
+            r.parse(corpus[i]);
+#endif
+            utils::timer t1 = utils::timer::current();
+            r.compile(USER_AGENT);
+            utils::timer t2 = utils::timer::current();
+            const vector<string>& p = corpus_paths[i];
+            for (vector<string>::const_iterator j = p.begin(); j != p.end(); ++j)
+                allowed += r.allowed(*j);
+            utils::timer t3 = utils::timer::current();
+
+            parse_t += t1 - t0;
+            compile_t += t2 - t1;
+            match_t += t3 - t2;
+            checks += p.size();
+            if (! it)
+                rules += p.size() - 1;
+        }
+    }
+
+    cout << "files: " << corpus.size() << " bytes: " << bytes << " rules: " << rules << " iterations: " << iterations << endl;
+    cout << "parse: " << mbs(bytes * iterations, parse_t) << " MB/s" << endl;
+    cout << "parse + compile: " << mbs(bytes * iterations, parse_t + compile_t) << " MB/s" << endl;
+    cout << "match: " << (checks ? match_t.usec() * 1000.0 / checks : 0) << " ns/url (" << allowed << " of " << checks << " allowed)" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,52 @@
+#!/bin/bash
+# Runs robots_bench on the same corpus with the robots.txt scanner of the tree and with the flex
+# scanner it replaced, both built here with the same flags
+#
+# Usage: robots_compare.sh [-n iterations] robots.txt...
+# Needs flex and git, fetch_robots.sh makes a corpus.
+set -e
+
+if ! command -v flex > /dev/null; then
+    echo "robots_compare.sh: flex is needed to build the scanner it compares against" >&2
+    exit 1
+fi
+
+TOP=$(cd "$(dirname "$0")" && git rev-parse --show-toplevel)
+# the flex scanner is in the parent of the commit that removed it
+OLD=$(git -C "$TOP" rev-list -n 1 HEAD -- src/crawler/robots.ll)^
+CXX=${CXX:-g++}
+CXXFLAGS="-std=c++0x -O3 -march=native -DNDEBUG -w"
+LIBS="-lboost_regex -lboost_system -licuuc -lz -lpthread"
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# build src out [flags and sources]: robots_bench against the common sources of src
+build()
+{
+    local src=$1 out=$2
+    shift 2
+    local inc="-I$src/common -I$src/crawler -I$src/html_lexer"
+    mkdir -p "$out"
+    for f in "$src"/common/*.cc; do
+        [ "$(basename "$f")" != common_python.cc ] || continue
+        $CXX $CXXFLAGS $inc -c "$f" -o "$out/$(basename "$f" .cc).o"
+    done
+    ar rcs "$out/libcommon.a" "$out"/*.o
+    $CXX $CXXFLAGS $inc "$@" "$TOP/src/benchmarks/robots_bench.cc" "$src/crawler/Robots.cc" \
+        "$src/crawler/Robots_matcher.cc" "$out/libcommon.a" $LIBS -o "$out/robots_bench"
+}
+
+echo "building the flex scanner from $(git -C "$TOP" rev-parse --short "$OLD")"
+mkdir -p "$WORK/old"
+git -C "$TOP" archive "$OLD" src | tar -x -C "$WORK/old"
+flex -Cf --outfile="$WORK/old/robots_flex.cc" "$WORK/old/src/crawler/robots.ll"
+build "$WORK/old/src" "$WORK/old/obj" -DROBOTS_FLEX "$WORK/old/robots_flex.cc"
+
+echo "building the scanner of the tree"
+build "$TOP/src" "$WORK/new/obj"
+
+echo "== flex"
+"$WORK/old/obj/robots_bench" "$@"
+echo "== hand-written"
+"$WORK/new/obj/robots_bench" "$@"
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+#include "Compact_url.hh"
+#include "xxhash.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+Compact_url::Compact_url() :
+    m_heap(0),
+    m_size(0),
+    m_scheme_len(0),
+    m_host_b(0),
+    m_host_e(0),
+    m_path_b(0),
+    m_query_b(0),
+    m_fragment_b(0),
+    m_flags(0)
+{
+}
+
+Compact_url::Compact_url(const Url& u) :
+    m_heap(0),
+    m_size(0),
+    m_scheme_len(0),
+    m_host_b(0),
+    m_host_e(0),
+    m_path_b(0),
+    m_query_b(0),
+    m_fragment_b(0),
+    m_flags(0)
+{
+    if (u.normalized()) {
+        assign(u);
+    } else {
+        Url n(u);
+        n.normalize();
+        assign(n);
+    }
+}
+
+Compact_url::Compact_url(const Compact_url& o) :
+    m_size(o.m_size),
+    m_scheme_len(o.m_scheme_len),
+    m_host_b(o.m_host_b),
+    m_host_e(o.m_host_e),
+    m_path_b(o.m_path_b),
+    m_query_b(o.m_query_b),
+    m_fragment_b(o.m_fragment_b),
+    m_flags(o.m_flags)
+{
+    if (o.is_inline()) {
+        memcpy(m_inline, o.m_inline, sizeof(m_inline));
+    } else {
+        m_heap = new char[m_size];
+        memcpy(m_heap, o.m_heap, m_size);
+    }
+}
+
+Compact_url::Compact_url(Compact_url&& o) :
+    m_size(o.m_size),
+    m_scheme_len(o.m_scheme_len),
+    m_host_b(o.m_host_b),
+    m_host_e(o.m_host_e),
+    m_path_b(o.m_path_b),
+    m_query_b(o.m_query_b),
+    m_fragment_b(o.m_fragment_b),
+    m_flags(o.m_flags)
+{
+    // the buffer is taken as it is, inline or not
+    memcpy(m_inline, o.m_inline, sizeof(m_inline));
+    o.m_size = 0;
+}
+
+Compact_url& Compact_url::operator=(Compact_url o)
+{
+    swap(o);
+    return *this;
+}
+
+void Compact_url::swap(Compact_url& o)
+{
+    char tmp[sizeof(m_inline)];
+    memcpy(tmp, m_inline, sizeof(tmp));
+    memcpy(m_inline, o.m_inline, sizeof(tmp));
+    memcpy(o.m_inline, tmp, sizeof(tmp));
+    std::swap(m_size, o.m_size);
+    std::swap(m_scheme_len, o.m_scheme_len);
+    std::swap(m_host_b, o.m_host_b);
+    std::swap(m_host_e, o.m_host_e);
+    std::swap(m_path_b, o.m_path_b);
+    std::swap(m_query_b, o.m_query_b);
+    std::swap(m_fragment_b, o.m_fragment_b);
+    std::swap(m_flags, o.m_flags);
+}
+
+/// lays out the url as Url::write() does, remembering where each component starts
+void Compact_url::assign(const Url& u)
+{
+    string s;
+    s.reserve(INLINE_SIZE * 4);
+
+    s += u.m_scheme;
+    m_scheme_len = s.size();
+    if (! u.m_scheme.empty())
+        s += ':';
+
+    if (u.has_authority()) {
+        m_flags |= AUTHORITY;
+        s += "//";
+    }
+    if (u.has_authority() && ! u.m_host.empty()) {
+        if (! u.m_userinfo.empty()) {
+            s += u.m_userinfo;
+            s += '@';
+        }
+        if (u.m_host_ip_literal) {
+            m_flags |= IP_LITERAL;
+            s += '[';
+        }
+        m_host_b = s.size();
+        s += u.m_host;
+        m_host_e = s.size();
+        if (u.m_host_ip_literal)
+            s += ']';
+        if (! u.m_port.empty()) {
+            s += ':';
+            s += u.m_port;
+        }
+    } else {
+        m_host_b = m_host_e = s.size();
+    }
+
+    m_path_b = s.size();
+    u._path.write(s);
+    m_query_b = s.size();
+    s += u.m_query;
+    m_fragment_b = s.size();
+    s += u.m_fragment;
+
+    if (s.size() > MAX_SIZE)
+        throw UrlParseError("url too long to be stored");
+
+    m_size = s.size();
+    if (! is_inline())
+        m_heap = new char[m_size];
+    memcpy(is_inline() ? m_inline : m_heap, s.data(), m_size);
+}
+
+Url Compact_url::to_url() const
+{
+    Url u;
+    const char* d = data();
+    u.m_scheme.assign(d, m_scheme_len);
+    if (has_authority()) {
+        u.m_has_authority = true;
+        const size_t lit = (m_flags & IP_LITERAL) ? 1 : 0;
+        u.m_host_ip_literal = lit;
+        const size_t ab = authority_b();
+        if (m_host_b > ab + lit)
+            u.m_userinfo.assign(d + ab, m_host_b - lit - 1 - ab);
+        u.m_host.assign(host_data(), host_size());
+        const size_t port_b = m_host_e + lit + 1;
+        if (m_path_b > port_b)
+            u.m_port.assign(d + port_b, m_path_b - port_b);
+    }
+    u._path.assign(path());
+    u.m_query.assign(d + m_query_b, m_fragment_b - m_query_b);
+    u.m_fragment.assign(d + m_fragment_b, m_size - m_fragment_b);
+    // it was normalized when stored
+    u.m_normalized = true;
+    return u;
+}
+
+int Compact_url::compare_host(const Compact_url& o) const
+{
+    const size_t a = host_size();
+    const size_t b = o.host_size();
+    int res = memcmp(host_data(), o.host_data(), std::min(a, b));
+    if (res)
+        return res;
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+uint64_t Compact_url::fingerprint() const
+{
+    return Xxhash64::hash(data(), size());
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup Url
+ * @{
+ */
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <stdint.h>
+
+#include "Url.hh"
+
+/**
+ * @class Compact_url Compact_url.hh
+ * @brief Immutable normalized url stored in a single buffer
+ *
+ * A Url keeps every component in its own string and the path as a list of segments, which is
+ * handy to modify it but takes around ten allocations. This keeps the normalized serialization
+ * in one buffer, inline in the object if it's short, and the offsets of each component, it's
+ * meant for urls that are only stored, like the ones waiting in the frontier.
+ *
+ * \verbatim
+ * foo://user@example.com:8042/over/there?name=ferret#nose
+ *       |    |          |    |          |            |
+ *       |    host_b     |    path_b     query_b      fragment_b
+ *       authority_b     host_e
+ * \endverbatim
+ */
+class Compact_url {
+public:
+    /// urls up to this size don't allocate
+    static const size_t INLINE_SIZE = 32;
+    /// offsets are 16 bit
+    static const size_t MAX_SIZE = 0xFFFF;
+
+    Compact_url();
+
+    /**
+     * @brief normalizes a copy of u if it isn't already
+     * @throw UrlParseError if the url is longer than MAX_SIZE
+     */
+    explicit Compact_url(const Url& u);
+
+    Compact_url(const Compact_url& o);
+    Compact_url(Compact_url&& o);
+    Compact_url& operator=(Compact_url o);
+
+    ~Compact_url()
+    {
+        if (! is_inline())
+            delete[] m_heap;
+    }
+
+    void swap(Compact_url& o);
+
+    /// @return the url, already normalized
+    Url to_url() const;
+
+    std::string get() const { return std::string(data(), size()); }
+    const char* data() const { return is_inline() ? m_inline : m_heap; }
+    size_t size() const { return m_size; }
+    bool empty() const { return ! m_size; }
+
+    std::string scheme() const { return std::string(data(), m_scheme_len); }
+    bool has_authority() const { return m_flags & AUTHORITY; }
+    std::string host() const { return std::string(host_data(), host_size()); }
+    const char* host_data() const { return data() + m_host_b; }
+    size_t host_size() const { return m_host_e - m_host_b; }
+    bool host_is(const std::string& h) const { return h.size() == host_size() && ! memcmp(h.data(), host_data(), h.size()); }
+    /// like std::string::compare on the hosts
+    int compare_host(const Compact_url& o) const;
+    std::string path() const { return std::string(data() + m_path_b, m_query_b - m_path_b); }
+    /// with the leading '?'
+    std::string query() const { return std::string(data() + m_query_b, m_fragment_b - m_query_b); }
+    /// with the leading '#'
+    std::string fragment() const { return std::string(data() + m_fragment_b, m_size - m_fragment_b); }
+
+    /// same as Url::fingerprint()
+    uint64_t fingerprint() const;
+
+    bool operator==(const Compact_url& o) const { return m_size == o.m_size && ! memcmp(data(), o.data(), m_size); }
+    bool operator!=(const Compact_url& o) const { return ! (*this == o); }
+
+private:
+    enum {
+        AUTHORITY = 1,
+        IP_LITERAL = 2
+    };
+
+    void assign(const Url& u);
+    bool is_inline() const { return m_size <= INLINE_SIZE; }
+    /// start of userinfo or host
+    size_t authority_b() const { return m_scheme_len ? m_scheme_len + 3 : 2; }
+
+    union {
+        char m_inline[INLINE_SIZE];
+        char* m_heap;
+    };
+    uint16_t m_size;
+    uint16_t m_scheme_len;
+    uint16_t m_host_b;
+    uint16_t m_host_e;
+    uint16_t m_path_b;
+    uint16_t m_query_b;
+    uint16_t m_fragment_b;
+    unsigned char m_flags;
+};
+
+/** @} */
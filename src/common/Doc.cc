@@ -19,12 +19,15 @@ void Doc::save(mongo::DBClientConnection& c, const string& ns)
     url.normalize();
 
     c.ensureIndex(ns, BSON("url" << 1));
+    c.ensureIndex(ns, BSON("fp" << 1));
 
     bson::bob b;
     //b.genOID();
     //
 
     b.append("url", url.get());
+    // compact key for lookups and dedup, bson has no unsigned 64 bit type
+    b.append("fp", static_cast<long long>(url.fingerprint()));
 
     if (! eff_url.empty())
         b.append("eff_url", eff_url.get());
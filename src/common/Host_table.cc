@@ -0,0 +1,60 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+#include "Host_table.hh"
+#include "Public_suffix.hh"
+
+#include <stdexcept>
+
+using namespace std;
+
+const uint32_t Host_table::NONE;
+
+Host_table::Host_table() :
+    m_ids(),
+    m_names(),
+    m_domains()
+{
+}
+
+uint32_t Host_table::intern(const char* host, size_t len)
+{
+    pair<unordered_map<string, uint32_t>::iterator, bool> ins = m_ids.insert(make_pair(string(host, len), NONE));
+    if (! ins.second)
+        return ins.first->second;
+
+    if (m_names.size() >= NONE) {
+        m_ids.erase(ins.first);
+        throw runtime_error("Host_table: out of ids");
+    }
+    const uint32_t id = m_names.size();
+    ins.first->second = id;
+    m_names.push_back(&ins.first->first);
+    m_domains.push_back(id);
+
+    // the domain of a registered domain is itself, so this recurses once at most
+    const size_t d = public_suffix::registered_domain_offset(host, len);
+    if (d) {
+        const uint32_t domain = intern(host + d, len - d);
+        m_domains[id] = domain;
+    }
+    return id;
+}
+
+uint32_t Host_table::find(const string& host) const
+{
+    unordered_map<string, uint32_t>::const_iterator i = m_ids.find(host);
+    return i != m_ids.end() ? i->second : NONE;
+}
+
+void Host_table::clear()
+{
+    m_ids.clear();
+    m_names.clear();
+    m_domains.clear();
+}
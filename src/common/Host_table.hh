@@ -0,0 +1,58 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup Url
+ * @{
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Interns host names, giving each a 32 bit id
+ *
+ * Every host also gets the id of its registered domain (see public_suffix), which is interned in
+ * the same table, so that urls can be grouped by host or by registered domain comparing integers.
+ * Ids are dense and start at 0, hosts are never removed. Not thread safe.
+ */
+class Host_table {
+public:
+    /// not an id
+    static const uint32_t NONE = 0xFFFFFFFF;
+
+    Host_table();
+
+    /// @return the id of host, adding it if it's new
+    uint32_t intern(const char* host, size_t len);
+    uint32_t intern(const std::string& host) { return intern(host.data(), host.size()); }
+
+    /// @return the id of host, NONE if it wasn't interned
+    uint32_t find(const std::string& host) const;
+
+    /// @return the host with that id
+    const std::string& name(uint32_t id) const { return *m_names.at(id); }
+
+    /// @return the id of the registered domain of the host with that id, itself if it's an ip or a public suffix
+    uint32_t domain(uint32_t id) const { return m_domains.at(id); }
+
+    size_t size() const { return m_names.size(); }
+    void clear();
+
+private:
+    std::unordered_map<std::string, uint32_t> m_ids;
+    /// keys of m_ids by id, the nodes don't move
+    std::vector<const std::string*> m_names;
+    std::vector<uint32_t> m_domains;
+};
+
+/** @} */
@@ -8,125 +8,138 @@
 
 #include "Path.hh"
 #include "utils.hh"
+#include <cstring>
 using namespace std;
 
+namespace {
+    inline bool is_dot(const char* s, size_t len)
+    {
+        return len == 1 && s[0] == '.';
+    }
+
+    inline bool is_dotdot(const char* s, size_t len)
+    {
+        return len == 2 && s[0] == '.' && s[1] == '.';
+    }
+}
+
+void Path::push_back(const char* s, size_t len)
+{
+    if( ! m_seg.empty() )
+        m_str += '/';
+    m_seg.push_back(m_str.size());
+    m_str.append(s, len);
+}
+
+void Path::pop_back()
+{
+    m_str.resize(m_seg.size() > 1 ? m_seg.back() - 1 : 0);
+    m_seg.pop_back();
+}
+
+void Path::reindex()
+{
+    m_seg.clear();
+    if( m_str.empty() )
+        return;
+    m_seg.push_back(0);
+    for(size_t i = 0; i < m_str.size(); ++i)
+        if( m_str[i] == '/' )
+            m_seg.push_back(i + 1);
+}
+
 void Path::merge(const Path& p)
 {
+    if( &p == this ) {
+        Path tmp(p);
+        merge(tmp);
+        return;
+    }
     D(cout << "Path::merge " << this->get() << " with " << p.get() << endl;);
     if( p.flags.test(SLASH_BEGIN) )
         (*this) = p;
     else {
-        if( ! flags.test(SLASH_END) && ! segmt.empty() && ! p.empty() )
-            segmt.pop_back(); // file element at the end
-        for(list<string>::const_iterator i = p.segmt.begin(); i != p.segmt.end(); ++i) {
-            if( *i == "." ) {
+        if( ! flags.test(SLASH_END) && ! m_seg.empty() && ! p.empty() )
+            pop_back(); // file element at the end
+        m_str.reserve(m_str.size() + p.m_str.size() + 1);
+        for(size_t i = 0; i < p.m_seg.size(); ++i) {
+            const char* s = p.m_str.data() + p.m_seg[i];
+            const size_t len = p.seg_end(i) - p.m_seg[i];
+            if( is_dot(s, len) ) {
                 flags.set(SLASH_END,true);
-            } else if( *i == ".." ) {
-                if( ! segmt.empty() ) {
-                    segmt.pop_back();
+            } else if( is_dotdot(s, len) ) {
+                if( ! m_seg.empty() ) {
+                    pop_back();
                     flags.set(SLASH_END,true);
                 }
             } else {
-                segmt.push_back(*i);
+                push_back(s, len);
                 flags.set(SLASH_END,false);
             }
         }
         if( p.flags.test(SLASH_END) )
             flags.set(SLASH_END,true);
-    //  Fix: When you merge with .. or . the path should end in slash
-    //    else
-    //        flags.set(SLASH_END,false);
     }
     D(cout << "result: " << this->get() << endl;)
 }
 
 void Path::normalize()
 {
-//    if( flags.test(SLASH_BEGIN) && ! segmt.empty() && *segmt.begin() == ".." )
-//        segmt.pop_front();
-
-    list<string>::iterator i = segmt.begin();
-    list<string>::iterator j = segmt.begin();
-    list<string>::iterator k = segmt.begin();
-    ++i;
-    while( i != segmt.end() ) {
-        if( *i == ".." && j != i && *j != ".." && *j != "." ) {
-            segmt.erase(j);
-            i=segmt.erase(i);
-
-
-            if( i == segmt.end() )
-                flags.set(SLASH_END,true);
-
-        } else if ( *i == "." ) {
-            i=segmt.erase(i);
-            if( i == segmt.end() )
+    const bool abs = flags.test(SLASH_BEGIN);
+    // segments are moved down over the removed ones, w is the number kept and out the end of the
+    // kept ones in m_str, reading is always ahead so the offsets not yet read are intact
+    size_t w = 0;
+    size_t out = 0;
+    const size_t n = m_seg.size();
+    for(size_t i = 0; i < n; ++i) {
+        const size_t b = m_seg[i];
+        const size_t len = seg_end(i) - b;
+        const char* s = m_str.data() + b;
+        const bool last = i + 1 == n;
+        if( is_dot(s, len) && (abs || i > 0) ) {
+            if( last )
                 flags.set(SLASH_END,true);
-        } else {
-            ++j;
-            ++i;
+            continue;
         }
-        j=k=segmt.begin();
-        while(k != i)
-            j=k++;
-
+        if( is_dotdot(s, len) ) {
+            const size_t pb = w ? m_seg[w - 1] : 0;
+            const size_t plen = out - pb;
+            if( w && ! is_dot(m_str.data() + pb, plen) && ! is_dotdot(m_str.data() + pb, plen) ) {
+                --w;
+                out = w ? pb - 1 : 0;
+                if( last )
+                    flags.set(SLASH_END,true);
+                continue;
+            }
+            if( abs ) {
+                // can't go above the root
+                if( last )
+                    flags.set(SLASH_END,true);
+                continue;
+            }
+        }
+        if( w )
+            m_str[out++] = '/';
+        if( out != b )
+            memmove(&m_str[out], m_str.data() + b, len);
+        m_seg[w++] = out;
+        out += len;
     }
+    m_str.resize(out);
+    m_seg.resize(w);
 }
 
 size_t Path::size() const
 {
-    size_t size=0;
-    if( empty() )
-        return 0;
-    else if( segmt.size() > 0 ) {
-        if(flags.test(SLASH_BEGIN))
-            ++size;
-
-        for(list<string>::const_iterator i = segmt.begin(); i != segmt.end(); ++i)
-            size += (*i).size();
-
-        if(flags.test(SLASH_END))
-            ++size;
-
-        size += segmt.size()-1; // there will be '/' between elements
-
-        return size;
-    } else if (flags.test(SLASH_BEGIN) || flags.test(SLASH_END)){
-        return 1;
-    } else {
-        return 0;
-    }
+    if( m_seg.empty() )
+        return (flags.test(SLASH_BEGIN) || flags.test(SLASH_END)) ? 1 : 0;
+    return flags.test(SLASH_BEGIN) + m_str.size() + flags.test(SLASH_END);
 }
 
 string Path::get() const
 {
-    if( empty() )
-        return "";
     string result;
-    result.reserve(this->size());
-    if( segmt.size() > 0 ) {
-        if(flags.test(SLASH_BEGIN))
-            result += '/';
-
-        bool iterated=false;
-        for(list<string>::const_iterator j = segmt.begin(); j != segmt.end(); ++j) {
-            result += (*j);
-            result += '/';
-            iterated=true;
-        }
-        if(iterated && ! result.empty() )
-            result = result.substr(0,result.size()-1); // remove final '/', since there's no + operator in list iterators
-
-        if(flags.test(SLASH_END))
-            result += '/';
-
-        if(result == "//") // just to make sure
-            result = "/";
-    } else if (flags.test(SLASH_BEGIN) || flags.test(SLASH_END)){
-        result = "/";
-    } else
-        result.clear();
-
+    write(result);
     return result;
 }
 
@@ -135,61 +148,35 @@ void Path::assign(const string& s)
     clear();
     if( s.empty() )
         return;
-    list<string>::size_type depth=0;
-    string::const_iterator begin=s.begin();
-    string::const_iterator end = s.begin();
-    if( *end == '/'  ) {
+    string::size_type b = 0;
+    if( s[0] == '/' ) {
         flags.set(SLASH_BEGIN,true);
-        ++end;
-        begin = end;
+        b = 1;
     }
-
-    while(1) {
-        if( end == s.end() ) {
-            if( end != begin ) {
-                string str(begin,end); // [begin,end)
-                segmt.push_back(str);
-                ++depth;
-                begin = end;
-            }
-            break;
-        } else if( *end == '/'  ) {
-            if( end != begin ) {
-                string str(begin,end); // [begin,end)
-                segmt.push_back(str);
-                ++depth;
-                begin = end;
-            } else {
-                ++end;
-                begin = end;
-            }
-        } else {
-            ++end;
-        }
-        // safety check
-        if( depth >= segmt.max_size() ) {
-            clog << "path depth >= MAXDEPTH" << endl;
-            return;
-        }
+    m_str.reserve(s.size());
+    while( b < s.size() ) {
+        string::size_type e = s.find('/', b);
+        if( e == string::npos )
+            e = s.size();
+        if( e != b )
+            push_back(s.data() + b, e - b);
+        b = e + 1;
     }
-    if( s.at(s.size()-1) == '/' )
+    if( s[s.size()-1] == '/' )
         flags.set(SLASH_END,true);
 }
 
 
 bool Path::updir()
 {
-    if( ! segmt.empty() ) {
+    if( ! m_seg.empty() ) {
         if( ! flags[SLASH_END] ) // a file
-            segmt.pop_back();
-        segmt.pop_back();
+            pop_back();
+        if( ! m_seg.empty() )
+            pop_back();
         flags[SLASH_END] = true;
         return true;
     } else {
         return false;
     }
 }
-
-
-
-
@@ -24,24 +24,50 @@
 
 #ifndef Path_hh
 #define Path_hh 1
-#include <list>
 #include <ostream>
 #include <iostream>
 #include <string>
+#include <vector>
 #include <bitset>
 
-#define MAXDEPTH    256
-
+/**
+ * The segments are kept in a single string, separated by '/', with the offset where each one
+ * starts. Segments are never empty and don't contain '/', consecutive slashes are collapsed.
+ */
 class Path {
     public:
-        Path(const std::string& s):segmt(),flags() {
+        Path(const std::string& s):m_str(),m_seg(),flags() {
             assign(s);
         }
-        Path():segmt(),flags() {
+        Path():m_str(),m_seg(),flags() {
         }
 
+        /**
+         * Merge with a relative path as in [RFC3986 5.2.3] removing the dot segments of p as they
+         * are appended, the last segment of this path is dropped unless it's a directory
+         */
         void merge(const Path& p);
         std::string get() const;
+
+        /**
+         * @brief append the serialized path to out piece by piece, same result as get()
+         * @param out anything with append(const char*, size_t), like std::string
+         */
+        template<class Sink>
+        void write(Sink& out) const
+        {
+            if( m_seg.empty() ) {
+                if( flags.test(SLASH_BEGIN) || flags.test(SLASH_END) )
+                    out.append("/", 1);
+                return;
+            }
+            if( flags.test(SLASH_BEGIN) )
+                out.append("/", 1);
+            out.append(m_str.data(), m_str.size());
+            if( flags.test(SLASH_END) )
+                out.append("/", 1);
+        }
+
         void assign(const std::string& s);
 
         Path& operator=(const std::string& s) {
@@ -53,8 +79,14 @@ class Path {
             return *this;
         }
 
+        bool operator==(const Path& p) const {
+            return flags == p.flags && m_str == p.m_str;
+        }
+
         /**
-         * Take care of /../ /./ sequences
+         * Take care of /../ /./ sequences, remove_dot_segments [RFC3986 5.2.4] in place.
+         * Relative paths keep a leading "." and the ".." that go above them, as they are
+         * still to be merged with a base.
          */
         void normalize();
         size_t size() const;
@@ -82,21 +114,22 @@ class Path {
          */
         bool updir();
 
-        size_t depth()  {
-            return segmt.size();
+        size_t depth() const {
+            return m_seg.size();
         }
 
         /**
          * Make this path empty
          */
         void clear() {
-            segmt.clear();
+            m_str.clear();
+            m_seg.clear();
             flags.reset(SLASH_END);
             flags.reset(SLASH_BEGIN);
         }
 
         bool empty() const {
-            if( ! flags.test(SLASH_END) && segmt.empty() && ! flags.test(SLASH_BEGIN) )
+            if( ! flags.test(SLASH_END) && m_seg.empty() && ! flags.test(SLASH_BEGIN) )
                 return true;
             else
                 return false;
@@ -113,7 +146,10 @@ class Path {
     friend class Url;
 
     protected:
-        std::list<std::string> segmt;
+        /// segments separated by '/', without leading or trailing slash
+        std::string m_str;
+        /// offset in m_str where each segment starts
+        std::vector<unsigned> m_seg;
         static size_t const FLAGSSIZE = 2;
         enum flags {
             SLASH_END,
@@ -121,9 +157,17 @@ class Path {
         };
         std::bitset<FLAGSSIZE> flags;
 
-    private:
+        /// end of segment i in m_str
+        size_t seg_end(size_t i) const {
+            return i + 1 < m_seg.size() ? m_seg[i + 1] - 1 : m_str.size();
+        }
+
+        void push_back(const char* s, size_t len);
+        void pop_back();
+
+        /// recompute the offsets after m_str was modified
+        void reindex();
 };
 
 #endif
 /** @} */
-
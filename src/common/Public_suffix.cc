@@ -0,0 +1,106 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+#include "Public_suffix.hh"
+#include "Url.hh"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace public_suffix {
+
+namespace {
+    const char* const RULES[] = {
+#include "public_suffix_rules.inc"
+    };
+    const size_t N_RULES = sizeof(RULES) / sizeof(RULES[0]);
+
+    /// rule being looked up, prefix followed by [s, s + len)
+    struct Key {
+        const char* prefix;
+        size_t prefix_len;
+        const char* s;
+        size_t len;
+    };
+
+    /// like strcmp(rule, key)
+    int compare(const char* rule, const Key& k)
+    {
+        int c = strncmp(rule, k.prefix, k.prefix_len);
+        if (c)
+            return c;
+        rule += k.prefix_len;
+        c = strncmp(rule, k.s, k.len);
+        if (c)
+            return c;
+        return rule[k.len] ? 1 : 0;
+    }
+
+    bool has_rule(const char* prefix, const char* s, size_t len)
+    {
+        const Key k = { prefix, strlen(prefix), s, len };
+        const char* const* r = lower_bound(RULES, RULES + N_RULES, k,
+            [](const char* rule, const Key& key) { return compare(rule, key) < 0; });
+        return r != RULES + N_RULES && compare(*r, k) == 0;
+    }
+}
+
+size_t suffix_offset(const char* host, size_t len)
+{
+    // a trailing dot makes the name absolute, it's not part of the last label
+    const size_t end = (len && host[len - 1] == '.') ? len - 1 : len;
+    size_t best = string::npos;
+    size_t tld = string::npos;
+    // candidate suffixes [p, end) growing one label at a time, parent is the previous one
+    size_t parent = end;
+    while (parent > 0) {
+        size_t p = parent == end ? end : parent - 1;
+        while (p > 0 && host[p - 1] != '.')
+            --p;
+        if (tld == string::npos)
+            tld = p;
+
+        if (has_rule("!", host + p, end - p))
+            // exception to a wildcard, the suffix is the parent
+            return parent;
+        if (has_rule("", host + p, end - p) || (parent != end && has_rule("*.", host + parent, end - parent)))
+            best = p;
+        parent = p;
+    }
+    if (best != string::npos)
+        return best;
+    return tld != string::npos ? tld : 0;
+}
+
+size_t registered_domain_offset(const char* host, size_t len)
+{
+    if (! len || host[0] == '[' || Url_util::is_ipv4(host, len))
+        return 0;
+    size_t p = suffix_offset(host, len);
+    if (p == 0)
+        return 0;
+    // the label before the suffix
+    --p;
+    while (p > 0 && host[p - 1] != '.')
+        --p;
+    return p;
+}
+
+string registered_domain(const string& host)
+{
+    return host.substr(registered_domain_offset(host.data(), host.size()));
+}
+
+size_t rules()
+{
+    return N_RULES;
+}
+
+}; // end namespace
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup Url
+ * @{
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Public suffix matching, with the ICANN section of the public suffix list embedded as
+ * generated by utils/gen_public_suffix.py. Hosts are expected normalized: lowercase, punycode.
+ */
+namespace public_suffix {
+
+/**
+ * @return offset in host where its public suffix starts, ie. 4 for "www.bbc.co.uk" -> "co.uk"
+ * Hosts that match no rule have their last label as public suffix, as the list mandates.
+ */
+size_t suffix_offset(const char* host, size_t len);
+
+/**
+ * @return offset in host where its registered domain, the public suffix plus one label, starts,
+ * ie. 4 for "www.bbc.co.uk" -> "bbc.co.uk". 0 for ip addresses and hosts that are a public suffix.
+ */
+size_t registered_domain_offset(const char* host, size_t len);
+
+std::string registered_domain(const std::string& host);
+
+/// @return number of embedded rules
+size_t rules();
+
+}; // end namespace
+
+/** @} */
@@ -6,6 +6,9 @@
  * code package.
  */
 #include "Url.hh"
+#include "Url_char_class.hh"
+#include "xxhash.hh"
+#include <cstring>
 #include <boost/algorithm/string.hpp>
 //#include <boost/algorithm/string.hpp>
 
@@ -21,7 +24,193 @@ static const char* scheme_defport[] = {
     "0"
 };
 
-static const boost::regex url_re(url_regex[RE_URL],regex_constants::perl);
+namespace Url_util {
+
+namespace {
+    inline bool alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+    inline bool digit(char c) { return c >= '0' && c <= '9'; }
+    inline bool alnum(char c) { return alpha(c) || digit(c); }
+    inline bool xdigit(char c) { return digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+
+    /// @return true if [b, e) matches the decoct macro of the reference regexps
+    bool dec_octet(const char* b, const char* e)
+    {
+        const size_t n = e - b;
+        for (const char* p = b; p != e; ++p)
+            if (! digit(*p))
+                return false;
+        if (n == 0 || n > 3)
+            return false;
+        if (n < 3)
+            return true;
+        // 2[0-4][0-0] is what the reference regexp says, ie. 201 is not valid
+        return b[0] == '0' || b[0] == '1'
+            || (b[0] == '2' && b[1] >= '0' && b[1] <= '4' && b[2] == '0')
+            || (b[0] == '2' && b[1] == '5' && b[2] <= '5');
+    }
+
+    /**
+     * @brief parse h16 groups separated by ':', the last one can be an ipv4 if allowed
+     * @param units number of 16 bit pieces
+     */
+    bool h16_list(const char* b, const char* e, bool ipv4_last, size_t& units)
+    {
+        units = 0;
+        while (true) {
+            const char* g = b;
+            while (g != e && *g != ':')
+                ++g;
+            if (g == b)
+                // empty group
+                return false;
+            if (g == e && ipv4_last && memchr(b, '.', e - b)) {
+                if (! is_ipv4(b, e - b))
+                    return false;
+                units += 2;
+                return true;
+            }
+            if (g - b > 4)
+                return false;
+            for (const char* p = b; p != g; ++p)
+                if (! xdigit(*p))
+                    return false;
+            ++units;
+            if (g == e)
+                return true;
+            b = g + 1;
+        }
+    }
+}
+
+void split(const char* s, size_t len, Url_split& res)
+{
+    res = Url_split();
+    const char* p = s;
+    const char* const end = s + len;
+    const char* q = p;
+
+    // scheme: what comes before the first ':' if no '/', '?' or '#' appears before it
+    while (q != end && *q != ':' && *q != '/' && *q != '?' && *q != '#')
+        ++q;
+    if (q != end && *q == ':' && q != p) {
+        res.scheme = Url_split::Part(p, q);
+        p = q + 1;
+    }
+
+    if (end - p >= 2 && p[0] == '/' && p[1] == '/') {
+        p += 2;
+        for (q = p; q != end && *q != '/' && *q != '?' && *q != '#'; ++q)
+            ;
+        res.authority = Url_split::Part(p, q);
+        p = q;
+    }
+
+    for (q = p; q != end && *q != '?' && *q != '#'; ++q)
+        ;
+    res.path = Url_split::Part(p, q);
+    p = q;
+
+    if (p != end && *p == '?') {
+        for (q = p + 1; q != end && *q != '#'; ++q)
+            ;
+        res.query = Url_split::Part(p, q);
+        p = q;
+    }
+
+    if (p != end)
+        res.fragment = Url_split::Part(p, end);
+}
+
+bool is_scheme(const char* s, size_t len)
+{
+    if (! len || ! alpha(s[0]))
+        return false;
+    for (size_t i = 1; i < len; ++i)
+        if (! (alnum(s[i]) || s[i] == '+' || s[i] == '.' || s[i] == '-'))
+            return false;
+    return true;
+}
+
+bool is_reg_name(const char* s, size_t len)
+{
+    if (! len || ! alnum(s[0]))
+        return false;
+    for (size_t i = 1; i < len; ++i)
+        if (! (alnum(s[i]) || s[i] == '.' || (s[i] == '-' && i + 1 < len)))
+            return false;
+    return true;
+}
+
+bool is_ipvfuture(const char* s, size_t len)
+{
+    if (len < 4 || s[0] != 'v' || ! xdigit(s[1]) || s[2] != '.' || s[3] != '1')
+        return false;
+    for (size_t i = 4; i < len; ++i)
+        if (! s[i] || ! (alnum(s[i]) || strchr("._~!$&'()*+,;=:-", s[i])))
+            return false;
+    return true;
+}
+
+bool is_ipv6(const char* s, size_t len)
+{
+    const char* const end = s + len;
+    const char* dcolon = 0;
+    for (const char* p = s; p + 1 < end; ++p)
+        if (p[0] == ':' && p[1] == ':') {
+            dcolon = p;
+            break;
+        }
+
+    size_t left = 0;
+    size_t right = 0;
+    if (! dcolon)
+        return h16_list(s, end, true, left) && left == 8;
+
+    if (dcolon != s && ! h16_list(s, dcolon, false, left))
+        return false;
+    if (dcolon + 2 != end && ! h16_list(dcolon + 2, end, true, right))
+        return false;
+    // "::" stands for at least one group
+    return left + right <= 7;
+}
+
+bool is_ipv4(const char* s, size_t len)
+{
+    const char* const end = s + len;
+    const char* b = s;
+    for (int i = 0; i < 4; ++i) {
+        const char* e = b;
+        while (e != end && *e != '.')
+            ++e;
+        if (! dec_octet(b, e))
+            return false;
+        if (i < 3) {
+            if (e == end)
+                return false;
+            b = e + 1;
+        } else if (e != end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_port(const char* s, size_t len)
+{
+    if (! len || len > 5)
+        return false;
+    for (size_t i = 0; i < len; ++i)
+        if (! digit(s[i]))
+            return false;
+    return true;
+}
+
+bool is_host(const char* s, size_t len)
+{
+    return is_reg_name(s, len) || is_ipvfuture(s, len) || is_ipv6(s, len) || is_ipv4(s, len);
+}
+
+}; // namespace Url_util
 
 
 #define base_ctors\
@@ -34,7 +223,10 @@ static const boost::regex url_re(url_regex[RE_URL],regex_constants::perl);
     m_host(),\
     m_port(),\
     m_query(),\
-    m_fragment()
+    m_fragment(),\
+    m_normalized(),\
+    m_fp_valid(),\
+    m_fp()
 
 Url::Url(const std::string& s) :
     base_ctors
@@ -51,69 +243,43 @@ Url::Url()  :
 void Url::assign(const string& s)
 {
     this->clear();
-    enum {
-        URL = 0,
-        SCHEME_CLN = 1,
-        SCHEME    = 2,
-        DSLASH_AUTH = 3,
-        AUTHORITY = 4,
-        PATH    = 5,
-        QUERY    = 6,
-        FRAGMENT = 7
-    };
-
-    try {
-        //regex re(url_regex[RE_URL],regex_constants::perl);
-        smatch match;
-        if( regex_match(s, match, url_re) ) {
-            /* bad cases:
-             * ////rrara
-             * 3: //
-             * 5: //rara
-             * then is this url an absolute path like /rara  ?
-             * so rule of thumb is to sanityze double slashes on paths.
-             */
-            if( match[SCHEME].matched )
-                scheme(match[SCHEME].str());
-
-            if( match[DSLASH_AUTH].matched ) {
-                // Only valid for locally scoped urls like file:/// that define a default host, since http:/// makes no sense, authority must exists for globally scoped urls
-                // in this case 3: // 4 matches, but its empty
-                // if url == "/////" then 3: // 4 matches but empty 5: /// we treat this like an absolute path, but only if there's no scheme.
-                if( match[DSLASH_AUTH].str() == "//") {
-                    // if( scheme().empty() )
-                    // this is a relative uri with an absolute path we are ok.
-                    if ( ! scheme().empty() && scheme() != "file" )
-                        throw UrlParseError("empty authority part, with // is not allowed for schemes other than 'file'");
-                }
-            }
-
-            if( match[AUTHORITY].matched )
-                authority(match[AUTHORITY].str());
-            if( match[PATH].matched )
-                //DLOG(cout << "PATH match: |" << match[PATH].str() << "|" << endl);
-                path(match[PATH].str());
-
-            if( match[QUERY].matched )
-                query(match[QUERY].str());
+    Url_split match;
+    split(s.data(), s.size(), match);
+
+    /* bad cases:
+     * ////rrara
+     * 3: //
+     * 5: //rara
+     * then is this url an absolute path like /rara  ?
+     * so rule of thumb is to sanityze double slashes on paths.
+     */
+    if( match.scheme.matched )
+        scheme(match.scheme.str());
+
+    if( match.authority.matched ) {
+        // Only valid for locally scoped urls like file:/// that define a default host, since http:/// makes no sense, authority must exists for globally scoped urls
+        // if url == "/////" then authority matches but is empty, we treat this like an absolute path, but only if there's no scheme.
+        if( match.authority.len == 0 ) {
+            // if( scheme().empty() )
+            // this is a relative uri with an absolute path we are ok.
+            if ( ! scheme().empty() && scheme() != "file" )
+                throw UrlParseError("empty authority part, with // is not allowed for schemes other than 'file'");
+        }
+        authority(match.authority.str());
+    }
 
-            if( match[FRAGMENT].matched )
-                fragment(match[FRAGMENT].str());
+    path(match.path.str());
 
-            if( ! syntax_ok() )
-                throw UrlParseError(" ! syntax_ok() for this url, sanity checks failed");
+    if( match.query.matched )
+        query(match.query.str());
 
-            if( ! valid_host())
-                throw UrlParseError(" ! valid_host() for this url, sanity checks failed");
+    if( match.fragment.matched )
+        fragment(match.fragment.str());
 
-        } else {
-            throw UrlParseError("Url doesn't match primary url regex");
-        }
-    } catch(regex_error re) {
-        string s("Url::assign() boost::regex_error: ");
-        s+=re.what();
-        throw UrlParseError(s);
-    }
+    // the components can't contain the delimiters after split and the host has been
+    // validated by host(), what's left of syntax_ok()
+    if( has_authority() && ! ( _path.empty() || _path.absolute() ) )
+        throw UrlParseError(" ! syntax_ok() for this url, sanity checks failed");
 }
 
 bool Url::syntax_ok() const  {
@@ -142,54 +308,17 @@ bool Url::syntax_ok() const  {
 
 bool Url::valid_host() const
 {
-    if( host().empty() )
-        return true;
-    regex re;
-
-    string h = unescape_safe(host());
-    re.assign(url_regex[RE_HOST]);
-    if( regex_match(h,re) )
-        return true;
-
-    re.assign(url_regex[RE_IPVFUT]);
-    if( regex_match(h,re) )
-        return true;
-
-    re.assign(url_regex[RE_IPV6]);
-    if( regex_match(h,re) )
-        return true;
-
-    re.assign(url_regex[RE_IPV4]);
-    if( regex_match(h,re) )
-        return true;
-
-    return false;
+    return valid_host(m_host);
 }
 
 bool Url::valid_host(const std::string& h)
 {
     if( h.empty() )
         return true;
-    regex re;
+    if( h.find('%') == string::npos )
+        return is_host(h.data(), h.size());
     string host = unescape_safe(h);
-
-    re.assign(url_regex[RE_HOST]);
-    if( regex_match(host,re) )
-        return true;
-
-    re.assign(url_regex[RE_IPVFUT]);
-    if( regex_match(host,re) )
-        return true;
-
-    re.assign(url_regex[RE_IPV6]);
-    if( regex_match(host,re) )
-        return true;
-
-    re.assign(url_regex[RE_IPV4]);
-    if( regex_match(host,re) )
-        return true;
-
-    return false;
+    return is_host(host.data(), host.size());
 }
 
 Url& Url::merge_ref(const Url& u)
@@ -198,6 +327,7 @@ Url& Url::merge_ref(const Url& u)
     if( ! u.syntax_ok() )
         throw BadUrl("supplied url ! syntax_ok");
 
+    modified();
 
 
     if( this->absolute() && ! u.absolute() ) {
@@ -278,27 +408,63 @@ Url& Url::operator=(const string& s)
  * Note: URIs that differ in the replacement of a reserved character with its
  * corresponding percent-encoded octet are not equivalent
  */
-bool Url::operator==(const Url& u) {
-    //cout << "operator==" << endl;
-    Url rhs = u;
+bool Url::operator==(const Url& u) const
+{
+    // cached on both, so most of the urls that differ are told apart by comparing two integers
+    if( fingerprint() != u.fingerprint() )
+        return false;
+    // fingerprints can collide
+    if( m_normalized && u.m_normalized )
+        return same_parts(u) || get() == u.get();
     Url lhs = *this;
-    rhs.normalize();
+    Url rhs = u;
     lhs.normalize();
-    string rhss = rhs.get();
-    string lhss = lhs.get();
-    //cout << rhss << " " << lhss << endl;
-    if( rhss == lhss )
-        return true;
-    else
-        return false;
+    rhs.normalize();
+    return lhs.same_parts(rhs) || lhs.get() == rhs.get();
 }
 
-bool Url::operator!=(const Url& u) {
-    //cout << "operator!=" << endl;
-    if( *this == u )
-        return false;
-    else
-        return true;
+bool Url::operator!=(const Url& u) const
+{
+    return ! (*this == u);
+}
+
+bool Url::same_parts(const Url& u) const
+{
+    return m_scheme == u.m_scheme
+        && m_has_authority == u.m_has_authority
+        && m_host_ip_literal == u.m_host_ip_literal
+        && m_userinfo == u.m_userinfo
+        && m_host == u.m_host
+        && m_port == u.m_port
+        && _path == u._path
+        && m_query == u.m_query
+        && m_fragment == u.m_fragment;
+}
+
+namespace {
+    struct Hash_sink {
+        Hash_sink(Xxhash64& h) : h(h) {}
+        void append(const char* s, size_t len) { h.update(s, len); }
+        Xxhash64& h;
+    };
+}
+
+uint64_t Url::fingerprint() const
+{
+    if( m_fp_valid )
+        return m_fp;
+    Xxhash64 h;
+    Hash_sink sink(h);
+    if( m_normalized ) {
+        write(sink);
+    } else {
+        Url n = *this;
+        n.normalize();
+        n.write(sink);
+    }
+    m_fp = h.digest();
+    m_fp_valid = true;
+    return m_fp;
 }
 
 ostream& operator<<(ostream& os, const Url& u) {
@@ -327,8 +493,18 @@ ostream& operator<<(ostream& os, const Url& u) {
     return os;
 }
 
+namespace {
+    /// schemes are ascii, boost's to_lower goes through the global locale, which threads contend for
+    void ascii_to_lower(string& s)
+    {
+        for(string::iterator i = s.begin(); i != s.end(); ++i)
+            if( *i >= 'A' && *i <= 'Z' )
+                *i += 'a' - 'A';
+    }
+}
+
 void Url::normalize_scheme()  {
-    to_lower(m_scheme);
+    ascii_to_lower(m_scheme);
 }
 
 
@@ -356,43 +532,85 @@ string Url::normalize_escapes(const string& s)  {
     return res;
 }
 
+namespace {
+    /**
+     * Same as Url::normalize_escapes(const string&) for a component, which only has valid
+     * escapes, in place. Unescaped chars are unreserved so they don't change how the url splits.
+     */
+    void normalize_escapes_in_place(string& s)
+    {
+        string::size_type w = s.find('%');
+        if( w == string::npos )
+            return;
+        char* p = &s[0];
+        const string::size_type n = s.size();
+        string::size_type r = w;
+        while( r < n ) {
+            // p[r] is a '%'
+            if( r + 2 < n && xdigit(p[r+1]) && xdigit(p[r+2]) ) {
+                char c = utils::x2digits_to_num(p[r+1], p[r+2]);
+                if( (url_char_table[(unsigned char)(c)] & (URL_CHAR_RESERVED|URL_CHAR_UNSAFE)) == 0 ) {
+                    p[w++] = c;
+                } else {
+                    p[w++] = '%';
+                    p[w++] = toupper(p[r+1]); // mandated by the rfc
+                    p[w++] = toupper(p[r+2]);
+                }
+                r += 3;
+            } else {
+                p[w++] = p[r++];
+            }
+            // move the run up to the next escape at once
+            const char* pct = (const char*)memchr(p + r, '%', n - r);
+            const string::size_type e = pct ? pct - p : n;
+            memmove(p + w, p + r, e - r);
+            w += e - r;
+            r = e;
+        }
+        s.resize(w);
+    }
+}
+
 void Url::normalize_escapes()
 {
-    string s = get();
-    s = normalize_escapes(s);
-    try {
-        assign(s);
-    } catch(UrlParseError e) {
-        string w("normalize_escapes: ");
-        w+=e.what();
-        throw runtime_error(w);
-    }
+    modified();
+    normalize_escapes_in_place(m_userinfo);
+    normalize_escapes_in_place(m_host);
+    // decoded chars are unreserved, they never introduce a '/'
+    normalize_escapes_in_place(_path.m_str);
+    _path.reindex();
+    normalize_escapes_in_place(m_query);
+    normalize_escapes_in_place(m_fragment);
 }
 
 void Url::normalize()
 {
+    if( m_normalized )
+        return;
+    // the normalized url doesn't change, neither does its fingerprint
+    const bool fp_valid = m_fp_valid;
     normalize_scheme();
-    normalize_host();
+    // unescape first so that escaped letters in the host get lowercased too
     normalize_escapes();
+    normalize_host();
     normalize_path();
-
+    m_normalized = true;
+    m_fp_valid = fp_valid;
 }
 
 /***** ACCESSORS *****/
 void Url::scheme(const string& s)
 {
+    modified();
     try {
-        regex re(url_regex[RE_SCHEME]);
-        if( regex_match(s,re) ) {
+        if( is_scheme(s.data(), s.size()) ) {
             m_scheme = s;
-            to_lower(m_scheme);
+            ascii_to_lower(m_scheme);
             //if( m_scheme == "file" )
             //    authority("/");
             m_has_authority = true;
         } else
-            throw UrlParseError("scheme: " + s + " doesn't match scheme validation regex");
-    } catch(regex_error re) {
-        throw UrlParseError("Url::scheme("+s+"): boost::regex_error: " + re.what());
+            throw UrlParseError("scheme: " + s + " doesn't match scheme syntax");
     } catch(UrlParseError e) {
         throw;
     } catch(...) {
@@ -405,6 +623,7 @@ void Url::scheme(const string& s)
  */
 void Url::authority(const string& s)
 {
+    modified();
     try {
         // [userinfo@]host[:port]
         string::size_type user_b = 0, user_e=0, host_b=0, host_e=0, port_b=0;
@@ -442,8 +661,6 @@ void Url::authority(const string& s)
                 }
             }
         }
-    } catch(regex_error re) {
-        throw UrlParseError("Url::authority("+s+"): boost::regex_error: " + re.what());
     } catch(UrlParseError e) {
         throw;
     } catch(...) {
@@ -495,11 +712,13 @@ bool Url::absolute() const
 
 void Url::userinfo(const string& s)
 {
+    modified();
     m_userinfo.assign(escape(s,URL_CHAR_AUTH));
 }
 
 void Url::host(const string& s)
 {
+    modified();
     // the rfc allows reg-name (host) to be escaped for non ASCII registered names
     // FIXME rfc 3490
     try {
@@ -512,8 +731,6 @@ void Url::host(const string& s)
             throw UrlParseError("Url::host("+s+"): Invalid host");
     } catch(UrlParseError) {
         throw;
-    } catch(regex_error re) {
-        throw UrlParseError("Url::host("+s+"): boost::regex_error: " + re.what());
     } catch(...) {
         throw UrlParseError("Url::host("+s+"): throwed an unknown exception");
     }
@@ -521,14 +738,14 @@ void Url::host(const string& s)
 
 void Url::port(const string& s)
 {
+    modified();
     // the rfc doesn't allow port to be escaped
     try {
         if( s.empty() ) {
             m_port.clear();
         } else {
-            regex re(url_regex[RE_PORT]);
-            if( ! regex_match(s,re) )
-                throw UrlParseError("Url::port("+s+"): Invalid port: regex didn't match");
+            if( ! is_port(s.data(), s.size()) )
+                throw UrlParseError("Url::port("+s+"): Invalid port: not 1 to 5 digits");
             int port;
             istringstream is(s);
             is >> port;
@@ -538,8 +755,6 @@ void Url::port(const string& s)
                 throw UrlParseError("Url::port("+s+"): out of range (0,2^16)");
             m_port.assign(s);
         }
-    } catch(regex_error re) {
-        throw UrlParseError("Url::port("+s+"): boost::regex_error: " + re.what());
     } catch(UrlParseError e) {
         throw;
     } catch(...) {
@@ -580,6 +795,7 @@ std::string Url::port() const
 
 void Url::path(const string& s)
 {
+    modified();
     _path.assign(escape(s,URL_CHAR_PATH));
     if( has_authority() )
         _path.absolute(true);
@@ -587,12 +803,14 @@ void Url::path(const string& s)
 
 void Url::query(const string& s)
 {
+    modified();
     m_query.assign(escape(s,URL_CHAR_QUERY));
     //_has_query = true;
 }
 
 void Url::fragment(const string& s)
 {
+    modified();
     m_fragment.assign(escape(s,URL_CHAR_FRAGMENT));
     //_has_fragment = true;
 }
@@ -618,29 +836,10 @@ void Url::set_def_port()
 }
 
 
-string Url::get() const {
+string Url::get() const
+{
     string res;
-    res.reserve(size());
-
-    if( ! m_scheme.empty() )  {
-        res += scheme();
-        res += ":";
-    }
-    if( has_authority() ) {
-        res += "//";
-        res += authority();
-    }
-    res += path();
-    res += query();
-    res += fragment();
-//    if( has_query() ) {
-//        res += "?";
-//        res += query();
-//    }
-//    if( has_fragment() ) {
-//        res += "#";
-//        res += fragment();
-//    }
+    write(res);
     return res;
 }
 
@@ -677,137 +876,84 @@ std::string Url::escape_reserved_unsafe(const std::string& s)
 
 std::string Url::escape(const string& s, const unsigned char mask)
 {
-    if(s.empty())
+    const Char_class& cls = Char_class::of(mask);
+    const char* p = s.data();
+    const string::size_type n = s.size();
+    string::size_type i = cls.find(p, n);
+    // nothing to escape, which is the common case
+    if( i == n )
         return s;
     string result;
-    string::size_type reserve_ahead = s.size();
-    for(string::const_iterator j = s.begin(); j != s.end(); ++j)  {
-        if( url_char_test(*j, mask) ) {
-            if(*j == '%' && (j+1) != s.end() && (j+2) != s.end()
-                && isxdigit(*(j+1)) && isxdigit(*(j+2)) ) {
-            } else {
-                reserve_ahead+=2; // escaping one, augments it by two more
-            }
+    result.reserve(n + n / 4 + 2);
+    string::size_type done = 0;
+    while( i < n ) {
+        result.append(p + done, i - done);
+        if( p[i] == '%' && i + 2 < n && xdigit(p[i+1]) && xdigit(p[i+2]) ) {
+            // this is a valid escaped sequence, don't escape the %
+            result.append(p + i, 3);
+            i += 3;
+        } else {
+            result += '%';
+            result += utils::digit_to_xnum((unsigned char)(p[i]) >> 4);
+            result += utils::digit_to_xnum(p[i] & 0xf);
+            ++i;
         }
+        done = i;
+        i += cls.find(p + i, n - i);
     }
-    result.reserve(reserve_ahead);
-    for(string::const_iterator i = s.begin(); i != s.end(); ++i) {
-        if( url_char_test(*i, mask) ) {
-            //cout << "test: " << *i << hex <<(int) *i << endl;
-            if(*i == '%' && (i+1) != s.end() && (i+2) != s.end()
-                && isxdigit(*(i+1)) && isxdigit(*(i+2)) ) {
-                // this is a valid escaped sequence, don't escape the %
-                result += *i;
-                result += *(i+1);
-                result += *(i+2);
-                i += 2;
-            } else {
-                char c1,c2;
-                //cout << " (*i) >> 4:" << hex << ((*i) >> 4) <<endl;
-                c1 = utils::digit_to_xnum((unsigned char)(*i) >> 4);
-                c2 = utils::digit_to_xnum( (*i) & 0xf);
-                result += "%";
-                result += c1;
-                result += c2;
+    result.append(p + done, n - done);
+    return result;
+}
+
+namespace {
+    /**
+     * Unescapes the valid escapes of s whose char satisfies decode, copying the runs between
+     * them at once.
+     */
+    template<class Decode>
+    string unescape_if(const string& s, Decode decode)
+    {
+        const char* p = s.data();
+        const string::size_type n = s.size();
+        const char* pct = (const char*)memchr(p, '%', n);
+        // avoid copying if there's nothing to unescape
+        if( ! pct )
+            return s;
+        string result;
+        result.reserve(n);
+        string::size_type done = 0;
+        for(string::size_type i = pct - p; ; i = pct - p) {
+            if( i + 2 < n && xdigit(p[i+1]) && xdigit(p[i+2]) ) {
+                const char c = utils::x2digits_to_num(p[i+1], p[i+2]);
+                if( decode(c) ) {
+                    result.append(p + done, i - done);
+                    result += c;
+                    done = i + 3;
+                    i += 2;
+                }
             }
-        } else {
-            result += (*i);
+            if( ! (pct = (const char*)memchr(p + i + 1, '%', n - i - 1)) )
+                break;
         }
+        result.append(p + done, n - done);
+        return result;
     }
-    result.reserve(); // shrink to fit
-    return result;
 }
 
 string Url::unescape(const string& s)
 {
-    // avoid copying if there's nothing to unescape
-    if( s.empty() || s.find('%') == string::npos )
-        return s;
-    string result;
-    result.reserve(s.size());
-    for(string::const_iterator i = s.begin(); i != s.end(); ++i) {
-        if( *i == '%' && (i+1) != s.end() && (i+2) != s.end()
-        && isxdigit(*(i+1)) && isxdigit(*(i+2)) //
-        && ((*(i+1)) != 0 || (*(i+2)) != 0)) { // can't unescape null
-
-            char c = utils::x2digits_to_num(*(i+1),*(i+2));
-            result += c;
-            i += 2; // increment the iterator
-        } else
-            result += (*i);
-    }
-    result.reserve(); // shrink to fit
-    return result;
+    return unescape_if(s, [](char) { return true; });
 }
 
 string Url::unescape(const string& s, const unsigned char mask) {
-    // avoid copying if there's nothing to unescape
-    if( s.empty() || (s.find('%') == string::npos ))
-        return s;
-    string result;
-    result.reserve(s.size());
-    for(string::const_iterator i = s.begin(); i != s.end(); ++i) {
-        if( *i == '%' && (i+1) != s.end() && (i+2) != s.end()
-        && isxdigit(*(i+1)) && isxdigit(*(i+2)) //
-        && ((*(i+1)) != 0 || (*(i+2)) != 0)) { // can't unescape null
-
-            char c = utils::x2digits_to_num(*(i+1),*(i+2));
-            if( url_char_test(c, mask)  ) {
-                result += c;
-                i += 2;
-            } else
-                result += (*i);
-        } else
-            result += (*i);
-    }
-    result.reserve(); // shrink to fit
-    return result;
+    return unescape_if(s, [mask](char c) { return url_char_test(c, mask); });
 }
 
 string Url::unescape_not(const string& s, const unsigned char mask) {
-    // avoid copying if there's nothing to unescape
-    if( s.empty() || (s.find('%') == string::npos ))
-        return s;
-    string result;
-    result.reserve(s.size());
-    for(string::const_iterator i = s.begin(); i != s.end(); ++i) {
-        if( *i == '%' && (i+1) != s.end() && (i+2) != s.end()
-        && isxdigit(*(i+1)) && isxdigit(*(i+2)) //
-        && ((*(i+1)) != 0 || (*(i+2)) != 0)) { // can't unescape null
-
-            char c = utils::x2digits_to_num(*(i+1),*(i+2));
-            if( (url_char_table[(unsigned char)(c)] & mask) == 0  ) {
-                result += c;
-                i += 2;
-            } else
-                result += (*i);
-        } else
-            result += (*i);
-    }
-    result.reserve(); // shrink to fit
-    return result;
+    return unescape_if(s, [mask](char c) { return url_char_test(c, mask) == 0; });
 }
 
 string Url::unescape_safe(const string& s) {
-    // avoid copying if there's nothing to unescape
-    if( s.empty() || (s.find('%') == string::npos ))
-        return s;
-    string result;
-    result.reserve(s.size());
-    for(string::const_iterator i = s.begin(); i != s.end(); ++i) {
-        if( *i == '%' && (i+1) != s.end() && (i+2) != s.end()
-        && isxdigit(*(i+1)) && isxdigit(*(i+2)) //
-        && ((*(i+1)) != 0 || (*(i+2)) != 0)) { // can't unescape null
-
-            char c = utils::x2digits_to_num(*(i+1),*(i+2));
-            if( (url_char_table[(unsigned char)(c)] & (URL_CHAR_RESERVED|URL_CHAR_UNSAFE)) == 0 ) { // not reserved or unsafe
-                result += c;
-                i += 2;
-            } else
-                result += (*i);
-        } else
-            result += (*i);
-    }
-    result.reserve(); // shrink to fit
-    return result;
+    // not reserved or unsafe
+    return unescape_if(s, [](char c) { return url_char_test(c, URL_CHAR_RESERVED|URL_CHAR_UNSAFE) == 0; });
 }
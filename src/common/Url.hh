@@ -47,8 +47,8 @@
 #include <stdexcept>
 #include <cctype>
 #include <sstream>
+#include <functional>
 #include <stdint.h>
-#include <boost/regex.hpp>
 
 #include "utils.hh"
 #include "Path.hh"
@@ -57,7 +57,8 @@
 namespace Url_util {
 
 /**
- * Validating regexps
+ * Grammar of the url components, as regexps. They are kept as the reference of the hand
+ * written parser and validators below, which accept exactly the same strings.
  */
 /*
       IPv6address =                            6( h16 ":" ) ls32
@@ -137,6 +138,53 @@ static const char* const url_regex[] = {
 #undef ipv4
 #undef decoct
 
+/**
+ * @brief Components of an url, the groups of the RE_URL regexp
+ *
+ * Parts point into the string that was split. The path always matches, possibly empty,
+ * query includes the leading '?' and fragment the leading '#'.
+ */
+struct Url_split {
+    struct Part {
+        Part() : b(0), len(0), matched(false) {}
+        Part(const char* b, const char* e) : b(b), len(e - b), matched(true) {}
+        std::string str() const { return std::string(b, len); }
+        const char* b;
+        size_t len;
+        bool matched;
+    };
+    Part scheme;
+    /// present, maybe empty, if there's "//" after the scheme
+    Part authority;
+    Part path;
+    Part query;
+    Part fragment;
+};
+
+/// split an url in its components, as RE_URL, any string splits
+void split(const char* s, size_t len, Url_split& res);
+
+/// @return true if s matches RE_SCHEME
+bool is_scheme(const char* s, size_t len);
+
+/// @return true if s matches RE_HOST
+bool is_reg_name(const char* s, size_t len);
+
+/// @return true if s matches RE_IPVFUT
+bool is_ipvfuture(const char* s, size_t len);
+
+/// @return true if s matches RE_IPV6
+bool is_ipv6(const char* s, size_t len);
+
+/// @return true if s matches RE_IPV4
+bool is_ipv4(const char* s, size_t len);
+
+/// @return true if s matches RE_PORT
+bool is_port(const char* s, size_t len);
+
+/// @return true if s is a reg-name or an ip address, not escaped
+bool is_host(const char* s, size_t len);
+
 /**
  * Url escaping
  */
@@ -343,8 +391,9 @@ public:
      * @throws BadUrl
      */
     Url& operator+=(const Url& u);
-    bool operator==(const Url& u);
-    bool operator!=(const Url& u);
+    /// equal if the normalized urls are, the fingerprints are compared first
+    bool operator==(const Url& u) const;
+    bool operator!=(const Url& u) const;
 
     // Safe bool idiom, operator bool causes unintended conversions to char, so we can use operator std::string
     // http://www.artima.com/cppsource/safebool2.html
@@ -369,17 +418,28 @@ public:
     void normalize_scheme() ;
     void normalize_host() ;
     /**
-     * normalize pct-encoded escapes to uppercase as mandated by rfc
+     * normalize pct-encoded escapes to uppercase as mandated by rfc, unescaping the safe ones
+     * in place in every component
      */
     void normalize_escapes();
     static std::string normalize_escapes(const std::string&) ;
     /**
-     * does all normalizations
+     * does all normalizations, it's a noop if the url is already normalized
      */
     void normalize();
 
+    /// @return true if normalize() was called and the url hasn't been modified since
+    bool normalized() const { return m_normalized; }
+
+    /**
+     * @brief 64 bit xxHash of the normalized url, computed on first use and cached
+     * Urls that are equal have the same fingerprint, it's meant for hashing and dedup.
+     */
+    uint64_t fingerprint() const;
+
     void clear() {
         m_suspicious=false;
+        modified();
 
         m_scheme.clear();
         clear_authority();
@@ -405,6 +465,40 @@ public:
     std::string to_string() const { return get(); };
     std::string as_string() const { return get(); };
 
+    /**
+     * @brief append the url to out piece by piece, same result as get()
+     * @param out anything with append(const char*, size_t), like std::string
+     */
+    template<class Sink>
+    void write(Sink& out) const
+    {
+        if( ! m_scheme.empty() ) {
+            out.append(m_scheme.data(), m_scheme.size());
+            out.append(":", 1);
+        }
+        if( has_authority() ) {
+            out.append("//", 2);
+            if( ! m_host.empty() ) {
+                if( ! m_userinfo.empty() ) {
+                    out.append(m_userinfo.data(), m_userinfo.size());
+                    out.append("@", 1);
+                }
+                if( m_host_ip_literal )
+                    out.append("[", 1);
+                out.append(m_host.data(), m_host.size());
+                if( m_host_ip_literal )
+                    out.append("]", 1);
+                if( ! m_port.empty() ) {
+                    out.append(":", 1);
+                    out.append(m_port.data(), m_port.size());
+                }
+            }
+        }
+        _path.write(out);
+        out.append(m_query.data(), m_query.size());
+        out.append(m_fragment.data(), m_fragment.size());
+    }
+
     /**
      * Size of the url when represented as an string
      */
@@ -440,7 +534,6 @@ public:
     /**
      * The rfc says: "If a URI does not contain an authority component, then the path cannot begin with two slash characters ("//")"
      * But then, there are the file:// URIs that can be file:///tmp/ or similar, so this apparently violates the rfc.
-     * @throws boost::regex_error
      */
     bool syntax_ok() const ;
     bool valid_host() const;
@@ -470,6 +563,7 @@ public:
     }
 
     void clear_authority()  {
+        modified();
         m_host_ip_literal=false;
         m_has_authority = false;
         m_userinfo.clear();
@@ -481,6 +575,7 @@ public:
 
     void clear_query()
     {
+        modified();
         // _has_query = false;
         m_query.clear();
     }
@@ -489,6 +584,7 @@ public:
 
     void clear_fragment()
     {
+        modified();
         // _has_fragment = false;
         m_fragment.clear();
     }
@@ -538,6 +634,7 @@ public:
     Path        _path;
 
     friend class Url_lexer;
+    friend class Compact_url;
 
 //    protected:
     /**
@@ -564,6 +661,30 @@ public:
     // fragment
     //bool        _has_fragment;
     std::string m_fragment;
+
+private:
+    /// set by normalize(), cleared by any modification
+    bool m_normalized;
+
+    /// fingerprint() cache, valid until the url is modified
+    mutable bool m_fp_valid;
+    mutable uint64_t m_fp;
+
+    /// to be called by anything that changes the url
+    void modified()
+    {
+        m_normalized = false;
+        m_fp_valid = false;
+    }
+
+    /// same components, which implies the same serialization
+    bool same_parts(const Url& u) const;
+};
+
+namespace std {
+    template<> struct hash<Url> {
+        size_t operator()(const Url& u) const { return u.fingerprint(); }
+    };
 };
 
 
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+// boost first, the D() macro of utils.hh breaks its headers
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Url_batch.hh"
+
+using namespace std;
+
+namespace url_batch {
+
+namespace {
+    /// less than this per thread isn't worth starting one
+    const size_t MIN_CHUNK = 2048;
+
+    /// run f(b, e) on [0, n) split in contiguous chunks, one per thread
+    template<class F>
+    void for_chunks(size_t n, size_t threads, F f)
+    {
+        if (! threads)
+            threads = max(boost::thread::hardware_concurrency(), 1u);
+        threads = min(threads, max<size_t>(n / MIN_CHUNK, 1));
+        if (threads == 1) {
+            f(0, n);
+            return;
+        }
+
+        const size_t chunk = (n + threads - 1) / threads;
+        boost::thread_group group;
+        for (size_t b = chunk; b < n; b += chunk)
+            group.create_thread(boost::bind<void>(f, b, min(b + chunk, n)));
+        // the first chunk is done by the caller
+        f(0, min(chunk, n));
+        group.join_all();
+    }
+
+    struct Parse {
+        Parse(const vector<string>& in, vector<Url>& out, vector<char>& ok) : in(in), out(out), ok(ok) {}
+
+        void operator()(size_t b, size_t e) const
+        {
+            for (size_t i = b; i < e; ++i) {
+                try {
+                    out[i].assign(in[i]);
+                    ok[i] = true;
+                } catch (BadUrl&) {
+                    out[i].clear();
+                } catch (runtime_error&) {
+                    out[i].clear();
+                }
+            }
+        }
+
+        const vector<string>& in;
+        vector<Url>& out;
+        vector<char>& ok;
+    };
+
+    struct Normalize {
+        Normalize(const vector<string>& in, Normalized& out) : in(in), out(out) {}
+
+        void operator()(size_t b, size_t e) const
+        {
+            Url u;
+            for (size_t i = b; i < e; ++i) {
+                try {
+                    u.assign(in[i]);
+                    u.normalize();
+                    out.urls[i] = u.get();
+                    out.hosts[i] = u.host();
+                    out.fingerprints[i] = u.fingerprint();
+                    out.ok[i] = true;
+                } catch (BadUrl&) {
+                } catch (runtime_error&) {
+                }
+            }
+        }
+
+        const vector<string>& in;
+        Normalized& out;
+    };
+}
+
+void parse(const vector<string>& in, vector<Url>& out, vector<char>& ok, size_t threads)
+{
+    out.clear();
+    out.resize(in.size());
+    ok.assign(in.size(), false);
+    for_chunks(in.size(), threads, Parse(in, out, ok));
+}
+
+void normalize(const vector<string>& in, Normalized& out, size_t threads)
+{
+    out.urls.clear();
+    out.urls.resize(in.size());
+    out.hosts.clear();
+    out.hosts.resize(in.size());
+    out.fingerprints.assign(in.size(), 0);
+    out.ok.assign(in.size(), false);
+    for_chunks(in.size(), threads, Normalize(in, out));
+}
+
+}; // namespace url_batch
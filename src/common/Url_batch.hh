@@ -0,0 +1,51 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup Url
+ * @{
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Url.hh"
+
+/**
+ * @brief Parse and normalize many urls in one call
+ *
+ * Meant for the python bindings, where crossing into C++ once per url costs more than the
+ * work itself. Nothing here touches python objects, so the callers can release the GIL, and
+ * the work can be split among threads, each one filling its own range of the results.
+ */
+namespace url_batch {
+
+    /// Results of normalize(), ok[i] is false if in[i] couldn't be parsed
+    struct Normalized {
+        std::vector<std::string> urls;
+        /// the normalized host, to group urls by server
+        std::vector<std::string> hosts;
+        /// @sa Url::fingerprint()
+        std::vector<uint64_t> fingerprints;
+        std::vector<char> ok;
+    };
+
+    /**
+     * @brief parse every string of in
+     * @param threads 0 uses one per core, small batches are processed in the calling thread
+     * out[i] is left empty if in[i] couldn't be parsed
+     */
+    void parse(const std::vector<std::string>& in, std::vector<Url>& out, std::vector<char>& ok, size_t threads = 1);
+
+    /// parse and normalize every string of in, @sa parse for threads
+    void normalize(const std::vector<std::string>& in, Normalized& out, size_t threads = 1);
+};
+
+/** @} */
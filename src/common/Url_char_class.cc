@@ -0,0 +1,189 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+#include "Url_char_class.hh"
+
+#include <cassert>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define URL_CHAR_CLASS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace Url_util {
+
+struct Char_class_table {
+    Char_class_table()
+    {
+        for (unsigned m = 0; m < 256; ++m)
+            classes[m] = Char_class(m);
+    }
+    Char_class classes[256];
+};
+
+Char_class::Find_fn Char_class::s_find = &Char_class::find_scalar;
+const bool Char_class::s_dispatched = (s_find = impl_fn(best()), true);
+
+Char_class::Char_class(unsigned char mask) :
+    m_mask(mask),
+    m_bitmap(),
+    m_high(url_char_test(0x80, mask)),
+    m_simd(true)
+{
+    for (unsigned c = 0; c < 0x80; ++c)
+        if (url_char_test(c, mask))
+            m_bitmap[c & 0xF] |= 1 << (c >> 4);
+    for (unsigned c = 0x80; c < 0x100; ++c)
+        if (!! url_char_test(c, mask) != m_high)
+            m_simd = false;
+}
+
+const Char_class& Char_class::of(unsigned char mask)
+{
+    static const Char_class_table table;
+    return table.classes[mask];
+}
+
+Char_class::Impl Char_class::best()
+{
+    if (supported(AVX2))
+        return AVX2;
+    if (supported(SSSE3))
+        return SSSE3;
+    return SCALAR;
+}
+
+bool Char_class::supported(Impl impl)
+{
+#ifdef URL_CHAR_CLASS_X86
+    __builtin_cpu_init();
+    switch (impl) {
+        case AVX2: return __builtin_cpu_supports("avx2");
+        case SSSE3: return __builtin_cpu_supports("ssse3");
+        default: return true;
+    }
+#else
+    return impl == SCALAR;
+#endif
+}
+
+Char_class::Find_fn Char_class::impl_fn(Impl impl)
+{
+    switch (impl) {
+        case AVX2: return &find_avx2;
+        case SSSE3: return &find_ssse3;
+        default: return &find_scalar;
+    }
+}
+
+size_t Char_class::find(const char* s, size_t len, Impl impl) const
+{
+    assert(supported(impl));
+    return impl_fn(impl)(*this, s, len);
+}
+
+size_t Char_class::find_scalar(const Char_class& cls, const char* s, size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+        if (url_char_test(s[i], cls.m_mask))
+            return i;
+    return len;
+}
+
+#ifdef URL_CHAR_CLASS_X86
+
+namespace {
+    /// bit i of the result is set if byte i of v is in the class
+    __attribute__((target("ssse3")))
+    inline unsigned match16(__m128i v, __m128i bitmap, __m128i bits, bool high)
+    {
+        const __m128i nibble = _mm_set1_epi8(0xF);
+        const __m128i lo = _mm_and_si128(v, nibble);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+        // bits has zeros for the high nibbles of non ascii bytes
+        const __m128i in = _mm_and_si128(_mm_shuffle_epi8(bitmap, lo), _mm_shuffle_epi8(bits, hi));
+        unsigned res = ~_mm_movemask_epi8(_mm_cmpeq_epi8(in, _mm_setzero_si128())) & 0xFFFF;
+        if (high)
+            res |= _mm_movemask_epi8(v);
+        return res;
+    }
+
+    __attribute__((target("avx2")))
+    inline unsigned match32(__m256i v, __m256i bitmap, __m256i bits, bool high)
+    {
+        const __m256i nibble = _mm256_set1_epi8(0xF);
+        const __m256i lo = _mm256_and_si256(v, nibble);
+        const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+        const __m256i in = _mm256_and_si256(_mm256_shuffle_epi8(bitmap, lo), _mm256_shuffle_epi8(bits, hi));
+        unsigned res = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(in, _mm256_setzero_si256()));
+        if (high)
+            res |= (unsigned)_mm256_movemask_epi8(v);
+        return res;
+    }
+
+    const unsigned char HIGH_NIBBLE_BITS[16] = {
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+}
+
+__attribute__((target("ssse3")))
+size_t Char_class::find_ssse3(const Char_class& cls, const char* s, size_t len)
+{
+    if (len < 16 || ! cls.m_simd)
+        return find_scalar(cls, s, len);
+    const __m128i bitmap = _mm_loadu_si128((const __m128i*)cls.m_bitmap);
+    const __m128i bits = _mm_loadu_si128((const __m128i*)HIGH_NIBBLE_BITS);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        const unsigned m = match16(_mm_loadu_si128((const __m128i*)(s + i)), bitmap, bits, cls.m_high);
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+    if (i == len)
+        return len;
+    // the last block overlaps bytes already known not to match
+    i = len - 16;
+    const unsigned m = match16(_mm_loadu_si128((const __m128i*)(s + i)), bitmap, bits, cls.m_high);
+    return m ? i + __builtin_ctz(m) : len;
+}
+
+__attribute__((target("avx2")))
+size_t Char_class::find_avx2(const Char_class& cls, const char* s, size_t len)
+{
+    if (len < 32 || ! cls.m_simd)
+        return find_ssse3(cls, s, len);
+    const __m256i bitmap = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)cls.m_bitmap));
+    const __m256i bits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)HIGH_NIBBLE_BITS));
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        const unsigned m = match32(_mm256_loadu_si256((const __m256i*)(s + i)), bitmap, bits, cls.m_high);
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+    if (i == len)
+        return len;
+    i = len - 32;
+    const unsigned m = match32(_mm256_loadu_si256((const __m256i*)(s + i)), bitmap, bits, cls.m_high);
+    return m ? i + __builtin_ctz(m) : len;
+}
+
+#else
+
+size_t Char_class::find_ssse3(const Char_class& cls, const char* s, size_t len)
+{
+    return find_scalar(cls, s, len);
+}
+
+size_t Char_class::find_avx2(const Char_class& cls, const char* s, size_t len)
+{
+    return find_scalar(cls, s, len);
+}
+
+#endif
+
+}; // end namespace
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup Url
+ * @{
+ */
+#pragma once
+
+#include <cstddef>
+
+#include "Url.hh"
+
+namespace Url_util {
+
+/**
+ * @class Char_class Url_char_class.hh
+ * @brief Set of chars c with url_char_table[c] & mask, with a vectorized search
+ *
+ * Most url components have nothing to escape, so escaping is mostly scanning for the first char
+ * that needs it. find() does that 16 or 32 bytes at a time with SSSE3 or AVX2 when the cpu has
+ * them, checked once at startup, and falls back to the table lookup otherwise.
+ */
+class Char_class {
+public:
+    enum Impl {
+        SCALAR,
+        SSSE3,
+        AVX2
+    };
+
+    /// @return the class for mask, they are built once and shared
+    static const Char_class& of(unsigned char mask);
+
+    /// @return the best implementation the cpu supports
+    static Impl best();
+    static bool supported(Impl impl);
+
+    bool test(char c) const { return url_char_test(c, m_mask); }
+
+    /// @return offset of the first char of the class in [s, s + len), len if there's none
+    size_t find(const char* s, size_t len) const { return s_find(*this, s, len); }
+
+    /// same with a given implementation, which must be supported
+    size_t find(const char* s, size_t len, Impl impl) const;
+
+private:
+    typedef size_t (*Find_fn)(const Char_class&, const char*, size_t);
+
+    explicit Char_class(unsigned char mask = 0);
+
+    static size_t find_scalar(const Char_class& cls, const char* s, size_t len);
+    static size_t find_ssse3(const Char_class& cls, const char* s, size_t len);
+    static size_t find_avx2(const Char_class& cls, const char* s, size_t len);
+    static Find_fn impl_fn(Impl impl);
+
+    /// set on startup, before that it's the scalar one
+    static Find_fn s_find;
+    static const bool s_dispatched;
+
+    unsigned char m_mask;
+    /**
+     * For ascii c, bit (c >> 4) of m_bitmap[c & 0xF] is set if c is in the class, the lookup
+     * of both nibbles is a shuffle each.
+     */
+    unsigned char m_bitmap[16];
+    /// bytes >= 0x80 are all in the class or none is
+    bool m_high;
+    /// false if the above doesn't hold, the scalar search is used then
+    bool m_simd;
+
+    friend struct Char_class_table;
+};
+
+}; // end namespace
+
+/** @} */
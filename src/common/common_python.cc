@@ -3,9 +3,106 @@
 #include <boost/python.hpp>
 
 #include "Url.hh"
+#include "Url_batch.hh"
 #include "HTML_lexer.hh"
+#include "Html_batch.hh"
 using namespace boost::python;
 
+namespace {
+    /// releases the GIL while in scope, no python objects can be touched meanwhile
+    class Gil_release {
+    public:
+        Gil_release() : m_state(PyEval_SaveThread()) {}
+        ~Gil_release() { PyEval_RestoreThread(m_state); }
+    private:
+        PyThreadState* m_state;
+    };
+
+    std::vector<std::string> to_strings(const object& seq)
+    {
+        std::vector<std::string> res;
+        stl_input_iterator<std::string> end;
+        for (stl_input_iterator<std::string> i(seq); i != end; ++i)
+            res.push_back(*i);
+        return res;
+    }
+
+    /// @return list of Url, None for the ones that couldn't be parsed
+    list parse_many(const object& seq, size_t threads)
+    {
+        const std::vector<std::string> in = to_strings(seq);
+        std::vector<Url> urls;
+        std::vector<char> ok;
+        {
+            Gil_release nogil;
+            url_batch::parse(in, urls, ok, threads);
+        }
+        list res;
+        for (size_t i = 0; i < urls.size(); ++i)
+            res.append(ok[i] ? object(urls[i]) : object());
+        return res;
+    }
+
+    /// @return tuple of flat lists (urls, hosts, fingerprints), None for the ones that couldn't be parsed
+    tuple normalize_many(const object& seq, size_t threads)
+    {
+        const std::vector<std::string> in = to_strings(seq);
+        url_batch::Normalized out;
+        {
+            Gil_release nogil;
+            url_batch::normalize(in, out, threads);
+        }
+        list urls;
+        list hosts;
+        list fingerprints;
+        for (size_t i = 0; i < in.size(); ++i) {
+            if (out.ok[i]) {
+                urls.append(out.urls[i]);
+                hosts.append(out.hosts[i]);
+                fingerprints.append(out.fingerprints[i]);
+            } else {
+                urls.append(object());
+                hosts.append(object());
+                fingerprints.append(object());
+            }
+        }
+        return make_tuple(urls, hosts, fingerprints);
+    }
+
+    ProcHTML html_lex_nogil(const std::string& html, const std::string& base_url, const std::string& http_charset)
+    {
+        Gil_release nogil;
+        return html_lex(html, base_url, http_charset);
+    }
+
+    /// @return list of ProcHTML, in the order of the (html, base_url[, http_charset]) tuples of seq
+    list html_lex_batch(const object& seq, size_t threads)
+    {
+        std::vector<std::string> html;
+        std::vector<std::string> base_urls;
+        std::vector<std::string> charsets;
+        stl_input_iterator<object> end;
+        for (stl_input_iterator<object> i(seq); i != end; ++i) {
+            html.push_back(extract<std::string>((*i)[0]));
+            base_urls.push_back(extract<std::string>((*i)[1]));
+            charsets.push_back(len(*i) > 2 ? extract<std::string>((*i)[2])() : std::string());
+        }
+        std::vector<html_batch::Doc> docs;
+        docs.reserve(html.size());
+        for (size_t i = 0; i < html.size(); ++i)
+            docs.push_back(html_batch::Doc(html[i], base_urls[i], &charsets[i]));
+        std::vector<ProcHTML> out;
+        {
+            Gil_release nogil;
+            html_batch::lex(docs, out, threads);
+        }
+        list res;
+        for (size_t i = 0; i < out.size(); ++i)
+            res.append(out[i]);
+        return res;
+    }
+}
+
 //BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(xf_overloads, scheme, 0, 1)
 BOOST_PYTHON_MODULE_INIT(common)
 {
@@ -40,8 +137,6 @@ BOOST_PYTHON_MODULE_INIT(common)
         .def(init<>())
         .def("__str__", &Url::operator std::string)
         .def("__repr__", &Url::operator std::string)
-        .def(self == self)
-        .def(self != self)
         .def(not self)
         //.def("merge_ref", &Url::merge_ref)
         .def("assign", &Url::assign,
@@ -90,18 +185,33 @@ BOOST_PYTHON_MODULE_INIT(common)
 
         .def("absolute", &Url::absolute)
 
+        .def("fingerprint", &Url::fingerprint,
+            "64 bit hash of the normalized url")
+        // urls equal by Url::operator== have the same fingerprint, so they work as dict keys
+        .def("__hash__", &Url::fingerprint)
+        .def(self == self)
+        .def(self != self)
+
     ;
 
     def("escape_reserved_unsafe", &Url::escape_reserved_unsafe);
     def("unescape_all", unescape_all);
 
-	def("html_lex", html_lex, "Parse an HTML document, first arg is the HTML content as a string, and the second is the url of this document, needed to resolve relative links");
+    def("parse_many", parse_many, (arg("urls"), arg("threads") = 1),
+        "parse a sequence of strings at once without holding the GIL, returns a list of Url with None for the ones that can't be parsed. threads=0 uses one thread per core");
+    def("normalize_many", normalize_many, (arg("urls"), arg("threads") = 1),
+        "parse and normalize a sequence of strings at once without holding the GIL, returns a tuple of lists (normalized urls, hosts, fingerprints) with None for the ones that can't be parsed. threads=0 uses one thread per core");
+
+	def("html_lex", html_lex_nogil, (arg("html"), arg("base_url"), arg("http_charset") = std::string()),
+		"Parse an HTML document, first arg is the HTML content as a string, and the second is the url of this document, needed to resolve relative links. The document is converted to UTF-8 from the charset of its BOM, http_charset, its meta tags or a guess, in that order");
+	def("html_lex_batch", html_lex_batch, (arg("docs"), arg("threads") = 1),
+		"parse a sequence of (html, base_url) or (html, base_url, http_charset) tuples without holding the GIL, returns a list of ProcHTML in the same order. threads=0 uses one thread per core");
 	class_<Analysis>("Analysis")
 		.def_readwrite("title", &Analysis::title, "title of the page")
 		.def_readwrite("rss2", &Analysis::rss2)
 		.def_readwrite("rss", &Analysis::rss)
 		.def_readwrite("atom", &Analysis::atom)
-		.def_readwrite("charset", &Analysis::charset, "encoding of the page")
+		.def_readwrite("charset", &Analysis::charset, "encoding the page was read as")
 		.def_readwrite("index", &Analysis::index, "meta.name.robots.index")
 		.def_readwrite("follow", &Analysis::follow, "meta.name.follow")
 	;	
@@ -442,26 +442,26 @@ namespace utils {
         return gotone;   /* don't claim it's UTF-8 if it's all 7-bit */
     }
 
-    const char* unicode_BOM(const uint8_t *buf, size_t nbytes)
+    const char* unicode_BOM(const uint8_t *buf, size_t nbytes, size_t* bom_len)
     {
-        if(nbytes < 2)
-            return NULL;
-        else if(nbytes >= 2) {
-            if( *(uint16_t*)buf == 0xFEFF )
-                //return content_type::FILE_TEXT_UTF16BE;
-                return "UTF-16BE";
-            else if( *(uint16_t*)buf  == 0xFFFE )
-                //return content_type::FILE_TEXT_UTF16LE;
-                return "UTF-16LE";
-            if(nbytes >= 3 && buf[0] == 0xEF && buf[1] == 0xBB && buf[2] == 0xBF)
-                //return content_type::FILE_TEXT_UTF8;
-                return "UTF-8";
-            if(nbytes >= 4 && *(uint32_t*)buf == 0x0000FEFF)
-                //return content_type::FILE_TEXT_UTF32BE;
-                return "UTF-32BE";
-            if(nbytes >= 4 && *(uint32_t*)buf == 0xFEFF0000)
-                //return content_type::FILE_TEXT_UTF32LE;
-                return "UTF-32LE";
+        // the bytes, not a word of the host order, and UTF-32LE before the UTF-16LE it starts with
+        static const struct {
+            const char* name;
+            size_t len;
+            uint8_t bytes[4];
+        } BOMS[] = {
+            {"UTF-32BE", 4, {0x00, 0x00, 0xFE, 0xFF}},
+            {"UTF-32LE", 4, {0xFF, 0xFE, 0x00, 0x00}},
+            {"UTF-8", 3, {0xEF, 0xBB, 0xBF}},
+            {"UTF-16BE", 2, {0xFE, 0xFF}},
+            {"UTF-16LE", 2, {0xFF, 0xFE}},
+        };
+        for (size_t i = 0; i < sizeof(BOMS) / sizeof(BOMS[0]); ++i) {
+            if (nbytes >= BOMS[i].len && ! memcmp(buf, BOMS[i].bytes, BOMS[i].len)) {
+                if (bom_len)
+                    *bom_len = BOMS[i].len;
+                return BOMS[i].name;
+            }
         }
         return NULL;
     }
@@ -161,9 +161,10 @@ template<typename T>void int_put(void* b, T t) {
 
     /**
      * Check for BOM
+     * @param[out] bom_len if not NULL, set to the length of the BOM when there's one
      * @return string with unicode type or NULL
      */
-    const char* unicode_BOM(const uint8_t *buf, size_t nbytes);
+    const char* unicode_BOM(const uint8_t *buf, size_t nbytes, size_t* bom_len = 0);
 
     /**
      * Get version of PDF stored in buf
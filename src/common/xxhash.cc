@@ -0,0 +1,139 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+#include "xxhash.hh"
+#include <cstring>
+
+namespace {
+    const uint64_t P1 = 11400714785074694791ULL;
+    const uint64_t P2 = 14029467366897019727ULL;
+    const uint64_t P3 =  1609587929392839161ULL;
+    const uint64_t P4 =  9650029242287828579ULL;
+    const uint64_t P5 =  2870177450012600261ULL;
+
+    inline uint64_t rotl(uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    /// little endian loads, memcpy keeps them safe on unaligned data
+    inline uint64_t read64(const unsigned char* p)
+    {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint32_t read32(const unsigned char* p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint64_t round(uint64_t acc, uint64_t input)
+    {
+        acc += input * P2;
+        acc = rotl(acc, 31);
+        return acc * P1;
+    }
+
+    inline uint64_t merge_round(uint64_t acc, uint64_t v)
+    {
+        acc ^= round(0, v);
+        return acc * P1 + P4;
+    }
+}
+
+Xxhash64::Xxhash64(uint64_t seed)
+{
+    reset(seed);
+}
+
+void Xxhash64::reset(uint64_t seed)
+{
+    m_seed = seed;
+    m_v[0] = seed + P1 + P2;
+    m_v[1] = seed + P2;
+    m_v[2] = seed;
+    m_v[3] = seed - P1;
+    m_total = 0;
+    m_buf_len = 0;
+}
+
+void Xxhash64::update(const void* data, size_t len)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* const end = p + len;
+    m_total += len;
+
+    if (m_buf_len + len < sizeof(m_buf)) {
+        memcpy(m_buf + m_buf_len, p, len);
+        m_buf_len += len;
+        return;
+    }
+
+    if (m_buf_len) {
+        const size_t fill = sizeof(m_buf) - m_buf_len;
+        memcpy(m_buf + m_buf_len, p, fill);
+        p += fill;
+        for (int i = 0; i < 4; ++i)
+            m_v[i] = round(m_v[i], read64(m_buf + 8 * i));
+        m_buf_len = 0;
+    }
+
+    for (; p + 32 <= end; p += 32)
+        for (int i = 0; i < 4; ++i)
+            m_v[i] = round(m_v[i], read64(p + 8 * i));
+
+    m_buf_len = end - p;
+    memcpy(m_buf, p, m_buf_len);
+}
+
+uint64_t Xxhash64::digest() const
+{
+    uint64_t h;
+    if (m_total >= 32) {
+        h = rotl(m_v[0], 1) + rotl(m_v[1], 7) + rotl(m_v[2], 12) + rotl(m_v[3], 18);
+        for (int i = 0; i < 4; ++i)
+            h = merge_round(h, m_v[i]);
+    } else {
+        h = m_seed + P5;
+    }
+    h += m_total;
+
+    const unsigned char* p = m_buf;
+    const unsigned char* const end = m_buf + m_buf_len;
+    for (; p + 8 <= end; p += 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * P1 + P4;
+    }
+    if (p + 4 <= end) {
+        h ^= read32(p) * P1;
+        h = rotl(h, 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= *p * P5;
+        h = rotl(h, 11) * P1;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t Xxhash64::hash(const void* data, size_t len, uint64_t seed)
+{
+    Xxhash64 h(seed);
+    h.update(data, len);
+    return h.digest();
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup utils
+ * @{
+ */
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * @brief Streaming 64 bit xxHash (XXH64)
+ *
+ * Non cryptographic, fast and with good dispersion, used to fingerprint urls. Feeding the data
+ * in several update() calls gives the same digest as hashing it at once, so the input doesn't
+ * need to be contiguous.
+ */
+class Xxhash64 {
+public:
+    explicit Xxhash64(uint64_t seed = 0);
+
+    void reset(uint64_t seed = 0);
+
+    void update(const void* data, size_t len);
+
+    /// @return the hash of the data fed so far, more data can still be added afterwards
+    uint64_t digest() const;
+
+    /// hash a buffer at once
+    static uint64_t hash(const void* data, size_t len, uint64_t seed = 0);
+
+private:
+    uint64_t m_v[4];
+    uint64_t m_seed;
+    uint64_t m_total;
+    /// pending bytes that don't fill a stripe yet
+    unsigned char m_buf[32];
+    size_t m_buf_len;
+};
+
+/** @} */
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+#include "Concurrency_controller.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+/// Overshoot allowed over the bandwidth setpoint before backing off
+static const double BANDWIDTH_TOLERANCE = 1.1;
+
+Concurrency_controller::Concurrency_controller(size_t active, size_t min_active, size_t max_active) :
+    step(1),
+    decrease(0.75),
+    min_handle_kBs(1),
+    m_enabled(false),
+    m_active(active),
+    m_min_active(1),
+    m_max_active(active),
+    m_target_kBs(0),
+    m_max_cpu(90)
+{
+    range(min_active, max_active);
+    this->active(active);
+}
+
+void Concurrency_controller::range(size_t min_active, size_t max_active)
+{
+    if (min_active == 0 || min_active > max_active)
+        throw std::invalid_argument("Concurrency_controller: invalid range");
+    m_min_active = min_active;
+    m_max_active = max_active;
+    active(m_active);
+}
+
+void Concurrency_controller::active(size_t n)
+{
+    m_active = std::min(std::max(n, m_min_active), m_max_active);
+}
+
+size_t Concurrency_controller::update(const Sample& s)
+{
+    if (! m_enabled)
+        return m_active;
+
+    bool over_cpu = m_max_cpu > 0 && s.cpu > m_max_cpu;
+    bool over_bw = m_target_kBs > 0 && s.kBs > m_target_kBs * BANDWIDTH_TOLERANCE;
+
+    if (over_cpu || over_bw) {
+        active(static_cast<size_t>(m_active * decrease));
+
+    } else if ((m_target_kBs <= 0 || s.kBs < m_target_kBs)
+        && s.waiting > 0
+        && s.busy >= m_active
+        && (s.busy == 0 || s.handle_kBs >= min_handle_kBs)) {
+        active(m_active + step);
+    }
+    return m_active;
+}
+
+ostream& operator<<(ostream& os, const Concurrency_controller& c)
+{
+    os << "active: " << c.m_active
+        << " range: [" << c.m_min_active << ", " << c.m_max_active << "]"
+        << " autoscale: " << (c.m_enabled ? "on" : "off")
+        << " target: " << c.m_target_kBs << " KB/s"
+        << " max cpu: " << c.m_max_cpu << "%";
+    return os;
+}
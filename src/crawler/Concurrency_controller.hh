@@ -0,0 +1,100 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup crawler
+ * @{
+ */
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+
+/**
+ * @brief AIMD controller for the number of active easy handles
+ *
+ * Fed periodically with measurements of the crawl (aggregate download rate,
+ * process CPU usage, per handle rates and queued work), it decides how many
+ * easy handles should be active.
+ *
+ * While the bandwidth setpoint is not reached, CPU is below its ceiling and
+ * there are hosts waiting for a handle, the number of active handles grows by
+ * a constant step (additive increase). When CPU or bandwidth overshoot it is
+ * cut by a factor (multiplicative decrease). It also holds when the average
+ * rate of the busy handles falls below a floor, more handles wouldn't help if
+ * the link is already saturated.
+ */
+class Concurrency_controller {
+public:
+    /// Measurements for one control interval
+    struct Sample {
+        Sample() :
+            kBs(0),
+            cpu(0),
+            handle_kBs(0),
+            busy(0),
+            waiting(0)
+        {}
+        /// aggregate download rate
+        double kBs;
+        /// process CPU usage in percent of one core
+        double cpu;
+        /// average download rate of the busy handles
+        double handle_kBs;
+        /// handles with a transfer in progress
+        size_t busy;
+        /// urls not yet assigned to any handle
+        size_t waiting;
+    };
+
+    Concurrency_controller(size_t active, size_t min_active, size_t max_active);
+
+    /**
+     * @brief run one step of the control loop
+     * @return number of handles that should be active
+     */
+    size_t update(const Sample& s);
+
+    size_t active() const { return m_active; }
+    /// Set the number of active handles, clamped to [min, max]
+    void active(size_t n);
+
+    bool enabled() const { return m_enabled; }
+    void enabled(bool e) { m_enabled = e; }
+
+    double target_kBs() const { return m_target_kBs; }
+    /// Bandwidth setpoint in kB/s, 0 means no bandwidth target
+    void target_kBs(double t) { m_target_kBs = t; }
+
+    double max_cpu() const { return m_max_cpu; }
+    /// CPU ceiling in percent, 0 disables the CPU check
+    void max_cpu(double c) { m_max_cpu = c; }
+
+    size_t min_active() const { return m_min_active; }
+    size_t max_active() const { return m_max_active; }
+    void range(size_t min_active, size_t max_active);
+
+    /// Additive increase per interval
+    size_t step;
+    /// Multiplicative decrease factor, in (0,1)
+    double decrease;
+    /// Below this average handle rate (kB/s) we consider the link saturated
+    double min_handle_kBs;
+
+private:
+    bool m_enabled;
+    size_t m_active;
+    size_t m_min_active;
+    size_t m_max_active;
+    double m_target_kBs;
+    double m_max_cpu;
+
+    friend std::ostream& operator<<(std::ostream& os, const Concurrency_controller& c);
+};
+
+/** @} */
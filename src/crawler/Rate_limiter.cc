@@ -0,0 +1,146 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+#include "Rate_limiter.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+/// Seconds worth of tokens that a bucket can accumulate
+static const double BURST_SECONDS = 0.5;
+
+/// Minimum burst, at least one full curl write (CURL_MAX_WRITE_SIZE)
+static const double BURST_MIN = 16384;
+
+Token_bucket::Token_bucket(double rate, const utils::timer& now) :
+    m_rate(0),
+    m_burst(0),
+    m_tokens(0),
+    m_last(now)
+{
+    this->rate(rate);
+}
+
+void Token_bucket::rate(double bytes_s)
+{
+    bool was_unlimited = m_rate <= 0;
+    m_rate = std::max(bytes_s, 0.0);
+    m_burst = std::max(m_rate * BURST_SECONDS, BURST_MIN);
+    if (was_unlimited)
+        m_tokens = m_burst;
+    else
+        m_tokens = std::min(m_tokens, m_burst);
+}
+
+void Token_bucket::refill(const utils::timer& now)
+{
+    utils::timer delta = now - m_last;
+    m_last = now;
+    if (m_rate <= 0)
+        return;
+    m_tokens = std::min(m_tokens + m_rate * delta.usec() / 1e6, m_burst);
+}
+
+
+Rate_limiter::Rate_limiter(clock_fn clock) :
+    m_clock(clock),
+    m_global(0, clock()),
+    m_groups(),
+    m_hosts()
+{
+}
+
+Rate_limiter::Chain Rate_limiter::chain(const std::string& host) const
+{
+    Chain c;
+    if (! m_hosts.empty()) {
+        buckets_t::const_iterator i = m_hosts.find(host);
+        if (i != m_hosts.end())
+            c.host = i->second;
+    }
+
+    // longest suffix first
+    for (size_t pos = 0; ! m_groups.empty() && pos != string::npos; ) {
+        buckets_t::const_iterator i = m_groups.find(host.substr(pos));
+        if (i != m_groups.end()) {
+            c.group = i->second;
+            break;
+        }
+        pos = host.find('.', pos);
+        if (pos != string::npos)
+            ++pos;
+    }
+    return c;
+}
+
+long long Rate_limiter::max_recv_speed(const Chain& c) const
+{
+    double r = 0;
+    if (c.group && c.group->rate() > 0)
+        r = c.group->rate();
+    if (c.host && c.host->rate() > 0 && (r == 0 || c.host->rate() < r))
+        r = c.host->rate();
+    return static_cast<long long>(r);
+}
+
+void Rate_limiter::refill()
+{
+    utils::timer now = m_clock();
+    m_global.refill(now);
+    for (buckets_t::iterator i = m_groups.begin(); i != m_groups.end(); ++i)
+        i->second->refill(now);
+    for (buckets_t::iterator i = m_hosts.begin(); i != m_hosts.end(); ++i)
+        i->second->refill(now);
+}
+
+bool Rate_limiter::limited() const
+{
+    return m_global.rate() > 0 || ! m_groups.empty() || ! m_hosts.empty();
+}
+
+void Rate_limiter::global(double kBs)
+{
+    m_global.rate(kBs * 1024);
+}
+
+void Rate_limiter::group(const std::string& suffix, double kBs)
+{
+    set(m_groups, suffix, kBs);
+}
+
+void Rate_limiter::host(const std::string& host, double kBs)
+{
+    set(m_hosts, host, kBs);
+}
+
+void Rate_limiter::set(buckets_t& b, const std::string& key, double kBs)
+{
+    buckets_t::iterator i = b.find(key);
+    if (kBs <= 0) {
+        if (i != b.end()) {
+            // transfers in progress might still hold the bucket
+            i->second->rate(0);
+            b.erase(i);
+        }
+    } else if (i != b.end()) {
+        i->second->rate(kBs * 1024);
+    } else {
+        b.insert(make_pair(key, bucket_ptr(new Token_bucket(kBs * 1024, m_clock()))));
+    }
+}
+
+ostream& operator<<(ostream& os, const Rate_limiter& r)
+{
+    os << "global: " << r.m_global.rate() / 1024 << " KB/s" << endl;
+    for (Rate_limiter::buckets_t::const_iterator i = r.m_groups.begin(); i != r.m_groups.end(); ++i)
+        os << "group " << i->first << ": " << i->second->rate() / 1024 << " KB/s" << endl;
+    for (Rate_limiter::buckets_t::const_iterator i = r.m_hosts.begin(); i != r.m_hosts.end(); ++i)
+        os << "host " << i->first << ": " << i->second->rate() / 1024 << " KB/s" << endl;
+    return os;
+}
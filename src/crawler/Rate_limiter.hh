@@ -0,0 +1,131 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup crawler
+ * @{
+ */
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <string>
+#include <boost/shared_ptr.hpp>
+
+#include "timer.hh"
+
+/**
+ * @brief Token bucket, rate in bytes/s
+ *
+ * Tokens are allowed to go negative, a transfer that is admitted can write a whole chunk
+ * and the debt is paid on the next refills. A bucket with rate 0 is unlimited.
+ */
+class Token_bucket {
+public:
+    /// @param now time from which tokens accumulate
+    Token_bucket(double rate = 0, const utils::timer& now = utils::timer::current());
+
+    double rate() const { return m_rate; }
+    void rate(double bytes_s);
+
+    /// add the tokens accumulated since the last refill, up to the burst size
+    void refill(const utils::timer& now);
+
+    /// @return true if there are tokens left
+    bool available() const { return m_rate <= 0 || m_tokens > 0; }
+
+    void consume(size_t n)
+    {
+        if (m_rate > 0)
+            m_tokens -= n;
+    }
+
+private:
+    double m_rate;
+    double m_burst;
+    double m_tokens;
+    utils::timer m_last;
+};
+
+
+/**
+ * @brief Hierarchical bandwidth shaping: global -> host group -> host
+ *
+ * Host groups are domain suffixes, a host belongs to the group of the longest suffix that
+ * matches on a label boundary, ie. the group "partner.com" covers "www.partner.com" and
+ * "partner.com". A byte received from a host is charged to its host bucket, to its group
+ * bucket and to the global bucket, a transfer is admitted only if all of them have tokens.
+ */
+class Rate_limiter {
+public:
+    typedef boost::shared_ptr<Token_bucket> bucket_ptr;
+    /// source of the current time
+    typedef utils::timer (*clock_fn)();
+
+    /// buckets that apply to one host, resolved once per transfer
+    struct Chain {
+        Chain() : group(), host() {}
+        bucket_ptr group;
+        bucket_ptr host;
+    };
+
+    /// @param clock tells the time for the refills, the tests give a fake one
+    Rate_limiter(clock_fn clock = &utils::timer::current);
+
+    /// @return the buckets that apply to host
+    Chain chain(const std::string& host) const;
+
+    /// @return true if a transfer with this chain can receive data now
+    bool admit(const Chain& c) const
+    {
+        return m_global.available()
+            && (! c.group || c.group->available())
+            && (! c.host || c.host->available());
+    }
+
+    /// charge n received bytes
+    void consume(const Chain& c, size_t n)
+    {
+        m_global.consume(n);
+        if (c.group)
+            c.group->consume(n);
+        if (c.host)
+            c.host->consume(n);
+    }
+
+    /**
+     * @return the static cap in bytes/s for a single transfer with this chain, for
+     * CURLOPT_MAX_RECV_SPEED_LARGE, 0 if unlimited. The global limit is shared among all
+     * transfers and is enforced by pausing instead.
+     */
+    long long max_recv_speed(const Chain& c) const;
+
+    void refill();
+
+    /// @return true if any limit is set
+    bool limited() const;
+
+    /// Limits in KB/s, 0 removes the limit
+    void global(double kBs);
+    void group(const std::string& suffix, double kBs);
+    void host(const std::string& host, double kBs);
+
+private:
+    typedef std::map<std::string, bucket_ptr> buckets_t;
+    void set(buckets_t& b, const std::string& key, double kBs);
+
+    clock_fn m_clock;
+    Token_bucket m_global;
+    buckets_t m_groups;
+    buckets_t m_hosts;
+
+    friend std::ostream& operator<<(std::ostream& os, const Rate_limiter& r);
+};
+
+/** @} */
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+#include "Resolver.hh"
+#include "Url.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <boost/scoped_ptr.hpp>
+
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
+#include <netinet/in.h>
+#include <event.h>
+
+using namespace std;
+
+/// Bounds of the time that answers are cached, in seconds
+static const int MIN_TTL = 60;
+static const int MAX_TTL = 86400;
+
+/// Seconds that a failure is cached
+static const int NEGATIVE_TTL = 300;
+
+/// A records kept for a host
+static const int MAX_ADDRESSES = 8;
+
+struct Resolver::Query {
+    Query(Resolver* r, const std::string& h) : resolver(r), host(h) {}
+    Resolver* resolver;
+    std::string host;
+};
+
+Resolver::Resolver(callback_t cb) :
+    m_channel(),
+    m_events(),
+    m_cache(),
+    m_callback(cb),
+    m_stats(),
+    m_pending(0)
+{
+    int res = ares_library_init(ARES_LIB_INIT_ALL);
+    if (res != ARES_SUCCESS)
+        throw runtime_error(string("ares_library_init: ") + ares_strerror(res));
+
+    struct ares_options options;
+    memset(&options, 0, sizeof(options));
+    options.sock_state_cb = sock_state_cb;
+    options.sock_state_cb_data = this;
+    if ((res = ares_init_options(&m_channel, &options, ARES_OPT_SOCK_STATE_CB)) != ARES_SUCCESS) {
+        ares_library_cleanup();
+        throw runtime_error(string("ares_init_options: ") + ares_strerror(res));
+    }
+}
+
+Resolver::~Resolver()
+{
+    // queries in flight are called back with ARES_EDESTRUCTION and sockets closed
+    ares_destroy(m_channel);
+    for (map<ares_socket_t, struct event*>::iterator i = m_events.begin(); i != m_events.end(); ++i) {
+        event_del(i->second);
+        delete i->second;
+    }
+    ares_library_cleanup();
+}
+
+void Resolver::resolve(const std::string& host)
+{
+    if (host.empty())
+        return;
+
+    const time_t now = time(0);
+    unordered_map<string, Entry>::iterator i = m_cache.find(host);
+    if (i == m_cache.end()) {
+        i = m_cache.insert(make_pair(host, Entry())).first;
+    } else if (i->second.state == Entry::PENDING || i->second.expires > now) {
+        ++m_stats.hits;
+        return;
+    }
+
+    Entry& e = i->second;
+    if (host[0] == '[' || Url_util::is_ipv4(host.data(), host.size())) {
+        // nothing to resolve, ipv6 literals are left to curl
+        e.state = host[0] == '[' ? Entry::FAILED : Entry::RESOLVED;
+        e.addresses.assign(host[0] == '[' ? 0 : 1, host);
+        e.expires = numeric_limits<time_t>::max();
+        m_callback(host, e);
+        return;
+    }
+
+    // an expired entry keeps its addresses until the answer arrives, but lookup() ignores them
+    e.state = Entry::PENDING;
+    ++m_pending;
+    ++m_stats.queries;
+    ares_query(m_channel, host.c_str(), ns_c_in, ns_t_a, query_cb, new Query(this, host));
+}
+
+const Resolver::Entry* Resolver::lookup(const std::string& host) const
+{
+    unordered_map<string, Entry>::const_iterator i = m_cache.find(host);
+    if (i == m_cache.end() || i->second.state != Entry::RESOLVED || i->second.expires <= time(0))
+        return 0;
+    return &i->second;
+}
+
+void Resolver::tick()
+{
+    ares_process_fd(m_channel, ARES_SOCKET_BAD, ARES_SOCKET_BAD);
+}
+
+void Resolver::answer(const std::string& host, int status, unsigned char* abuf, int alen)
+{
+    --m_pending;
+    // references to the elements survive rehashing if the callback resolves more hosts
+    Entry& e = m_cache[host];
+    e.addresses.clear();
+
+    struct ares_addrttl ttls[MAX_ADDRESSES];
+    int n = MAX_ADDRESSES;
+    struct hostent* he = 0;
+    if (status == ARES_SUCCESS && ares_parse_a_reply(abuf, alen, &he, ttls, &n) == ARES_SUCCESS && n > 0) {
+        int ttl = MAX_TTL;
+        for (int i = 0; i < n; ++i) {
+            char buf[INET_ADDRSTRLEN];
+            if (inet_ntop(AF_INET, &ttls[i].ipaddr, buf, sizeof(buf)))
+                e.addresses.push_back(buf);
+            ttl = min(ttl, ttls[i].ttl);
+        }
+        e.state = Entry::RESOLVED;
+        e.expires = time(0) + max(ttl, MIN_TTL);
+    } else {
+        ++m_stats.failures;
+        e.state = Entry::FAILED;
+        e.expires = time(0) + NEGATIVE_TTL;
+    }
+    if (he)
+        ares_free_hostent(he);
+
+    m_callback(host, e);
+}
+
+void Resolver::query_cb(void* arg, int status, int timeouts, unsigned char* abuf, int alen)
+{
+    (void) timeouts;
+    boost::scoped_ptr<Query> q(static_cast<Query*>(arg));
+    if (status == ARES_EDESTRUCTION)
+        return;
+    q->resolver->answer(q->host, status, abuf, alen);
+}
+
+void Resolver::sock_state_cb(void* data, ares_socket_t s, int readable, int writable)
+{
+    Resolver* r = static_cast<Resolver*>(data);
+    map<ares_socket_t, struct event*>::iterator i = r->m_events.find(s);
+    if (! readable && ! writable) {
+        if (i != r->m_events.end()) {
+            event_del(i->second);
+            delete i->second;
+            r->m_events.erase(i);
+        }
+        return;
+    }
+
+    struct event* ev;
+    if (i != r->m_events.end()) {
+        ev = i->second;
+        event_del(ev);
+    } else {
+        ev = new event;
+        r->m_events[s] = ev;
+    }
+    event_set(ev, s, (readable ? EV_READ : 0) | (writable ? EV_WRITE : 0) | EV_PERSIST, event_cb, r);
+    event_add(ev, 0);
+}
+
+void Resolver::event_cb(int fd, short what, void* arg)
+{
+    Resolver* r = static_cast<Resolver*>(arg);
+    ares_process_fd(r->m_channel, (what & EV_READ) ? fd : ARES_SOCKET_BAD, (what & EV_WRITE) ? fd : ARES_SOCKET_BAD);
+}
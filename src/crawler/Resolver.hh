@@ -0,0 +1,101 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup crawler
+ * @{
+ */
+#pragma once
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <ares.h>
+
+struct event;
+
+/**
+ * @brief Asynchronous DNS resolution with c-ares on the libevent loop, with a cache
+ *
+ * Hosts are resolved as they are enqueued, well before a handle picks them, so that the address
+ * is there to group them by server and to hand to curl with CURLOPT_RESOLVE. Answers are cached
+ * for their TTL, within bounds, failures for a while too. Only A records are looked up, hosts
+ * without one are left for curl to resolve.
+ */
+class Resolver : boost::noncopyable {
+public:
+    struct Entry {
+        typedef enum state_t {
+            PENDING,
+            RESOLVED,
+            FAILED
+        } state_t;
+
+        Entry() : state(PENDING), addresses(), expires(0) {}
+
+        state_t state;
+        /// ipv4 addresses in dotted notation
+        std::vector<std::string> addresses;
+        /// seconds since the epoch
+        time_t expires;
+    };
+
+    struct Stats {
+        Stats() : queries(0), hits(0), failures(0) {}
+        /// queries sent
+        size_t queries;
+        /// resolve() calls answered from the cache
+        size_t hits;
+        size_t failures;
+    };
+
+    /// called when a query finishes, successfully or not
+    typedef boost::function<void (const std::string& host, const Entry&)> callback_t;
+
+    /// event_init must have been called
+    explicit Resolver(callback_t cb);
+    ~Resolver();
+
+    /// starts resolving host unless it's cached or being resolved
+    void resolve(const std::string& host);
+
+    /// @return the addresses of host, 0 if it's not resolved or it expired
+    const Entry* lookup(const std::string& host) const;
+
+    /// handles query timeouts, to be called periodically
+    void tick();
+
+    const Stats& stats() const { return m_stats; }
+
+    /// @return number of queries in flight
+    size_t pending() const { return m_pending; }
+
+private:
+    struct Query;
+
+    static void sock_state_cb(void* data, ares_socket_t s, int readable, int writable);
+    static void event_cb(int fd, short what, void* arg);
+    static void query_cb(void* arg, int status, int timeouts, unsigned char* abuf, int alen);
+
+    void answer(const std::string& host, int status, unsigned char* abuf, int alen);
+
+    ares_channel m_channel;
+    /// libevent events of the sockets c-ares uses
+    std::map<ares_socket_t, struct event*> m_events;
+    std::unordered_map<std::string, Entry> m_cache;
+    callback_t m_callback;
+    Stats m_stats;
+    size_t m_pending;
+};
+
+/** @} */
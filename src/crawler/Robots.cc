@@ -8,63 +8,176 @@
 
 #include "Robots.hh"
 #include "Url.hh"
+#include <cctype>
+#include <cstring>
+#include <iterator>
+#include <strings.h>
+#include <boost/algorithm/string.hpp>
 using namespace std;
 
 namespace robots {
 
-boost::regex Robots::sgml_tag("<[^>]+>",boost::regex_constants::perl);
-
 Robots::Robots() :
-    yyFlexLexer(0,0),
     valid(false),
+    sitemaps(),
     errors(),
     state(START),
     current(),
-    uas_rules_all()
+    uas_rules_all(),
+    matcher()
     //crawl_delay(0)
 {
 }
 
-Robots::Robots(std::istream* in) :
-    yyFlexLexer(in,0),
-    valid(false),
-    state(START),
-    current(),
-    uas_rules_all()
-    //crawl_delay(0)
-{
+namespace {
+    /// @return true if [b, e) is the directive k, case insensitive
+    inline bool directive(const char* b, const char* e, const char* k)
+    {
+        const size_t len = strlen(k);
+        return static_cast<size_t>(e - b) == len && strncasecmp(b, k, len) == 0;
+    }
+
+    inline bool space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    /// Sometimes we get html, this checks for html tags to avoid further parsing and wasting time
+    bool looks_like_html(const char* b, const char* e)
+    {
+        const char* lt = static_cast<const char*>(memchr(b, '<', e - b));
+        return lt && lt + 2 < e && lt[1] != '>' && memchr(lt + 2, '>', e - lt - 2);
+    }
 }
 
-void Robots::reset(std::istream* in)
+int Robots::parse(const char* data, size_t len)
 {
-    switch_streams(in,0);
-    clear();
-//    BEGIN(0);
-//    BEGIN(INITIAL);
+    const char* end = data + len;
+    if (len >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0)
+        // UTF-8 BOM
+        data += 3;
+
+    while (data < end) {
+        const char* nl = static_cast<const char*>(memchr(data, '\n', end - data));
+        const char* e = nl ? nl : end;
+        if (! line(data, e))
+            return -1;
+        data = nl ? nl + 1 : end;
+    }
+    eof();
+    start();
+    return 0;
 }
 
+bool Robots::line(const char* b, const char* e)
+{
+    const char* const line_b = b;
+    const char* const line_e = e;
+
+    const char* comment = static_cast<const char*>(memchr(b, '#', e - b));
+    if (comment)
+        e = comment;
+    while (b < e && space(*b))
+        ++b;
+    while (e > b && space(e[-1]))
+        --e;
+    if (b == e)
+        return true;
+
+    const char* colon = static_cast<const char*>(memchr(b, ':', e - b));
+    if (colon) {
+        const char* key_e = colon;
+        while (key_e > b && space(key_e[-1]))
+            --key_e;
+        const char* v = colon + 1;
+        while (v < e && space(*v))
+            ++v;
+
+        if (directive(b, key_e, "user-agent")) {
+            if (v != e) {
+                /*******/
+                reading_uas();
+                /*******/
+                current.ua.push_back(string(v, e));
+                return true;
+            }
+        } else if (directive(b, key_e, "allow")) {
+            /*******/
+            rules();
+            /*******/
+            current.rules.push_back(Rule(ALLOW, string(v, e)));
+            return true;
+        } else if (directive(b, key_e, "disallow")) {
+            /*******/
+            rules();
+            /*******/
+            current.rules.push_back(Rule(DISALLOW, string(v, e)));
+            return true;
+        } else if (directive(b, key_e, "crawl-delay")) {
+            /*******/
+            rules();
+            /*******/
+            current.rules.push_back(Rule(CRAWL_DELAY, string(v, e)));
+            return true;
+        } else if (directive(b, key_e, "sitemap")) {
+            // not part of any user agent group, doesn't change the state
+            if (v != e)
+                sitemaps.push_back(string(v, e));
+            return true;
+        }
+    }
+
+    errors.append("unmatched: |").append(line_b, line_e).append("|\n");
+    return ! (state == START && looks_like_html(line_b, line_e));
+}
 
 bool Robots::path_allowed(const std::string& user_agent, const std::string& p) const
 {
-    string path = Url::unescape_not(Url::escape(p,Url_util::URL_CHAR_PATH),Url_util::URL_CHAR_PATH);
-    for(vector<Uas_rules>::const_iterator i = uas_rules_all.begin(); i != uas_rules_all.end(); ++i) {
-        for(vector<string>::const_iterator u = i->ua.begin(); u != i->ua.end(); ++u) {
-            if( u->compare(0,u->size(),user_agent) == 0 || *u == "*" ) {
-                //cout << "ua: " << *u << endl;
-                for(vector<Rule>::const_iterator r = i->rules.begin(); r != i->rules.end(); ++r) {
-                    //cout << static_cast<int>(r->type) << " " << r->str << endl;
-                    if(r->str.compare(0,r->str.size(),path) == 0) {
-                        if(r->type == ALLOW)
-                            return true;
-                        else
-                            return false;
-                    }
+    Matcher m;
+    select(user_agent, m);
+    string::size_type q = std::min(p.find('?'), p.size());
+    return m.allowed(p.data(), q, p.data() + q, p.size() - q);
+}
+
+void Robots::compile(const std::string& user_agent)
+{
+    matcher.clear();
+    select(user_agent, matcher);
+}
+
+void Robots::select(const std::string& user_agent, Matcher& m) const
+{
+    const string agent = boost::to_lower_copy(user_agent);
+
+    // length of the most specific User-agent that matches, 0 if only "*" does
+    size_t best = 0;
+    vector<bool> matches(uas_rules_all.size(), false);
+    vector<bool> any(uas_rules_all.size(), false);
+    for (size_t i = 0; i < uas_rules_all.size(); ++i) {
+        for (vector<string>::const_iterator u = uas_rules_all[i].ua.begin(); u != uas_rules_all[i].ua.end(); ++u) {
+            const string ua = boost::to_lower_copy(boost::trim_copy(*u));
+            if (ua == "*") {
+                any[i] = true;
+            } else if (! ua.empty()
+                && agent.compare(0, ua.size(), ua) == 0
+                && (agent.size() == ua.size() || ! isalnum(static_cast<unsigned char>(agent[ua.size()])))) {
+                if (ua.size() > best) {
+                    best = ua.size();
+                    matches.assign(matches.size(), false);
                 }
-                return true;
+                if (ua.size() == best)
+                    matches[i] = true;
             }
         }
     }
-    return true;
+
+    for (size_t i = 0; i < uas_rules_all.size(); ++i) {
+        if (! (best ? matches[i] : any[i]))
+            continue;
+        for (vector<Rule>::const_iterator r = uas_rules_all[i].rules.begin(); r != uas_rules_all[i].rules.end(); ++r)
+            if (r->type == ALLOW || r->type == DISALLOW)
+                m.add(r->str, r->type == ALLOW);
+    }
 }
 
 void Robots::rules()
@@ -102,6 +215,8 @@ ostream& operator<<(ostream& os, const Robots& robots)
             os << static_cast<int>(r->type) << " " << r->str << endl;
         }
     }
+    for (vector<string>::const_iterator s = robots.sitemaps.begin(); s != robots.sitemaps.end(); ++s)
+        os << "sitemap: " << *s << endl;
     return os;
 }
 
@@ -112,8 +227,9 @@ ostream& operator<<(ostream& os, const Robots& robots)
 int main(int argc, char* argv[])
 {
     using namespace robots;
-    Robots robots(&cin);
-    robots.yylex();
+    Robots robots;
+    string content((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
+    robots.parse(content);
     cout << robots << endl;
     cout << "*****************" << endl;
     if(argc<3)
@@ -22,11 +22,8 @@
 #include <iostream>
 #include <set>
 #include <map>
-#include <boost/regex.hpp>
 #include "Path.hh"
-
-#undef yyFlexLexer
-#include <FlexLexer.h>
+#include "Robots_matcher.hh"
 
 namespace robots {
     typedef enum robots_state_t {
@@ -40,26 +37,26 @@ namespace robots {
      * @brief Tests if path is allowed by robots.txt
      *
      * Parses a robots.txt file and sets up internal machinery for easy testing if an url is allowed.
-     * To evaluate if access to a URL is allowed.  A robot must attempt to match
-     * the paths in Allow and Disallow lines against the URL, in the order they
-     * occur in the record. The first match found is used.  If no match is found,
-     * the default assumption is that the URL is allowed.
+     * The rules of the group that matches our user agent are compiled once into a Matcher,
+     * @sa compile, the most specific (longest) matching rule decides, on a tie Allow wins. If
+     * no rule matches the url is allowed. Rules can have wildcards, '*' matches any sequence
+     * of chars and a trailing '$' matches the end of the url.
      *
      * @todo Crawl-delay: seems to be specified by some sites
      */
 
-    class Robots : public yyFlexLexer {
+    class Robots {
     public:
         Robots();
 
-        /// Construct directly from an istream containing robots.txt information
-        Robots(std::istream* in);
-
         /**
          * @brief parse supplied robots.txt content
+         *
+         * The content is scanned in place line by line, directives are case insensitive.
          * @return 0 if there was success parsing the file or -1 if the syntax is invalid, nonfatal errors would be stored on errors but the parser will keep going and might return 0
          */
-        virtual int yylex();
+        int parse(const char* data, size_t len);
+        int parse(const std::string& s) { return parse(s.data(), s.size()); }
 
         /**
          * @return true if a path is allowed for the supplied user_agent
@@ -94,19 +91,36 @@ namespace robots {
          */
         bool path_allowed(const std::string& user_agent, const std::string& path) const;
 
+        /**
+         * @brief compile the rules for user_agent, must be called after parsing to use allowed
+         *
+         * The group whose User-agent is the longest case insensitive prefix of user_agent
+         * (ending in a word boundary) is selected, groups with the same User-agent are merged.
+         * If there's none the "*" groups are used.
+         */
+        void compile(const std::string& user_agent);
+
+        /// @return true if path, with query starting with '?' if any, is allowed by the compiled rules
+        bool allowed(const std::string& path, const std::string& query = std::string()) const
+        {
+            return matcher.allowed(path, query);
+        }
+
         bool valid;
         void clear() {
             current.clear();
             uas_rules_all.clear();
+            sitemaps.clear();
+            matcher.clear();
             state = START;
         }
+
+        /// urls from "Sitemap:" lines, they don't belong to any user agent group
+        std::vector<std::string> sitemaps;
         /// parsing errors
         std::string    errors;
 
     protected:
-        // currently unused
-        void reset(std::istream* in);
-
         /// Types of Rules
         typedef enum rule_type_t {
             DISALLOW,
@@ -140,6 +154,12 @@ namespace robots {
         //void unmatch() {state=UNMATCH;}
         void eof();
 
+        /**
+         * @brief handle one line, without the newline
+         * @return false if the content doesn't look like a robots.txt
+         */
+        bool line(const char* b, const char* e);
+
         /**
          * Agregation of several "User-agent:" lines and it's corresponding rules
          */
@@ -155,14 +175,15 @@ namespace robots {
         };
 
 
+        /// add the rules for user_agent to m
+        void select(const std::string& user_agent, Matcher& m) const;
+
         state_t state;
         Uas_rules current;
         std::vector<Uas_rules> uas_rules_all;
+        Matcher matcher;
 
 
-        /// Sometimes we get html, this checks for html tags to avoid further parsing and wasting time
-        static boost::regex sgml_tag;
-
         /// Dumps parsed info, mainly for debug
         friend std::ostream& operator<<(std::ostream& os, const Robots& r);
     };
@@ -171,19 +192,16 @@ namespace robots {
      * @brief Extends Robots so we have state
      */
     struct Robots_entry : public Robots {
-        Robots_entry(std::istream* in) :
-            Robots(in),
-            state(EMPTY)
-        {}
-
         Robots_entry() :
             Robots(),
-            state(EMPTY)
+            state(EMPTY),
+            host()
         {}
 
         Robots_entry(robots_state_t state) :
             Robots(),
-            state(state)
+            state(state),
+            host()
         {}
 
         bool tried_but_failed() const
@@ -192,6 +210,9 @@ namespace robots {
         }
 
         robots_state_t state;
+
+        /// host the robots.txt applies to
+        std::string host;
     };
 };
 #endif
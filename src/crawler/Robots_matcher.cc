@@ -0,0 +1,228 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+#include "Robots_matcher.hh"
+#include "Url.hh"
+
+#include <algorithm>
+
+using namespace std;
+using namespace Url_util;
+
+namespace robots {
+
+/// Normalized urls up to this size are checked without allocating
+static const size_t MAX_STACK_URL = 4096;
+
+namespace {
+    const char HEX[] = "0123456789ABCDEF";
+
+    int hexval(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    inline void put(char* out, size_t cap, size_t& n, char c)
+    {
+        if (n < cap)
+            out[n] = c;
+        ++n;
+    }
+
+    void normalize_part(const char* s, size_t len, unsigned char mask, char* out, size_t cap, size_t& n)
+    {
+        for (size_t i = 0; i < len; ++i) {
+            const unsigned char c = s[i];
+            int h, l;
+            if (c == '%' && i + 2 < len && (h = hexval(s[i + 1])) >= 0 && (l = hexval(s[i + 2])) >= 0) {
+                const unsigned char d = h * 16 + l;
+                // '*' stays escaped, otherwise it would become a wildcard in a rule
+                if (d && url_char_table[d] == 0 && d != '*') {
+                    put(out, cap, n, d);
+                } else {
+                    put(out, cap, n, '%');
+                    put(out, cap, n, HEX[h]);
+                    put(out, cap, n, HEX[l]);
+                }
+                i += 2;
+            } else if (url_char_test(c, mask)) {
+                put(out, cap, n, '%');
+                put(out, cap, n, HEX[c >> 4]);
+                put(out, cap, n, HEX[c & 0xF]);
+            } else {
+                put(out, cap, n, c);
+            }
+        }
+    }
+}
+
+bool wildcard_match(const char* p, size_t plen, const char* s, size_t slen, bool anchored)
+{
+    const char* pe = p + plen;
+    const char* se = s + slen;
+    const char* star_p = 0;
+    const char* star_s = 0;
+    while (true) {
+        if (p == pe) {
+            if (! anchored || s == se)
+                return true;
+        } else if (*p == '*') {
+            star_p = ++p;
+            star_s = s;
+            continue;
+        } else if (s != se && *p == *s) {
+            ++p;
+            ++s;
+            continue;
+        }
+        // mismatch, let the last '*' eat one more char
+        if (! star_p || star_s == se)
+            return false;
+        p = star_p;
+        s = ++star_s;
+    }
+}
+
+Matcher::Matcher() :
+    m_nodes(1, Node(0)),
+    m_patterns(),
+    m_rules(0)
+{
+}
+
+void Matcher::clear()
+{
+    m_nodes.assign(1, Node(0));
+    m_patterns.clear();
+    m_rules = 0;
+}
+
+size_t Matcher::normalize(const char* path, size_t path_len, const char* query, size_t query_len, char* out, size_t cap)
+{
+    size_t n = 0;
+    normalize_part(path, path_len, URL_CHAR_PATH, out, cap, n);
+    if (query_len) {
+        put(out, cap, n, '?');
+        if (*query == '?') {
+            ++query;
+            --query_len;
+        }
+        normalize_part(query, query_len, URL_CHAR_QUERY, out, cap, n);
+    }
+    return n;
+}
+
+void Matcher::add(const std::string& rule, bool allow)
+{
+    string r(rule);
+    bool anchored = false;
+    if (! r.empty() && r[r.size() - 1] == '$') {
+        anchored = true;
+        r.erase(r.size() - 1);
+    }
+
+    string::size_type q = std::min(r.find('?'), r.size());
+    string norm(normalize(r.data(), q, r.data() + q, r.size() - q, 0, 0), 0);
+    if (! norm.empty())
+        normalize(r.data(), q, r.data() + q, r.size() - q, &norm[0], norm.size());
+    norm.erase(unique(norm.begin(), norm.end(), [](char a, char b) { return a == '*' && b == '*'; }), norm.end());
+    if (norm.empty())
+        return;
+
+    ++m_rules;
+    if (anchored || norm.find('*') != string::npos) {
+        Pattern p;
+        p.str = norm;
+        p.anchored = anchored;
+        p.allow = allow;
+        m_patterns.insert(upper_bound(m_patterns.begin(), m_patterns.end(), p), p);
+        return;
+    }
+
+    unsigned n = 0;
+    for (string::const_iterator c = norm.begin(); c != norm.end(); ++c) {
+        unsigned prev = 0;
+        unsigned ch = m_nodes[n].child;
+        while (ch && m_nodes[ch].c != *c) {
+            prev = ch;
+            ch = m_nodes[ch].next;
+        }
+        if (! ch) {
+            ch = m_nodes.size();
+            m_nodes.push_back(Node(*c));
+            if (prev)
+                m_nodes[prev].next = ch;
+            else
+                m_nodes[n].child = ch;
+        }
+        n = ch;
+    }
+    m_nodes[n].rule |= allow ? ALLOW : DISALLOW;
+}
+
+bool Matcher::allowed(const char* path, size_t path_len, const char* query, size_t query_len) const
+{
+    if (! m_rules)
+        return true;
+
+    if (! path_len) {
+        path = "/";
+        path_len = 1;
+    }
+
+    char buf[MAX_STACK_URL];
+    size_t n = normalize(path, path_len, query, query_len, buf, sizeof(buf));
+    if (n <= sizeof(buf))
+        return match(buf, n);
+
+    vector<char> big(n);
+    normalize(path, path_len, query, query_len, &big[0], n);
+    return match(&big[0], n);
+}
+
+bool Matcher::match(const char* s, size_t len) const
+{
+    size_t best = 0;
+    unsigned verdict = 0;
+
+    unsigned n = 0;
+    for (size_t i = 0; i < len; ++i) {
+        unsigned ch = m_nodes[n].child;
+        while (ch && m_nodes[ch].c != s[i])
+            ch = m_nodes[ch].next;
+        if (! ch)
+            break;
+        n = ch;
+        if (m_nodes[n].rule) {
+            best = i + 1;
+            verdict = (m_nodes[n].rule & ALLOW) ? ALLOW : DISALLOW;
+        }
+    }
+
+    for (vector<Pattern>::const_iterator p = m_patterns.begin(); p != m_patterns.end(); ++p) {
+        const size_t plen = p->length();
+        if (plen < best)
+            break;
+        if (plen == best && (verdict == ALLOW || ! p->allow))
+            // can't change the verdict
+            continue;
+        if (wildcard_match(p->str.data(), p->str.size(), s, len, p->anchored)) {
+            best = plen;
+            verdict = p->allow ? ALLOW : DISALLOW;
+        }
+    }
+    return verdict != DISALLOW;
+}
+
+}; // namespace robots
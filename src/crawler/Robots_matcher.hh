@@ -0,0 +1,101 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup crawler
+ * @{
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace robots {
+
+    /**
+     * @brief Allow / Disallow rules of one user agent compiled for fast matching
+     *
+     * Literal rules are stored in a trie, rules with wildcards ('*' matches any sequence, a
+     * trailing '$' anchors the end of the url) are kept apart sorted by length. The most
+     * specific rule, the longest one that matches, decides. On a tie Allow wins. If no rule
+     * matches the url is allowed.
+     *
+     * Rules and urls are normalized the same way before comparing: chars that are not valid
+     * in a path are escaped, escapes of unreserved chars are decoded and the hex digits of the
+     * rest are uppercased, so "/%7ejoe" matches "/~joe" but "/a%2fb" doesn't match "/a/b".
+     *
+     * Checking an url doesn't allocate, it's normalized into a buffer on the stack.
+     */
+    class Matcher {
+    public:
+        Matcher();
+
+        void clear();
+
+        /// add a rule, empty rules are ignored as they don't match anything
+        void add(const std::string& rule, bool allow);
+
+        /// @return true if path (with the query, starting with '?', if any) is allowed
+        bool allowed(const char* path, size_t path_len, const char* query = 0, size_t query_len = 0) const;
+
+        bool allowed(const std::string& path, const std::string& query = std::string()) const
+        {
+            return allowed(path.data(), path.size(), query.data(), query.size());
+        }
+
+        /// @return number of rules
+        size_t size() const { return m_rules; }
+
+        /**
+         * @brief normalize a path (or pattern) and its query into out
+         * @return length of the normalized string, if it's greater than cap out was truncated
+         */
+        static size_t normalize(const char* path, size_t path_len, const char* query, size_t query_len, char* out, size_t cap);
+
+    private:
+        bool match(const char* s, size_t len) const;
+
+        enum {
+            ALLOW = 1,
+            DISALLOW = 2
+        };
+
+        /// trie node, children are a linked list of siblings
+        struct Node {
+            Node(char c) : c(c), rule(0), child(0), next(0) {}
+            char c;
+            unsigned char rule;
+            unsigned child;
+            unsigned next;
+        };
+
+        struct Pattern {
+            Pattern() : str(), anchored(false), allow(false) {}
+            /// normalized pattern, without the trailing '$'
+            std::string str;
+            bool anchored;
+            bool allow;
+
+            /// precedence is given by the length of the original rule
+            size_t length() const { return str.size() + anchored; }
+            bool operator<(const Pattern& o) const { return length() > o.length(); }
+        };
+
+        /// node 0 is the root
+        std::vector<Node> m_nodes;
+        /// sorted by decreasing length
+        std::vector<Pattern> m_patterns;
+        size_t m_rules;
+    };
+
+    /// match s against a pattern where '*' matches any sequence, anchored to the end of s if anchored
+    bool wildcard_match(const char* p, size_t plen, const char* s, size_t slen, bool anchored);
+};
+
+/** @} */
@@ -0,0 +1,416 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+#include "Sitemap_parser.hh"
+
+#include <cstring>
+#include <ctime>
+#include <boost/algorithm/string/trim.hpp>
+
+using namespace std;
+
+namespace sitemap {
+
+/// Longest tag name that we keep, longer ones are truncated and won't match
+static const size_t MAX_TAG = 64;
+
+/// Longest <loc> or <lastmod>, the protocol allows urls of up to 2048 chars
+static const size_t MAX_TEXT = 4096;
+
+/// Size of the buffer for inflated data
+static const size_t INFLATE_BSIZE = 16384;
+
+Parser::Parser(const callback_t& cb, bool index) :
+    m_cb(cb),
+    m_index(index),
+    m_state(TEXT),
+    m_tag(),
+    m_tag_closing(false),
+    m_tag_name_done(false),
+    m_quote(0),
+    m_prev(0),
+    m_match(0),
+    m_entry(NONE),
+    m_element(NONE),
+    m_text(),
+    m_overflow(false),
+    m_loc(),
+    m_lastmod(0),
+    m_gzip(-1),
+    m_magic(),
+    m_zs(),
+    m_zs_init(false),
+    m_zs_end(false),
+    m_size(0),
+    m_entries(0),
+    m_error(false)
+{
+    m_tag.reserve(MAX_TAG);
+    m_text.reserve(MAX_TEXT);
+}
+
+Parser::~Parser()
+{
+    if (m_zs_init)
+        inflateEnd(&m_zs);
+}
+
+bool Parser::feed(const char* data, size_t len)
+{
+    if (m_error)
+        return false;
+
+    if (m_gzip < 0) {
+        // we need the first two bytes to tell if it's compressed
+        size_t take = min(len, 2 - m_magic.size());
+        m_magic.append(data, take);
+        data += take;
+        len -= take;
+        if (m_magic.size() < 2)
+            return true;
+
+        m_gzip = (m_magic[0] == '\x1f' && m_magic[1] == '\x8b') ? 1 : 0;
+        if (m_gzip) {
+            // 16 + MAX_WBITS: expect a gzip header
+            if (inflateInit2(&m_zs, 16 + MAX_WBITS) != Z_OK)
+                return ! (m_error = true);
+            m_zs_init = true;
+        }
+
+        string magic;
+        magic.swap(m_magic);
+        if (! (m_gzip ? inflate(magic.data(), magic.size()) : parse(magic.data(), magic.size())))
+            return false;
+    }
+
+    return m_gzip ? inflate(data, len) : parse(data, len);
+}
+
+bool Parser::inflate(const char* data, size_t len)
+{
+    char out[INFLATE_BSIZE];
+    m_zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    m_zs.avail_in = static_cast<uInt>(len);
+    do {
+        if (m_zs_end)
+            // trailing garbage after the gzip stream
+            return true;
+
+        m_zs.next_out = reinterpret_cast<Bytef*>(out);
+        m_zs.avail_out = sizeof(out);
+        int res = ::inflate(&m_zs, Z_NO_FLUSH);
+        if (res == Z_STREAM_END)
+            m_zs_end = true;
+        else if (res != Z_OK && res != Z_BUF_ERROR)
+            return ! (m_error = true);
+
+        size_t n = sizeof(out) - m_zs.avail_out;
+        if (n && ! parse(out, n))
+            return false;
+    } while (m_zs.avail_in > 0 || m_zs.avail_out == 0);
+    return true;
+}
+
+bool Parser::parse(const char* data, size_t len)
+{
+    m_size += len;
+    if (m_size > MAX_SIZE)
+        return ! (m_error = true);
+
+    for (const char* p = data; p != data + len; ++p) {
+        const char c = *p;
+        switch (m_state) {
+            case TEXT:
+                if (c == '<') {
+                    m_state = TAG;
+                    m_tag.clear();
+                    m_tag_closing = false;
+                    m_tag_name_done = false;
+                    m_quote = 0;
+                    m_prev = 0;
+                } else if (m_element != NONE) {
+                    if (m_text.size() < MAX_TEXT)
+                        m_text.push_back(c);
+                    else
+                        m_overflow = true;
+                }
+                break;
+
+            case TAG:
+                if (m_quote) {
+                    if (c == m_quote)
+                        m_quote = 0;
+                } else if (c == '>') {
+                    tag();
+                    m_state = TEXT;
+                } else if (m_tag_name_done) {
+                    if (c == '"' || c == '\'')
+                        m_quote = c;
+                } else if (c == '/' && m_tag.empty()) {
+                    m_tag_closing = true;
+                } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '/') {
+                    m_tag_name_done = true;
+                } else if (m_tag.size() < MAX_TAG) {
+                    m_tag.push_back(c);
+                    if (m_tag == "!--") {
+                        m_state = COMMENT;
+                        m_match = 0;
+                    } else if (m_tag == "![CDATA[") {
+                        m_state = CDATA;
+                        m_match = 0;
+                    }
+                }
+                m_prev = c;
+                break;
+
+            case COMMENT:
+                if (c == '>' && m_match >= 2)
+                    m_state = TEXT;
+                else if (c == '-')
+                    ++m_match;
+                else
+                    m_match = 0;
+                break;
+
+            case CDATA:
+                if (c == ']' && m_match < 2) {
+                    ++m_match;
+                } else if (c == '>' && m_match == 2) {
+                    m_state = TEXT;
+                } else {
+                    // what looked like the terminator is text
+                    string pending(m_match, ']');
+                    if (c == ']')
+                        // "]]]": keep the last two as candidates
+                        pending.resize(1);
+                    else
+                        pending.push_back(c);
+                    m_match = c == ']' ? 2 : 0;
+                    if (m_element != NONE) {
+                        if (m_text.size() + pending.size() <= MAX_TEXT)
+                            m_text.append(pending);
+                        else
+                            m_overflow = true;
+                    }
+                }
+                break;
+        }
+        if (m_error)
+            return false;
+    }
+    return true;
+}
+
+void Parser::tag()
+{
+    if (m_tag.empty() || m_tag[0] == '?' || m_tag[0] == '!')
+        // processing instructions and declarations
+        return;
+
+    // local name, without namespace prefix
+    string::size_type colon = m_tag.find(':');
+    const string name = colon == string::npos ? m_tag : m_tag.substr(colon + 1);
+
+    if (m_tag_closing) {
+        close(name);
+    } else {
+        open(name);
+        if (m_prev == '/')
+            // <empty/>
+            close(name);
+    }
+}
+
+void Parser::open(const std::string& name)
+{
+    if (name == "url" || (name == "sitemap" && m_index)) {
+        m_entry = name == "url" ? URL : SITEMAP;
+        m_loc.clear();
+        m_lastmod = 0;
+    } else if (m_entry != NONE && (name == "loc" || name == "lastmod")) {
+        m_element = name == "loc" ? LOC : LASTMOD;
+        m_text.clear();
+        m_overflow = false;
+    }
+}
+
+void Parser::close(const std::string& name)
+{
+    if (m_element == LOC && name == "loc") {
+        if (! m_overflow) {
+            boost::trim(m_text);
+            m_loc = decode_xml_entities(m_text);
+        }
+        m_element = NONE;
+
+    } else if (m_element == LASTMOD && name == "lastmod") {
+        boost::trim(m_text);
+        m_lastmod = parse_w3c_datetime(m_text);
+        m_element = NONE;
+
+    } else if ((m_entry == URL && name == "url") || (m_entry == SITEMAP && name == "sitemap")) {
+        if (! m_loc.empty()) {
+            if (m_entries == MAX_ENTRIES) {
+                m_error = true;
+                return;
+            }
+            ++m_entries;
+            m_cb(m_loc, m_lastmod, m_entry == SITEMAP);
+        }
+        m_entry = NONE;
+        m_element = NONE;
+    }
+}
+
+
+namespace {
+    bool digits(const char*& p, const char* end, size_t n, int& val)
+    {
+        val = 0;
+        for (size_t i = 0; i < n; ++i, ++p) {
+            if (p == end || *p < '0' || *p > '9')
+                return false;
+            val = val * 10 + (*p - '0');
+        }
+        return true;
+    }
+
+    bool expect(const char*& p, const char* end, char c)
+    {
+        if (p == end || *p != c)
+            return false;
+        ++p;
+        return true;
+    }
+}
+
+long parse_w3c_datetime(const std::string& s)
+{
+    const char* p = s.data();
+    const char* end = p + s.size();
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    t.tm_mday = 1;
+    int val = 0;
+    long offset = 0;
+
+    if (! digits(p, end, 4, val))
+        return 0;
+    t.tm_year = val - 1900;
+
+    if (p != end) {
+        if (! expect(p, end, '-') || ! digits(p, end, 2, val))
+            return 0;
+        t.tm_mon = val - 1;
+
+        if (p != end) {
+            if (! expect(p, end, '-') || ! digits(p, end, 2, val))
+                return 0;
+            t.tm_mday = val;
+
+            if (p != end) {
+                if (! expect(p, end, 'T') || ! digits(p, end, 2, t.tm_hour)
+                    || ! expect(p, end, ':') || ! digits(p, end, 2, t.tm_min))
+                    return 0;
+
+                if (p != end && *p == ':') {
+                    ++p;
+                    if (! digits(p, end, 2, t.tm_sec))
+                        return 0;
+                    if (p != end && *p == '.') {
+                        // fraction of second
+                        ++p;
+                        while (p != end && *p >= '0' && *p <= '9')
+                            ++p;
+                    }
+                }
+
+                // time zone designator is mandatory with a time
+                if (p == end)
+                    return 0;
+                if (*p == 'Z') {
+                    ++p;
+                } else if (*p == '+' || *p == '-') {
+                    int sign = *p == '-' ? -1 : 1;
+                    int hh = 0, mm = 0;
+                    ++p;
+                    if (! digits(p, end, 2, hh) || ! expect(p, end, ':') || ! digits(p, end, 2, mm))
+                        return 0;
+                    offset = sign * (hh * 3600 + mm * 60);
+                } else {
+                    return 0;
+                }
+            }
+        }
+    }
+
+    if (p != end || t.tm_mon < 0 || t.tm_mon > 11 || t.tm_mday < 1 || t.tm_mday > 31
+        || t.tm_hour > 23 || t.tm_min > 59 || t.tm_sec > 60)
+        return 0;
+
+    time_t res = timegm(&t);
+    if (res == static_cast<time_t>(-1))
+        return 0;
+    return static_cast<long>(res) - offset;
+}
+
+std::string decode_xml_entities(const std::string& s)
+{
+    if (s.find('&') == string::npos)
+        return s;
+
+    string res;
+    res.reserve(s.size());
+    for (string::size_type i = 0; i < s.size(); ++i) {
+        string::size_type semi;
+        if (s[i] != '&' || (semi = s.find(';', i)) == string::npos || semi - i > 10) {
+            res.push_back(s[i]);
+            continue;
+        }
+        const string ent = s.substr(i + 1, semi - i - 1);
+        unsigned long cp = 0;
+        if (ent == "amp")
+            cp = '&';
+        else if (ent == "lt")
+            cp = '<';
+        else if (ent == "gt")
+            cp = '>';
+        else if (ent == "quot")
+            cp = '"';
+        else if (ent == "apos")
+            cp = '\'';
+        else if (ent.size() > 1 && ent[0] == '#')
+            cp = (ent[1] == 'x' || ent[1] == 'X') ? strtoul(ent.c_str() + 2, 0, 16) : strtoul(ent.c_str() + 1, 0, 10);
+
+        if (cp == 0 || cp > 0x10FFFF) {
+            res.push_back(s[i]);
+            continue;
+        }
+
+        // UTF-8
+        if (cp < 0x80) {
+            res.push_back(static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            res.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            res.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            res.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            res.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            res.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else {
+            res.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            res.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            res.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            res.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        i = semi;
+    }
+    return res;
+}
+
+}; // namespace sitemap
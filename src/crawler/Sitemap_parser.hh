@@ -0,0 +1,140 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup crawler
+ * @brief parsing of sitemaps and sitemap indexes
+ *
+ * Detailed information about the format: http://www.sitemaps.org/protocol.html
+ *
+ * @{
+ */
+#pragma once
+
+#include <string>
+#include <boost/function.hpp>
+#include <boost/utility.hpp>
+#include <zlib.h>
+
+namespace sitemap {
+    /// Maximum number of entries in a sitemap, as in the protocol
+    static const size_t MAX_ENTRIES = 50000;
+
+    /// Maximum uncompressed size of a sitemap, as in the protocol
+    static const size_t MAX_SIZE = 52428800;
+
+    /**
+     * @brief Streaming parser for sitemaps and sitemap indexes
+     *
+     * The document is fed in chunks as it's received, nothing is buffered besides the text of
+     * the element being read, which is bounded, so memory usage is constant regardless of the
+     * size of the sitemap. Gzip compressed sitemaps are detected by their magic number and
+     * inflated on the fly.
+     *
+     * Only <loc> and <lastmod> inside <url> (sitemap) or <sitemap> (sitemap index) are
+     * considered, everything else is skipped. Every entry found is passed to the callback, which
+     * has to check that it's on the host of the sitemap as the protocol requires.
+     */
+    class Parser : boost::noncopyable {
+    public:
+        /**
+         * @param loc url of the entry
+         * @param lastmod modification time in seconds since the epoch, 0 if not present
+         * @param sitemap true if the entry is a sitemap from a sitemap index
+         */
+        typedef boost::function<void(const std::string& loc, long lastmod, bool sitemap)> callback_t;
+
+        /**
+         * @param index false to skip the entries of a sitemap index, for sitemaps listed in one,
+         * as indexes can't be nested
+         */
+        Parser(const callback_t& cb, bool index = true);
+        ~Parser();
+
+        /**
+         * @brief parse a chunk of the document
+         * @return false if the document is invalid or over the limits of the protocol, the
+         * rest of the document should be discarded
+         */
+        bool feed(const char* data, size_t len);
+
+        /// @return number of entries passed to the callback
+        size_t entries() const { return m_entries; }
+
+        /// @return true if there was an error, @sa feed
+        bool error() const { return m_error; }
+
+    private:
+        bool inflate(const char* data, size_t len);
+        bool parse(const char* data, size_t len);
+        void tag();
+        void open(const std::string& name);
+        void close(const std::string& name);
+
+        typedef enum state_t {
+            TEXT,
+            TAG,
+            COMMENT,
+            CDATA
+        } state_t;
+
+        typedef enum element_t {
+            NONE,
+            URL,
+            SITEMAP,
+            LOC,
+            LASTMOD
+        } element_t;
+
+        callback_t m_cb;
+        bool m_index;
+        state_t m_state;
+
+        /// name of the tag being read, without attributes
+        std::string m_tag;
+        bool m_tag_closing;
+        bool m_tag_name_done;
+        char m_quote;
+        char m_prev;
+
+        /// chars matched of the terminator of a comment or CDATA section
+        size_t m_match;
+
+        /// entry (URL or SITEMAP) being read
+        element_t m_entry;
+        /// element (LOC or LASTMOD) whose text is collected
+        element_t m_element;
+        std::string m_text;
+        bool m_overflow;
+        std::string m_loc;
+        long m_lastmod;
+
+        /// -1 not known yet, 0 plain, 1 gzip
+        int m_gzip;
+        std::string m_magic;
+        z_stream m_zs;
+        bool m_zs_init;
+        bool m_zs_end;
+
+        size_t m_size;
+        size_t m_entries;
+        bool m_error;
+    };
+
+    /**
+     * @brief parse a W3C datetime as used in sitemaps: YYYY, YYYY-MM, YYYY-MM-DD,
+     * YYYY-MM-DDThh:mmTZD, YYYY-MM-DDThh:mm:ssTZD or YYYY-MM-DDThh:mm:ss.sTZD
+     * @return seconds since the epoch, 0 if it can't be parsed
+     */
+    long parse_w3c_datetime(const std::string& s);
+
+    /// decode the predefined XML entities and numeric character references
+    std::string decode_xml_entities(const std::string& s);
+};
+
+/** @} */
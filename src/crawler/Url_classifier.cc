@@ -12,7 +12,7 @@ using namespace std;
 
 bool Url_classifier::empty()
 {
-    if( ! top_q.empty() )
+    if( ! top_q.empty() || n_unresolved )
         return false;
 
     for(tbl_seq_idx_t::iterator i = table.get<seq>().begin(); i != table.get<seq>().end(); ++i)
@@ -43,6 +43,7 @@ size_t Url_classifier::size() const
     for (auto i = table.get<seq>().begin(); i != table.get<seq>().end(); ++i)
         sum += i->queue->size();
     sum += top_q.size();
+    sum += n_unresolved;
     return sum;
 }
 
@@ -58,6 +59,27 @@ bool Url_classifier::empty(size_t num)
         throw runtime_error("no such num exist");
 }
 
+void Url_classifier::add_queue(size_t num)
+{
+    if( table.get<n>().find(num) == table.get<n>().end() ) {
+        table_elmt_t t(num);
+        table.insert(t);
+    }
+}
+
+void Url_classifier::release(size_t num)
+{
+    tbl_n_idx_t::iterator i;
+    if( (i = table.get<n>().find(num)) != table.get<n>().end() ) {
+        for(std::deque<Frontier_entry>::const_iterator j = i->queue->begin(); j != i->queue->end(); ++j) {
+            top_q.push(*j);
+            ++top_groups[j->group];
+            --queued[j->host];
+        }
+        table.get<n>().erase(i);
+    }
+}
+
 bool Url_classifier::empty_top()
 {
     if( ! top_q.empty() )
@@ -69,18 +91,84 @@ bool Url_classifier::empty_top()
 
 void Url_classifier::push(const Url& u)
 {
-    tbl_host_idx_t::iterator i;
-    if( (i = table.get<host>().find(u.host())) != table.get<host>().end() ) {
-        // a queue with this hostname exists, put it there
-        i->queue->push_back(u);
+    push(Frontier_entry(u));
+}
 
+void Url_classifier::push(const Frontier_entry& entry)
+{
+    Frontier_entry u(entry);
+    const uint32_t id = hosts.intern(u.url.host_data(), u.url.host_size());
+    u.host = id;
+    if( by_address() ) {
+        if( id >= addr_groups.size() || addr_groups[id] == Host_table::NONE ) {
+            unresolved[id].push_back(u);
+            ++n_unresolved;
+            return;
+        }
+        u.group = addr_groups[id];
     } else {
+        u.group = grouping == BY_DOMAIN ? hosts.domain(id) : id;
+    }
+    classify(u);
+}
+
+void Url_classifier::address(const std::string& host, const std::string& addr)
+{
+    if( ! by_address() )
+        return;
+
+    const uint32_t id = hosts.intern(host);
+    uint32_t g = id;
+    if( ! addr.empty() ) {
+        string key = addr;
+        // the network address, it's in the same /24 so it can't be confused with another host
+        if( grouping == BY_NETWORK && key.find('.') != string::npos )
+            key.replace(key.rfind('.') + 1, string::npos, "0");
+        g = hosts.intern(key);
+    }
+    if( addr_groups.size() <= id )
+        addr_groups.resize(id + 1, Host_table::NONE);
+    addr_groups[id] = g;
+
+    unordered_map<uint32_t, vector<Frontier_entry> >::iterator i = unresolved.find(id);
+    if( i == unresolved.end() )
+        return;
+    vector<Frontier_entry> waiting;
+    waiting.swap(i->second);
+    unresolved.erase(i);
+    n_unresolved -= waiting.size();
+    for(vector<Frontier_entry>::iterator j = waiting.begin(); j != waiting.end(); ++j) {
+        j->group = g;
+        classify(*j);
+    }
+}
+
+void Url_classifier::classify(const Frontier_entry& u)
+{
+    tbl_group_idx_t::iterator i;
+    if( (i = table.get<group>().find(u.group)) != table.get<group>().end() ) {
+        // a queue with this group exists, put it there after the last url of the same host, the
+        // front is never moved as it might be in transfer
+        std::deque<Frontier_entry>& q = *i->queue;
+        size_t& in_queue = queued[u.host];
+        if( ! in_queue ) {
+            q.push_back(u);
+        } else {
+            std::deque<Frontier_entry>::reverse_iterator j = q.rbegin();
+            while( j->host != u.host )
+                ++j;
+            q.insert(j.base(), u);
+        }
+        ++in_queue;
+
+    } else if( ! top_groups.count(u.group) ) {
         // if we have some empty child queue put it there
         for(tbl_seq_idx_t::iterator j = table.get<seq>().begin(); j != table.get<seq>().end(); ++j) {
             if( j->queue->empty()) {
                 table_elmt_t t(*j);
-                t.host = u.host();
+                t.group = u.group;
                 t.queue->push_back(u);
+                ++queued[u.host];
                 bool res = table.get<seq>().replace(j,t);
                 assert(res);
                 (void) res;
@@ -90,30 +178,34 @@ void Url_classifier::push(const Url& u)
 
         // otherwise put it in top_q
         top_q.push(u);
+        ++top_groups[u.group];
+
+    } else {
+        // the group is waiting in top_q, it's taken from there as a whole
+        top_q.push(u);
+        ++top_groups[u.group];
     }
 }
 
 ostream& operator<<(ostream& os, const Url_classifier& u)
 {
     Url_classifier::tbl_n_idx_t::iterator i;
-    std::deque<Url>::iterator qi;
+    std::deque<Frontier_entry>::iterator qi;
     os << "-------------" << endl;
     os << "Classifier dump:" << endl;
     for( i = u.table.get<Url_classifier::n>().begin(); i != u.table.get<Url_classifier::n>().end(); ++i) {
-        os << "queue " << i->n << ":" << endl;
+        os << "queue " << i->n;
+        if( i->group != Host_table::NONE )
+            os << " " << u.hosts.name(i->group);
+        os << ":" << endl;
         for( qi = i->queue->begin(); qi != i->queue->end(); ++qi) {
-            os << "\t" << qi->get() << endl;
+            os << "\t" << qi->url.get() << (qi->kind == Frontier_entry::SITEMAP ? " (sitemap)" : "") << endl;
         }
     }
     os << "-------------" << endl;
     return os;
 }
 
-bool Compare_hostname::operator()(const Url& left, const Url& right)
-{
-    return left.host() < right.host();
-}
-
 void Url_classifier::pop(size_t num)
 {
     tbl_n_idx_t::iterator i;
@@ -123,6 +215,7 @@ void Url_classifier::pop(size_t num)
         else if( i->queue->empty() ) {
             throw runtime_error("empty classifying queue");
         } else {
+            --queued[i->queue->front().host];
             i->queue->pop_front();
         }
     } else {
@@ -131,7 +224,7 @@ void Url_classifier::pop(size_t num)
 }
 
 
-Url& Url_classifier::peek(size_t num)
+Frontier_entry& Url_classifier::peek(size_t num)
 {
     tbl_n_idx_t::iterator i;
     if( (i = table.get<n>().find(num)) != table.get<n>().end() ) {
@@ -140,11 +233,13 @@ Url& Url_classifier::peek(size_t num)
         else if( i->queue->empty() ) {
             //cout << "deq from top_q" << endl;
             table_elmt_t t(*i);
-            t.host = top_q.top().host();
-            while( ! top_q.empty() && top_q.top().host() == t.host ) {
+            t.group = top_q.top().group;
+            while( ! top_q.empty() && top_q.top().group == t.group ) {
                 t.queue->push_back(top_q.top());
+                ++queued[top_q.top().host];
                 top_q.pop();
             }
+            top_groups.erase(t.group);
             bool res = table.get<n>().replace(i,t);
             assert(res);
             (void) res;
@@ -155,11 +250,13 @@ Url& Url_classifier::peek(size_t num)
     } else if(! top_q.empty()) {
         table_elmt_t t(num);
 
-        t.host = top_q.top().host();
-        while( ! top_q.empty() && top_q.top().host() == t.host ) {
+        t.group = top_q.top().group;
+        while( ! top_q.empty() && top_q.top().group == t.group ) {
             t.queue->push_back(top_q.top());
+            ++queued[top_q.top().host];
             top_q.pop();
         }
+        top_groups.erase(t.group);
         //assert(table.get<n>().replace(i,t) == true);
         pair<tbl_n_idx_t::iterator,bool> p = table.get<n>().insert(t);
         assert(p.second == true);
@@ -17,6 +17,8 @@
 
 #include <deque>
 #include <queue>
+#include <unordered_map>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
@@ -25,14 +27,51 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/indexed_by.hpp>
 
-#include "Url.hh"
+#include "Compact_url.hh"
+#include "Host_table.hh"
 
 namespace mi = boost::multi_index;
 
-/// Comparison function for the priority queue
-class Compare_hostname {
+/// An url waiting to be crawled, with what we know about it, the url is stored compact and normalized
+struct Frontier_entry {
+    typedef enum kind_t {
+        /// a document
+        PAGE,
+        /// a sitemap or sitemap index, @sa sitemap::Parser
+        SITEMAP
+    } kind_t;
+
+    Frontier_entry(const Url& u, kind_t k = PAGE, long lastmod = 0, bool from_index = false, uint32_t declared_by = Host_table::NONE) :
+        url(u),
+        kind(k),
+        from_index(from_index),
+        declared_by(declared_by),
+        host(Host_table::NONE),
+        group(Host_table::NONE),
+        lastmod(lastmod)
+    {}
+
+    Compact_url url;
+    kind_t kind;
+    /// a sitemap listed in a sitemap index, so it can't be an index itself
+    bool from_index;
+    /// id of the host whose robots.txt listed this sitemap, or that of its index, Host_table::NONE if none did
+    uint32_t declared_by;
+    /// id of the host, the classifier sets it on push
+    uint32_t host;
+    /// id of the host or of its registered domain, the classifier sets it on push
+    uint32_t group;
+    /// modification time announced by a sitemap in seconds since the epoch, 0 if unknown
+    long lastmod;
+};
+
+/// Comparison function for the priority queue, keeps entries of the same group together, and in it those of the same host
+class Compare_group {
 public:
-    bool operator()(const Url& left, const Url& right);
+    bool operator()(const Frontier_entry& left, const Frontier_entry& right) const
+    {
+        return left.group < right.group || (left.group == right.group && left.host < right.host);
+    }
 };
 
 
@@ -40,7 +79,15 @@ public:
 /**
  * @brief A classifier which queues up urls grouped by host in N queues
  *
- * top_q is queue for elements yet not classified
+ * top_q is queue for elements yet not classified. Hosts are interned, and urls are grouped by the
+ * id of their host or, to be polite with servers that have many subdomains, the id of their
+ * registered domain, so www.example.com and img.example.com end in the same queue. In a queue the
+ * urls of a host are kept in a row, so that a handle is done with a host, and its robots.txt,
+ * before going to the next.
+ *
+ * Virtual hosts that share a server are grouped by its ip address, or by its /24 network. The
+ * urls of a host whose address isn't known yet wait aside until it's given with address(), the
+ * address is interned in the same table as the hosts so groups are still ids in it.
 
  * <PRE>
  *               __ queue # 1  host X
@@ -56,10 +103,19 @@ public:
 class Url_classifier {
 
 public:
-    Url_classifier() :  top_q(), table() {
+    typedef enum Grouping {
+        BY_HOST,
+        BY_DOMAIN,
+        /// ipv4 address of the host
+        BY_ADDRESS,
+        /// /24 network of the ipv4 address of the host
+        BY_NETWORK
+    } Grouping;
+
+    Url_classifier() :  grouping(BY_HOST), hosts(), addr_groups(), unresolved(), n_unresolved(0), top_q(), queued(), top_groups(), table() {
     }
     /// Constructor, @param N is the number of queues
-    Url_classifier(size_t N) :  top_q(), table() {
+    Url_classifier(size_t N, Grouping g = BY_HOST) :  grouping(g), hosts(), addr_groups(), unresolved(), n_unresolved(0), top_q(), queued(), top_groups(), table() {
         for(size_t i=0; i<N; ++i) {
             table_elmt_t t(i);
             table.insert(t);
@@ -68,15 +124,31 @@ public:
 
     /// Adds an url to classify and enqueue
     void push(const Url&);
+    void push(const Frontier_entry&);
+
+    /// @return true if urls are grouped by the address of their host
+    bool by_address() const { return grouping == BY_ADDRESS || grouping == BY_NETWORK; }
+
+    /**
+     * The address of host is known, classify the urls that were waiting for it. An empty addr
+     * means that it couldn't be resolved, its urls are grouped by host then.
+     */
+    void address(const std::string& host, const std::string& addr);
 
     /// Take a peek at queue n
-    Url& peek(size_t n);
+    Frontier_entry& peek(size_t n);
 
     /// Pop queue # @param n
     void pop(size_t n);
 
     /// Returns true if queue n
     bool empty(size_t n);
+
+    /// Creates queue n if it doesn't exist
+    void add_queue(size_t n);
+
+    /// Removes queue n, the urls it held go back to the top queue to be classified again
+    void release(size_t n);
     //boost::shared_ptr<std::deque<Url> > queue(size_t num);
 
     /// @return true if all the queues are empty
@@ -91,20 +163,29 @@ public:
     /// @return number of elements in top queue
     size_t q_len_top() const;
 
+    /// @return number of elements waiting for the address of their host
+    size_t q_len_unresolved() const { return n_unresolved; }
+
     /// @return total elements in all queues
     size_t size() const;
 
+    /// hosts seen so far, the groups are ids in it
+    const Host_table& host_table() const { return hosts; }
+
 private:
+    /// puts u, which already has a group, in its queue or in top_q
+    void classify(const Frontier_entry& u);
 
     /**
-     * Element that holds a subqueue, with same host
+     * Element that holds a subqueue, with same group
      */
     struct table_elmt_t {
-        table_elmt_t(size_t nn) : host(), queue(new std::deque<Url>()), n(nn)
+        table_elmt_t(size_t nn) : group(Host_table::NONE), queue(new std::deque<Frontier_entry>()), n(nn)
         {}
 
-        std::string host;
-        boost::shared_ptr<std::deque<Url> > queue;
+        /// group of the urls in queue, NONE if it's not assigned
+        uint32_t group;
+        boost::shared_ptr<std::deque<Frontier_entry> > queue;
         /**
          * Index of subqueue
          */
@@ -112,7 +193,7 @@ private:
     };
 
     // tags for access
-    struct host {};
+    struct group {};
     //struct q {};
     struct n {};
     struct seq {};
@@ -120,19 +201,29 @@ private:
     typedef mi::multi_index_container<
         table_elmt_t,
         mi::indexed_by<
-            mi::ordered_non_unique<mi::tag<host>, mi::member<table_elmt_t,std::string,&table_elmt_t::host> >,
+            mi::ordered_non_unique<mi::tag<group>, mi::member<table_elmt_t,uint32_t,&table_elmt_t::group> >,
             mi::sequenced<mi::tag<seq> >,
             mi::ordered_unique<mi::tag<n>, mi::member<table_elmt_t,size_t,&table_elmt_t::n> >
         >
     > table_t;
 
-    typedef table_t::index<host>::type tbl_host_idx_t;
+    typedef table_t::index<group>::type tbl_group_idx_t;
     typedef table_t::index<n>::type tbl_n_idx_t;
     typedef table_t::index<seq>::type tbl_seq_idx_t;
 
 
-    //boost::shared_ptr<std::deque<Url> > top_q;
-    std::priority_queue<Url, std::deque<Url>, Compare_hostname> top_q;
+    Grouping grouping;
+    Host_table hosts;
+    /// by host id, the group of its address, NONE if it's not known yet
+    std::vector<uint32_t> addr_groups;
+    /// by host id, urls waiting for the address
+    std::unordered_map<uint32_t, std::vector<Frontier_entry> > unresolved;
+    size_t n_unresolved;
+    std::priority_queue<Frontier_entry, std::deque<Frontier_entry>, Compare_group> top_q;
+    /// by host id, urls in the queues of the table, to know if there's a run of the host to append to
+    std::unordered_map<uint32_t, size_t> queued;
+    /// by group, urls in top_q, so that a group is never split between top_q and a queue
+    std::unordered_map<uint32_t, size_t> top_groups;
     table_t table;
 
     friend std::ostream& operator<<(std::ostream& os, const Url_classifier& u);
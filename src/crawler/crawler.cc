@@ -14,6 +14,7 @@
  * The urls are classified with Url_classifier
  */
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <curl/curl.h>
 #include <event.h>
 #include <fcntl.h> // O_RDWR
@@ -26,9 +27,14 @@
 #include <cstdlib>
 #include <cstring>
 #include <stdexcept>
+#include <unordered_set>
 
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/bind.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/ptr_container/ptr_map.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <log4cxx/logger.h>
 #include <log4cxx/basicconfigurator.h>
@@ -37,7 +43,11 @@
 
 #include "Doc.hh"
 #include "Url_classifier.hh"
+#include "Concurrency_controller.hh"
+#include "Rate_limiter.hh"
+#include "Resolver.hh"
 #include "Robots.hh"
+#include "Sitemap_parser.hh"
 #include "utils.hh"
 #include "timer.hh"
 
@@ -54,6 +64,9 @@ static const long MAXREDIRS  = 5;
 /// When more than these bytes are transferred, the transfer is cutoff
 static const size_t CONTENT_SIZE_LIMIT = 1048576;
 
+/// Refill period of the bandwidth shaping token buckets
+static const long SHAPER_INTERVAL_MS = 100;
+
 /// default size for buffers
 #define BSIZE    8192
 #include <dmalloc.h>
@@ -64,6 +77,8 @@ static const size_t CONTENT_SIZE_LIMIT = 1048576;
     } while(0);
 
 static const size_t PARALLEL_DEFAULT = 20;
+/// Upper bound of the autoscaler is this times the initial number of handles by default
+static const size_t PARALLEL_MAX_FACTOR = 10;
 static const char* MONGODB_NAMESPACE_DEFAULT = "mycelium.crawl";
 
 using namespace std;
@@ -71,7 +86,7 @@ using namespace std;
 
 namespace {
 
-const char *statestr[] = {"IDLE", "ROBOTS", "NEXT", "HEAD", "CONTENT"};
+const char *statestr[] = {"IDLE", "ROBOTS", "NEXT", "HEAD", "CONTENT", "SITEMAP"};
 struct GlobalInfo;
 struct SockInfo;
 
@@ -94,14 +109,26 @@ void timer_cb(int fd, short kind, void *userp);
 /// ev_timer callback to periodically reschedule to dequeue work and print some stats
 void scheduler_cb(int fd, short kind, void *userp);
 
+/// ev_timer callback to refill the rate limiter and resume paused transfers
+void shaper_cb(int fd, short kind, void *userp);
+
 void mcode_or_die(const char* where, CURLMcode code);
 
 /// curl callback for headers
 size_t header_write_cb (void* ptr, size_t size, size_t nmemb, void* data);
 
+/// curl callback for the headers of transfers that don't keep them, they are only counted
+size_t header_count_cb (void* ptr, size_t size, size_t nmemb, void* data);
+
 /// curl callback for content
 size_t content_write_cb (void* ptr, size_t size, size_t nmemb, void* data);
 
+/// curl callback for sitemaps, the content is parsed as it arrives
+size_t sitemap_write_cb (void* ptr, size_t size, size_t nmemb, void* data);
+
+/// @return true if we crawl this kind of url
+bool crawlable(const Url& url);
+
 /// progress callback
 int progress_cb (void* p, double dltotal, double dlnow, double ult, double uln);
 
@@ -146,13 +173,18 @@ public:
         last_resched_time(utils::timer::current()),
         prev_dl_cnt(0),
         doc(),
-        m_content_os(),
+        m_sitemap(),
+        m_content(),
         m_headers_os(),
         robots_entry(),
+        m_robots_host(Host_table::NONE),
         global(g),
         curl_error(),
         state(EasyHandle::IDLE),
-        headers()
+        headers(),
+        m_resolve(),
+        m_shaper(),
+        m_paused(false)
     {
         easy = curl_easy_init();
         if( ! easy )
@@ -168,6 +200,8 @@ public:
             curl_slist_free_all(headers);
             headers = 0;
         }
+        if (m_resolve)
+            curl_slist_free_all(m_resolve);
     }
 
     /// reset everything prior to a new transfer
@@ -198,10 +232,16 @@ public:
 
     boost::scoped_ptr<Doc> doc;
 
-    std::ostringstream m_content_os;
+    /// parser for the sitemap being retrieved
+    boost::scoped_ptr<sitemap::Parser> m_sitemap;
+
+    /// body of the response, appended in place as it arrives
+    std::string m_content;
     std::ostringstream m_headers_os;
 
     boost::scoped_ptr<robots::Robots_entry> robots_entry;
+    /// id in the classifier's Host_table of the host robots_entry applies to
+    uint32_t m_robots_host;
 
     GlobalInfo* global;
     char curl_error[CURL_ERROR_SIZE];
@@ -213,16 +253,32 @@ public:
         ROBOTS,
         NEXT,
         HEAD,
-        CONTENT
+        CONTENT,
+        SITEMAP
     } state_t;
     state_t state;
 
     curl_slist *headers;
+    /// CURLOPT_RESOLVE entries, curl needs them during the transfer
+    curl_slist *m_resolve;
+
+    /// rate limiter buckets for the host of the current transfer
+    Rate_limiter::Chain m_shaper;
+    /// the transfer is paused waiting for tokens
+    bool m_paused;
+
+    /// pause the transfer until the rate limiter has tokens for it @sa shaper_cb
+    void pause();
 
 private:
+    /// hand curl the address of the host if it's already resolved @sa Resolver
+    void pre_resolve(const Url& url);
     void get_content(const Url& url, bool preexisting = false);
     void get_robots(const Url& url);
     void head(const Url& url);
+    /// @param from_index true if it was listed in a sitemap index, its <sitemap> entries are ignored
+    /// @param declared_by @sa Frontier_entry::declared_by
+    void get_sitemap(const Url& url, bool from_index, uint32_t declared_by);
     bool acceptable(content_type::content_type_t&) const;
 };
 
@@ -276,7 +332,7 @@ private:
     GlobalInfo(const GlobalInfo&);
     void operator=(const GlobalInfo&);
 public:
-    GlobalInfo(size_t parallel, const std::string& port) :
+    GlobalInfo(size_t parallel, size_t parallel_max, const std::string& port, Url_classifier::Grouping grouping) :
         mongodb_conn(),
         mongodb_namespace(MONGODB_NAMESPACE_DEFAULT),
         m_listen_sock(-1),
@@ -286,12 +342,19 @@ public:
         dl_bytes(0),
         dl_bytes_prev(0),
         dl_prev_sample(utils::timer::current()),
+        cpu_prev(cpu_time()),
         prev_running(0),
         still_running(0),
         m_ndocs_saved(0),
-        classifier(parallel),
+        m_sitemap_urls(0),
+        m_sitemaps(),
+        classifier(parallel, grouping),
+        concurrency(parallel, 1, parallel_max),
+        resolver(boost::bind(&GlobalInfo::resolved, this, _1, _2)),
         m_easyHandles(),
         user_agent("mycelium web crawler - https://github.com/larroy/mycelium"),
+        rate_limiter(),
+        m_paused(),
         connections(),
         m_parallel(parallel),
         m_port(port)
@@ -324,6 +387,33 @@ public:
         curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, multi_timer_cb);
         curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
 
+        share = curl_share_init();
+        if (share == NULL)
+            throw std::runtime_error("Couldn't initialize share interface");
+
+        // resolved names and tls sessions are reused by every handle, not just the one that got them
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock_cb);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock_cb);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+        // the connection cache can't be used from several threads at once, only while this is single threaded
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+
+        if ((res = getenv("MYCELIUM_CRAWLER_TARGET_KBS")))
+            concurrency.target_kBs(atof(res));
+
+        if ((res = getenv("MYCELIUM_CRAWLER_MAX_CPU")))
+            concurrency.max_cpu(atof(res));
+
+        if ((res = getenv("MYCELIUM_CRAWLER_AUTOSCALE")))
+            concurrency.enabled(atoi(res) != 0);
+
+        if ((res = getenv("MYCELIUM_CRAWLER_RATE_LIMIT")))
+            rate_limiter.global(atof(res));
+
         m_easyHandles.reserve(m_parallel);
         for(size_t i = 0; i < m_parallel; ++i)
             m_easyHandles.push_back(new EasyHandle(this,i));
@@ -331,6 +421,7 @@ public:
         listen();
         evtimer_set(&timer_event, timer_cb, this);
         evtimer_set(&scheduler_event, scheduler_cb, this);
+        evtimer_set(&shaper_event, shaper_cb, this);
 
         long timeout_ms = 5000;
         struct timeval timeout;
@@ -338,6 +429,10 @@ public:
         timeout.tv_usec = (timeout_ms%1000)*1000;
         evtimer_add(&scheduler_event, &timeout);
 
+        timeout.tv_sec = SHAPER_INTERVAL_MS/1000;
+        timeout.tv_usec = (SHAPER_INTERVAL_MS%1000)*1000;
+        evtimer_add(&shaper_event, &timeout);
+
 
         event_set (&interactive_event, STDIN_FILENO, EV_READ | EV_PERSIST, on_read_interactive_cb, this);
         event_add (&interactive_event, NULL);
@@ -345,10 +440,11 @@ public:
 
     ~GlobalInfo()
     {
-        for(size_t i = 0; i < m_parallel; ++i)
+        for(size_t i = 0; i < m_easyHandles.size(); ++i)
             delete m_easyHandles[i];
 
         curl_multi_cleanup(multi);
+        curl_share_cleanup(share);
     }
 
     void listen();
@@ -356,6 +452,57 @@ public:
     /// call reschedule on IDLE easy handles
     void reschedule();
 
+    /**
+     * Change the number of active easy handles. New handles are allocated as needed, when
+     * shrinking the handles beyond n finish their current transfer and give back their queue
+     * @sa EasyHandle::reschedule
+     */
+    void parallel(size_t n);
+
+    /// @return true if the handle with this id should take new work
+    bool active(size_t id) const { return id < m_parallel; }
+
+    /// feed the concurrency controller with the measurements of the last interval
+    void autoscale(double kBs, double cpu);
+
+    /// @return user + system CPU time of the process in us
+    static int64_t cpu_time();
+
+    /// Enqueue an url and start resolving its host
+    void enqueue(const Frontier_entry& entry);
+
+    /// Called when the host of enqueued urls is resolved @sa Resolver::callback_t
+    void resolved(const std::string& host, const Resolver::Entry& entry);
+
+    /// Enqueue a sitemap, unless it was seen before, @sa Frontier_entry::from_index Frontier_entry::declared_by
+    void add_sitemap(const std::string& loc, bool from_index = false, uint32_t declared_by = Host_table::NONE);
+
+    /**
+     * Called for every entry found in the sitemap at url sitemap @sa sitemap::Parser::callback_t
+     * @param declared_by @sa Frontier_entry::declared_by
+     * @param robots robots.txt of the host of the sitemap, urls it disallows are dropped
+     */
+    void sitemap_entry(const Url& sitemap, uint32_t declared_by, const robots::Robots_entry* robots, const std::string& loc, long lastmod, bool is_sitemap);
+
+    /// CURLSHOPT_LOCKFUNC
+    static void share_lock_cb(CURL* handle, curl_lock_data data, curl_lock_access access, void* userp);
+    /// CURLSHOPT_UNLOCKFUNC
+    static void share_unlock_cb(CURL* handle, curl_lock_data data, void* userp);
+
+    /// Connection reuse, accumulated as transfers finish
+    struct Net_stats {
+        Net_stats() : transfers(0), connects(0), reused(0), handshakes(0), pre_resolved(0) {}
+        size_t transfers;
+        /// connections opened
+        size_t connects;
+        /// transfers that didn't open a connection
+        size_t reused;
+        /// tls handshakes done, resumed sessions included
+        size_t handshakes;
+        /// transfers that got the address from the resolver
+        size_t pre_resolved;
+    };
+
 
     mongo::DBClientConnection mongodb_conn;
     std::string mongodb_namespace;
@@ -372,22 +519,38 @@ public:
     struct event scheduler_event;
 
     CURLM *multi;
+    /// dns cache, tls sessions and connections shared by the easy handles
+    CURLSH *share;
+    boost::mutex share_locks[CURL_LOCK_DATA_LAST];
+    Net_stats net_stats;
     uint64_t dl_bytes;
     uint64_t dl_bytes_prev;
     utils::timer dl_prev_sample;
+    int64_t cpu_prev;
     int prev_running;
     int still_running;
     size_t m_ndocs_saved;
+    /// urls enqueued from sitemaps
+    size_t m_sitemap_urls;
+    /// sitemaps already enqueued
+    std::unordered_set<Url> m_sitemaps;
 
 
     Url_classifier classifier;
+    Concurrency_controller concurrency;
+    /// resolves hosts as their urls are enqueued
+    Resolver resolver;
 
     // easy handles
     std::vector<EasyHandle*> m_easyHandles;
 
     std::string user_agent;
-    //int rate_limit;
+    Rate_limiter rate_limiter;
+    /// handles paused by the rate limiter
+    std::vector<EasyHandle*> m_paused;
+    struct event shaper_event;
     boost::ptr_map<int, Connection> connections;
+    /// number of active easy handles, can be less than m_easyHandles.size()
     size_t m_parallel;
     std::string m_port;
 };
@@ -482,10 +645,15 @@ void scheduler_cb(int fd, short kind, void *userp)
     g->reschedule();
     utils::timer delta = utils::timer::current() - g->dl_prev_sample;
     double kBs = (static_cast<double>(g->dl_bytes -  g->dl_bytes_prev) / delta.usec()) * 1000;
+    int64_t cpu_now = GlobalInfo::cpu_time();
+    double cpu = (static_cast<double>(cpu_now - g->cpu_prev) / delta.usec()) * 100;
     g->dl_bytes_prev = g->dl_bytes;
+    g->cpu_prev = cpu_now;
     g->dl_prev_sample = utils::timer::current();
 
-    cout << "Downloaded: " << utils::fmt_bytes(g->dl_bytes) << " rate: " << utils::fmt_kbytes_s(kBs) << " done: " << g->m_ndocs_saved << " enqueued: " << g->classifier.size() << endl;
+    g->autoscale(kBs, cpu);
+
+    cout << "Downloaded: " << utils::fmt_bytes(g->dl_bytes) << " rate: " << utils::fmt_kbytes_s(kBs) << " done: " << g->m_ndocs_saved << " enqueued: " << g->classifier.size() << " from sitemaps: " << g->m_sitemap_urls << " handles: " << g->m_parallel << " resolving: " << g->resolver.pending() << " cpu: " << static_cast<int>(cpu) << "%" << endl;
     if (quit_program)
         //throw runtime_error("quit_program");
         event_loopbreak();
@@ -498,6 +666,37 @@ void scheduler_cb(int fd, short kind, void *userp)
 }
 
 
+void shaper_cb(int fd, short kind, void *userp)
+{
+    GlobalInfo *g = (GlobalInfo *)userp;
+
+    g->rate_limiter.refill();
+    g->resolver.tick();
+
+    // resuming a transfer delivers the pending data right away, which can pause it again
+    // and put it back in g->m_paused
+    std::vector<EasyHandle*> paused;
+    paused.swap(g->m_paused);
+    for (auto i = paused.begin(); i != paused.end(); ++i) {
+        EasyHandle* h = *i;
+        if (! h->m_paused)
+            continue;
+
+        if (g->rate_limiter.admit(h->m_shaper)) {
+            h->m_paused = false;
+            curl_easy_pause(h->easy, CURLPAUSE_CONT);
+        } else {
+            g->m_paused.push_back(h);
+        }
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = SHAPER_INTERVAL_MS/1000;
+    timeout.tv_usec = (SHAPER_INTERVAL_MS%1000)*1000;
+    evtimer_add(&g->shaper_event, &timeout);
+}
+
+
 /// Die if we get a bad CURLMcode somewhere
 void mcode_or_die(const char *where, CURLMcode code)
 {
@@ -560,10 +759,26 @@ size_t header_write_cb (void* buff, size_t size, size_t nmemb, void* data)
 
     size_t realsize = size * nmemb;
     handle->global->dl_bytes += realsize;
+    handle->global->rate_limiter.consume(handle->m_shaper, realsize);
     handle->m_headers_os.write(static_cast<char*>(buff), realsize);
     return realsize;
 }
 
+/* CURLOPT_HEADERFUNCTION of robots.txt and sitemaps */
+size_t header_count_cb (void* buff, size_t size, size_t nmemb, void* data)
+{
+    (void) buff;
+    EasyHandle* handle = static_cast<EasyHandle*>(data);
+    if(! handle)
+        throw runtime_error("null data on header_count_cb");
+
+    // headers can't pause the transfer, the bytes are charged and the next body write waits
+    size_t realsize = size * nmemb;
+    handle->global->dl_bytes += realsize;
+    handle->global->rate_limiter.consume(handle->m_shaper, realsize);
+    return realsize;
+}
+
 /* CURLOPT_WRITEFUNCTION */
 size_t content_write_cb (void* buff, size_t size, size_t nmemb, void* data)
 {
@@ -571,10 +786,16 @@ size_t content_write_cb (void* buff, size_t size, size_t nmemb, void* data)
     if( ! handle )
         throw runtime_error("null WRITEDATA on write_cb");
 
+    if (! handle->global->rate_limiter.admit(handle->m_shaper)) {
+        handle->pause();
+        return CURL_WRITEFUNC_PAUSE;
+    }
+
     size_t realsize = size * nmemb;
     handle->m_content_dl_bytes += realsize;
     handle->global->dl_bytes += realsize;
-    handle->m_content_os.write(static_cast<char*>(buff), realsize);
+    handle->global->rate_limiter.consume(handle->m_shaper, realsize);
+    handle->m_content.append(static_cast<char*>(buff), realsize);
 
     if (handle->m_content_dl_bytes > CONTENT_SIZE_LIMIT) {
         LOG4CXX_DEBUG(logger, fs("handle id: " << handle->id << " size limit reached: " << handle->doc->url.get()));
@@ -583,6 +804,35 @@ size_t content_write_cb (void* buff, size_t size, size_t nmemb, void* data)
     return realsize;
 }
 
+/* CURLOPT_WRITEFUNCTION for sitemaps */
+size_t sitemap_write_cb (void* buff, size_t size, size_t nmemb, void* data)
+{
+    EasyHandle* handle = static_cast<EasyHandle*>(data);
+    if( ! handle || ! handle->m_sitemap )
+        throw runtime_error("null WRITEDATA or sitemap parser on sitemap_write_cb");
+
+    if (! handle->global->rate_limiter.admit(handle->m_shaper)) {
+        handle->pause();
+        return CURL_WRITEFUNC_PAUSE;
+    }
+
+    size_t realsize = size * nmemb;
+    handle->m_content_dl_bytes += realsize;
+    handle->global->dl_bytes += realsize;
+    handle->global->rate_limiter.consume(handle->m_shaper, realsize);
+
+    if (! handle->m_sitemap->feed(static_cast<char*>(buff), realsize)) {
+        LOG4CXX_DEBUG(logger, fs("handle id: " << handle->id << " invalid sitemap or over the limits: " << handle->doc->url.get()));
+        return 0;
+    }
+    return realsize;
+}
+
+bool crawlable(const Url& url)
+{
+    return url.absolute() && (url.scheme() == "http" || url.scheme() == "https");
+}
+
 
 /// CURLOPT_PROGRESSFUNCTION
 int progress_cb (void *p, double dltotal, double dlnow, double ult, double uln)
@@ -785,30 +1035,62 @@ void log_cb(int severity, const char *s)
 }
 
 
+void EasyHandle::pause()
+{
+    m_paused = true;
+    global->m_paused.push_back(this);
+}
+
+
 void EasyHandle::reset()
 {
     curl_easy_reset(easy);
+    my_curl_easy_setopt(easy, CURLOPT_SHARE, global->share);
+    if (m_resolve) {
+        curl_slist_free_all(m_resolve);
+        m_resolve = 0;
+    }
     doc.reset(new Doc());
-    m_content_os.str("");
+    m_content.clear();
     m_headers_os.str("");
     m_content_dl_bytes = 0;
     prev_dl_cnt = 0;
+    m_paused = false;
 }
 
 
 /// puts handle back to work, tries to dequeue next URL and set up a retrieval
 void EasyHandle::reschedule()
 {
+    if (! global->active(id)) {
+        // retired by the concurrency controller, hand back the work to the other handles
+        LOG4CXX_DEBUG(logger, fs("handle id: " << id << " retired"));
+        global->classifier.release(id);
+        robots_entry.reset();
+        /*******/
+        state = IDLE;
+        /*******/
+        return;
+    }
+
     if( global->classifier.empty_top() && global->classifier.empty(id) )
         return;
 
 
-    Url url = global->classifier.peek(id);
-    url.normalize();
+    const Frontier_entry& entry = global->classifier.peek(id);
+    Url url = entry.url.to_url();
+    bool is_sitemap = entry.kind == Frontier_entry::SITEMAP;
+    bool from_index = entry.from_index;
+    uint32_t declared_by = entry.declared_by;
 
     reset();
+    m_shaper = global->rate_limiter.chain(url.host());
 
-    bool preexisting = doc->load_url(global->mongodb_conn, global->mongodb_namespace, url);
+    bool preexisting = false;
+    if (is_sitemap)
+        doc->url = url;
+    else
+        preexisting = doc->load_url(global->mongodb_conn, global->mongodb_namespace, url);
     LOG4CXX_DEBUG(logger, fs("handle id: " << id << " " << url.get() << " preexisting: " << preexisting));
     if (preexisting) {
         /*******/
@@ -825,20 +1107,28 @@ void EasyHandle::reschedule()
             /*******/
             state = ROBOTS;
             /*******/
-            doc->url.scheme("http");
+            doc->url.scheme(url.scheme());
             doc->url.host(url.host());
             doc->url.path("robots.txt");
+            pre_resolve(doc->url);
             get_robots(doc->url);
             break;
 
         case HEAD:
+            pre_resolve(url);
             head(url);
             break;
 
         case CONTENT:
+            pre_resolve(url);
             get_content(url, preexisting);
             break;
 
+        case SITEMAP:
+            pre_resolve(url);
+            get_sitemap(url, from_index, declared_by);
+            break;
+
         default:
             throw runtime_error("unknown state in reschedule");
     }
@@ -859,6 +1149,8 @@ void EasyHandle::reschedule()
  */
 void EasyHandle::done(CURLcode result)
 {
+    m_paused = false;
+
     char *eff_url_p = NULL;
     // effective url, due to redirects
     curl_easy_getinfo(easy, CURLINFO_EFFECTIVE_URL, &eff_url_p);
@@ -877,6 +1169,19 @@ void EasyHandle::done(CURLcode result)
 
     curl_easy_getinfo(easy, CURLINFO_FILETIME, &doc->modified);
 
+    long connects = 0;
+    double appconnect = 0;
+    curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(easy, CURLINFO_APPCONNECT_TIME, &appconnect);
+    ++global->net_stats.transfers;
+    global->net_stats.connects += connects;
+    if (! connects)
+        ++global->net_stats.reused;
+    else if (appconnect > 0)
+        ++global->net_stats.handshakes;
+    if (m_resolve)
+        ++global->net_stats.pre_resolved;
+
     if (headers) {
         curl_slist_free_all(headers);
         headers = 0;
@@ -901,12 +1206,11 @@ void EasyHandle::done(CURLcode result)
             // program robots_entry
             if(result == CURLE_OK && doc->http_code == 200) {
                 try {
-                    istringstream robots_is(m_content_os.str());
-                    robots_entry.reset(new robots::Robots_entry(&robots_is));
-                    int res = robots_entry->yylex();
+                    robots_entry.reset(new robots::Robots_entry());
+                    int res = robots_entry->parse(m_content);
                     if( res < 0 ) {
                         // there's a lot of shit in the internet
-                        //LOG4CXX_DEBUG(logger, fs("Failure parsing robots: " << doc->url.get() << " " << m_content_os.str()));
+                        //LOG4CXX_DEBUG(logger, fs("Failure parsing robots: " << doc->url.get() << " " << m_content));
                         robots_entry->clear();
                         ////////////
                         robots_entry->state = robots::EPARSE;
@@ -915,9 +1219,10 @@ void EasyHandle::done(CURLcode result)
                         ////////////
                         robots_entry->state = robots::PRESENT;
                         ////////////
+                        robots_entry->compile(global->user_agent);
                     }
                 } catch(...) {
-                    LOG4CXX_WARN(logger, fs("Exception while parsing robots: " << doc->url.get() << " " << m_content_os.str()));
+                    LOG4CXX_WARN(logger, fs("Exception while parsing robots: " << doc->url.get() << " " << m_content));
                     ////////////
                     robots_entry->state = robots::EPARSE;
                     ////////////
@@ -926,6 +1231,10 @@ void EasyHandle::done(CURLcode result)
             } else {
                 robots_entry.reset(new robots::Robots_entry(robots::NOT_AVAILABLE));
             }
+            robots_entry->host = doc->url.host();
+            m_robots_host = global->classifier.host_table().find(robots_entry->host);
+            for (auto i = robots_entry->sitemaps.begin(); i != robots_entry->sitemaps.end(); ++i)
+                global->add_sitemap(*i, false, m_robots_host);
             doc->content.clear();
             /*******/
             // we don't pop as the target url is still on the queue
@@ -975,7 +1284,7 @@ void EasyHandle::done(CURLcode result)
             // HTTP GET request finished
             if( result == CURLE_OK && doc->http_code == 200) {
                 doc->headers = m_headers_os.str();
-                doc->content = m_content_os.str();
+                doc->content.swap(m_content);
                 // parse HTTP headers
                 content_type::content_type_t ctype;
                 string charset;
@@ -999,6 +1308,16 @@ void EasyHandle::done(CURLcode result)
             }
             break;
 
+        case SITEMAP:
+            // the entries were pushed to the frontier as the sitemap was parsed
+            LOG4CXX_INFO(logger, fs("handle id: " << id << " sitemap: " << doc->url.get() << " HTTP " << doc->http_code << " entries: " << m_sitemap->entries()));
+            m_sitemap.reset();
+            /*******/
+            global->classifier.pop(id);
+            state = NEXT;
+            /*******/
+            break;
+
         case NEXT:
         default:
             LOG4CXX_DEBUG(logger, "Unsupported state in EasyHandle::done");
@@ -1014,20 +1333,41 @@ void EasyHandle::done(CURLcode result)
             /*******/
             state = EasyHandle::IDLE;
             /*******/
-            Url url = global->classifier.peek(id);
-            url.normalize();
+            const Frontier_entry& entry = global->classifier.peek(id);
+            // hosts are interned by the classifier, the robots.txt we have applies if the ids match
+            const bool robots_other_host = ! robots_entry || entry.host != m_robots_host;
 
+            /// sitemaps are announced in robots.txt, they only need robots.txt to be retrieved
+            if (entry.kind == Frontier_entry::SITEMAP) {
+                /*******/
+                state = robots_other_host ? ROBOTS : SITEMAP;
+                /*******/
+                break;
+            }
+
+            Url url = entry.url.to_url();
+
+            long lastmod = entry.lastmod;
+            doc->crawled = -1;
             bool preexisting = doc->load_url(global->mongodb_conn, global->mongodb_namespace, url);
 
+            /// not modified since we crawled it, according to the sitemap
+            if (lastmod > 0 && doc->crawled >= lastmod) {
+                LOG4CXX_DEBUG(logger, fs("handle id: " << id << ", url: " << url.get() << " not modified (sitemap)"));
+                /*******/
+                global->classifier.pop(id);
+                /*******/
+                continue;
+
             /// Directly get CONTENT as if the document didn't change we get 304 without contents
-            if (preexisting) {
+            } else if (preexisting) {
                 /*******/
                 state = CONTENT;
                 /*******/
                 break;
 
-            /// robots is missing
-            } else if (! robots_entry || doc->url.host() != url.host()) {
+            /// robots is missing or it's from another host
+            } else if (robots_other_host) {
                 /*******/
                 state = ROBOTS;
                 /*******/
@@ -1038,7 +1378,7 @@ void EasyHandle::done(CURLcode result)
                 && (robots_entry->tried_but_failed()
                     || (
                            robots_entry->state == robots::PRESENT
-                        && robots_entry->path_allowed(global->user_agent, url.path())
+                        && robots_entry->allowed(url.path(), url.query())
                     )
                 )
             ) {
@@ -1065,14 +1405,29 @@ void EasyHandle::done(CURLcode result)
 
 
 
+void EasyHandle::pre_resolve(const Url& url)
+{
+    const Resolver::Entry* entry = global->resolver.lookup(url.host());
+    if (! entry || entry->addresses.empty())
+        return;
+
+    const string port = ! url.port().empty() ? url.port() : url.scheme() == "https" ? "443" : "80";
+    const string host_port = url.host() + ":" + port;
+    // replace what a previous transfer of this handle left in its dns cache
+    m_resolve = curl_slist_append(m_resolve, ("-" + host_port).c_str());
+    m_resolve = curl_slist_append(m_resolve, (host_port + ":" + entry->addresses.front()).c_str());
+    my_curl_easy_setopt(easy, CURLOPT_RESOLVE, m_resolve);
+}
+
+
 void EasyHandle::get_robots(const Url& url)
 {
 
     string url_string = url.get();
     my_curl_easy_setopt(easy, CURLOPT_URL, url_string.c_str());
 
-    my_curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, NULL);
-    my_curl_easy_setopt(easy, CURLOPT_HEADERDATA, NULL);
+    my_curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, header_count_cb);
+    my_curl_easy_setopt(easy, CURLOPT_HEADERDATA, this);
 
     //my_curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, url_string.c_str());
     my_curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, content_write_cb);
@@ -1090,6 +1445,7 @@ void EasyHandle::get_robots(const Url& url)
     my_curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, CONNECTTIMEOUT);
     my_curl_easy_setopt(easy, CURLOPT_LOW_SPEED_TIME, LOW_SPEED_TIME);
     my_curl_easy_setopt(easy, CURLOPT_LOW_SPEED_LIMIT, LOW_SPEED_LIMIT);
+    my_curl_easy_setopt(easy, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(global->rate_limiter.max_recv_speed(m_shaper)));
 
     my_curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1);
     my_curl_easy_setopt(easy, CURLOPT_MAXREDIRS, MAXREDIRS);
@@ -1130,6 +1486,7 @@ void EasyHandle::get_content(const Url& url, bool preexisting)
     my_curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, CONNECTTIMEOUT);
     my_curl_easy_setopt(easy, CURLOPT_LOW_SPEED_TIME, LOW_SPEED_TIME);
     my_curl_easy_setopt(easy, CURLOPT_LOW_SPEED_LIMIT, LOW_SPEED_LIMIT);
+    my_curl_easy_setopt(easy, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(global->rate_limiter.max_recv_speed(m_shaper)));
 
     my_curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1);
     my_curl_easy_setopt(easy, CURLOPT_MAXREDIRS, MAXREDIRS);
@@ -1194,6 +1551,7 @@ void EasyHandle::head(const Url& url)
     my_curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, CONNECTTIMEOUT);
     my_curl_easy_setopt(easy, CURLOPT_LOW_SPEED_TIME, LOW_SPEED_TIME);
     my_curl_easy_setopt(easy, CURLOPT_LOW_SPEED_LIMIT, LOW_SPEED_LIMIT);
+    my_curl_easy_setopt(easy, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(global->rate_limiter.max_recv_speed(m_shaper)));
 
     my_curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1);
     my_curl_easy_setopt(easy, CURLOPT_MAXREDIRS, MAXREDIRS);
@@ -1203,6 +1561,48 @@ void EasyHandle::head(const Url& url)
     mcode_or_die("get_content: curl_multi_add_handle", rc);
 }
 
+void EasyHandle::get_sitemap(const Url& url, bool from_index, uint32_t declared_by)
+{
+    LOG4CXX_DEBUG(logger, fs("handle id: " << id << " SITEMAP: " << url.get() << (from_index ? " (from index)" : "")));
+
+    // robots_entry is the one of the host of the sitemap, and it's kept until the transfer is done
+    m_sitemap.reset(new sitemap::Parser(boost::bind(&GlobalInfo::sitemap_entry, global, url, declared_by, robots_entry.get(), _1, _2, _3), ! from_index));
+
+    string url_string = url.get();
+    my_curl_easy_setopt(easy, CURLOPT_URL, url_string.c_str());
+
+    my_curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, header_count_cb);
+    my_curl_easy_setopt(easy, CURLOPT_HEADERDATA, this);
+
+    // content, parsed as it arrives. Sitemaps can be big, no CONTENT_SIZE_LIMIT here,
+    // the parser enforces the limits of the sitemap protocol
+    my_curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, sitemap_write_cb);
+    my_curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
+    // Content-Encoding is handled by curl, .xml.gz files by the parser
+    my_curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, "");
+
+    my_curl_easy_setopt(easy, CURLOPT_VERBOSE, 0L);
+    memset(curl_error,0,CURL_ERROR_SIZE);
+    my_curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, curl_error);
+    my_curl_easy_setopt(easy, CURLOPT_PRIVATE, this);
+    my_curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 0L);
+    my_curl_easy_setopt(easy, CURLOPT_PROGRESSFUNCTION, progress_cb);
+    my_curl_easy_setopt(easy, CURLOPT_PROGRESSDATA, this);
+    my_curl_easy_setopt(easy, CURLOPT_HTTPHEADER, 0);
+    // timeouts
+    my_curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, CONNECTTIMEOUT);
+    my_curl_easy_setopt(easy, CURLOPT_LOW_SPEED_TIME, LOW_SPEED_TIME);
+    my_curl_easy_setopt(easy, CURLOPT_LOW_SPEED_LIMIT, LOW_SPEED_LIMIT);
+    my_curl_easy_setopt(easy, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(global->rate_limiter.max_recv_speed(m_shaper)));
+
+    my_curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1);
+    my_curl_easy_setopt(easy, CURLOPT_MAXREDIRS, MAXREDIRS);
+    my_curl_easy_setopt(easy, CURLOPT_REDIR_PROTOCOLS, CURLPROTO_HTTP | CURLPROTO_HTTPS);
+
+    CURLMcode rc = curl_multi_add_handle(global->multi, easy);
+    mcode_or_die("get_sitemap: curl_multi_add_handle", rc);
+}
+
 bool EasyHandle::acceptable(content_type::content_type_t& ctype) const
 {
     return ctype > content_type::UNRECOGNIZED && ctype < content_type::EMPTY;
@@ -1223,13 +1623,131 @@ void GlobalInfo::reschedule()
 {
     for (auto i = m_easyHandles.begin(); i != m_easyHandles.end(); ++i) {
         EasyHandle* h = *i;
-        if( h->state == EasyHandle::IDLE ) {
+        if( h->state == EasyHandle::IDLE && active(h->id) ) {
             h->reschedule();
         }
     }
 }
 
 
+void GlobalInfo::parallel(size_t n)
+{
+    concurrency.active(n);
+    n = concurrency.active();
+    if (n == m_parallel)
+        return;
+
+    LOG4CXX_INFO(logger, fs("active handles: " << m_parallel << " -> " << n));
+    while (m_easyHandles.size() < n)
+        m_easyHandles.push_back(new EasyHandle(this, m_easyHandles.size()));
+
+    for (size_t i = m_parallel; i < n; ++i)
+        classifier.add_queue(i);
+
+    size_t prev = m_parallel;
+    m_parallel = n;
+
+    // idle handles beyond the new limit give back their queues right away, busy
+    // ones do it when their transfer is done
+    for (size_t i = n; i < prev; ++i)
+        if (m_easyHandles[i]->state == EasyHandle::IDLE)
+            m_easyHandles[i]->reschedule();
+
+    reschedule();
+}
+
+
+void GlobalInfo::autoscale(double kBs, double cpu)
+{
+    Concurrency_controller::Sample s;
+    s.kBs = kBs;
+    s.cpu = cpu;
+    double handle_kBs = 0;
+    for (auto i = m_easyHandles.begin(); i != m_easyHandles.end(); ++i) {
+        if ((*i)->state != EasyHandle::IDLE) {
+            ++s.busy;
+            handle_kBs += (*i)->dl_kBs;
+        }
+    }
+    if (s.busy)
+        s.handle_kBs = handle_kBs / s.busy;
+    s.waiting = classifier.q_len_top();
+
+    parallel(concurrency.update(s));
+}
+
+
+void GlobalInfo::enqueue(const Frontier_entry& entry)
+{
+    classifier.push(entry);
+    resolver.resolve(entry.url.host());
+}
+
+
+void GlobalInfo::resolved(const std::string& host, const Resolver::Entry& entry)
+{
+    classifier.address(host, entry.addresses.empty() ? string() : entry.addresses.front());
+}
+
+
+void GlobalInfo::add_sitemap(const std::string& loc, bool from_index, uint32_t declared_by)
+{
+    try {
+        Url url(loc);
+        if (! crawlable(url))
+            return;
+
+        url.normalize();
+        if (m_sitemaps.insert(url).second) {
+            LOG4CXX_DEBUG(logger, fs("sitemap: " << url.get()));
+            enqueue(Frontier_entry(url, Frontier_entry::SITEMAP, 0, from_index, declared_by));
+        }
+    } catch(UrlParseError& e) {
+        LOG4CXX_DEBUG(logger, fs("sitemap url parse error: " << loc << " : " << e.what()));
+    }
+}
+
+
+void GlobalInfo::sitemap_entry(const Url& sitemap, uint32_t declared_by, const robots::Robots_entry* robots, const std::string& loc, long lastmod, bool is_sitemap)
+{
+    try {
+        Url url(loc);
+        // the protocol only allows urls on the host of the sitemap, else any site could add others
+        // to the crawl, or on the host whose robots.txt listed it, which vouches for it wherever it is
+        if (! boost::iequals(url.host(), sitemap.host())
+            && (declared_by == Host_table::NONE || ! boost::iequals(url.host(), classifier.host_table().name(declared_by)))) {
+            LOG4CXX_DEBUG(logger, fs("sitemap entry on another host: " << loc << " in " << sitemap.get()));
+            return;
+        }
+
+        if (is_sitemap) {
+            // listed in an index, so the sitemaps it lists in turn are ignored
+            add_sitemap(loc, true, declared_by);
+        } else if (crawlable(url)) {
+            // urls of another host are checked against its robots.txt when they are crawled
+            if (robots && robots->state == robots::PRESENT && boost::iequals(url.host(), robots->host)
+                && ! robots->allowed(url.path(), url.query())) {
+                LOG4CXX_DEBUG(logger, fs("sitemap entry not allowed (robots.txt): " << loc << " in " << sitemap.get()));
+                return;
+            }
+            ++m_sitemap_urls;
+            enqueue(Frontier_entry(url, Frontier_entry::PAGE, lastmod));
+        }
+    } catch(UrlParseError& e) {
+        LOG4CXX_DEBUG(logger, fs("sitemap url parse error: " << loc << " : " << e.what()));
+    }
+}
+
+
+int64_t GlobalInfo::cpu_time()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) < 0)
+        utils::err_sys("getrusage");
+    return utils::timer(usage.ru_utime).usec() + utils::timer(usage.ru_stime).usec();
+}
+
+
 
 /* Check for completed transfers, and remove their easy handles */
 void GlobalInfo::check_run_count ()
@@ -1293,12 +1811,11 @@ void GlobalInfo::Connection::process_input_buff(bool flush)
                 Url url(line);
                 //cout << "url: " << url << endl;
                 //LOG4CXX_INFO(logger, fs("read url: " << url.get()));
-                // TODO only accept http scheme
-                if( url.absolute() && url.scheme() == "http" ) {
+                if( crawlable(url) ) {
                     ++m_num_urls;
-                    m_globalInfo->classifier.push(url);
+                    m_globalInfo->enqueue(Frontier_entry(url));
                 } else {
-                    LOG4CXX_WARN(logger, fs("non-http scheme, ignoring " << url.to_string() << endl));
+                    LOG4CXX_WARN(logger, fs("not crawlable, ignoring " << url.to_string() << endl));
                 }
 
             } catch(UrlParseError& e) {
@@ -1318,7 +1835,7 @@ void GlobalInfo::Connection::process_input_buff(bool flush)
             Url url(line);
             //cout << "url: " << url << endl;
             LOG4CXX_DEBUG(logger, fs("read url: " << url.get()));
-            m_globalInfo->classifier.push(url);
+            m_globalInfo->enqueue(Frontier_entry(url));
         } catch(UrlParseError& e) {
             LOG4CXX_ERROR(logger, fs("url parse error: " << line << " : " << e.what() ));
         }
@@ -1359,8 +1876,28 @@ void GlobalInfo::interactive_process(bool flush)
 }
 
 
+void GlobalInfo::share_lock_cb(CURL* handle, curl_lock_data data, curl_lock_access access, void* userp)
+{
+    (void) handle;
+    (void) access;
+    static_cast<GlobalInfo*>(userp)->share_locks[data].lock();
+}
+
+
+void GlobalInfo::share_unlock_cb(CURL* handle, curl_lock_data data, void* userp)
+{
+    (void) handle;
+    static_cast<GlobalInfo*>(userp)->share_locks[data].unlock();
+}
+
+
 void GlobalInfo::status()
 {
+    cout << "transfers: " << net_stats.transfers << " connects: " << net_stats.connects
+        << " reused: " << net_stats.reused << " tls handshakes: " << net_stats.handshakes
+        << " pre-resolved: " << net_stats.pre_resolved << endl;
+    const Resolver::Stats& rs = resolver.stats();
+    cout << "dns queries: " << rs.queries << " cache hits: " << rs.hits << " failures: " << rs.failures << endl;
     for (auto i = m_easyHandles.begin(); i != m_easyHandles.end(); ++i) {
         utils::timer timediff = utils::timer::current() - (*i)->last_resched_time;
         if ((*i)->doc && ! (*i)->state == EasyHandle::IDLE)
@@ -1374,11 +1911,71 @@ void GlobalInfo::status()
 
 void GlobalInfo::interactive_cmd(const std::string& cmd)
 {
+    istringstream is(cmd);
+    string verb;
+    is >> verb;
     if( cmd == "qlen" ) {
         cout << "Parent queue len: " << classifier.q_len_top() << endl;
         for(size_t i = 0; i < m_parallel; ++i)
             cout << "child queue " << i << " len: " << classifier.q_len(i) << endl;
         cout << endl;
+    } else if (verb == "parallel") {
+        size_t n = 0;
+        if (is >> n) {
+            // a manual setting overrides the controller
+            concurrency.enabled(false);
+            parallel(n);
+        }
+        cout << concurrency << " allocated: " << m_easyHandles.size() << endl;
+    } else if (verb == "autoscale") {
+        string what;
+        is >> what;
+        if (what == "on") {
+            concurrency.enabled(true);
+        } else if (what == "off") {
+            concurrency.enabled(false);
+        } else if (what == "bw") {
+            double t = 0;
+            if (is >> t)
+                concurrency.target_kBs(t);
+        } else if (what == "cpu") {
+            double c = 0;
+            if (is >> c)
+                concurrency.max_cpu(c);
+        } else if (what == "range") {
+            size_t lo = 0, hi = 0;
+            if (is >> lo >> hi) {
+                try {
+                    concurrency.range(lo, hi);
+                    parallel(concurrency.active());
+                } catch (std::invalid_argument& e) {
+                    cout << e.what() << endl;
+                }
+            }
+        } else if (! what.empty()) {
+            cout << "usage: autoscale [on|off|bw <KB/s>|cpu <percent>|range <min> <max>]" << endl;
+        }
+        cout << concurrency << endl;
+    } else if (verb == "ratelimit") {
+        string what;
+        is >> what;
+        if (what == "global") {
+            double kBs = 0;
+            if (is >> kBs)
+                rate_limiter.global(kBs);
+        } else if (what == "group" || what == "host") {
+            string name;
+            double kBs = 0;
+            if (is >> name >> kBs) {
+                if (what == "group")
+                    rate_limiter.group(name, kBs);
+                else
+                    rate_limiter.host(name, kBs);
+            }
+        } else if (! what.empty()) {
+            cout << "usage: ratelimit [global <KB/s>|group <domain> <KB/s>|host <host> <KB/s>], 0 removes a limit" << endl;
+        }
+        cout << rate_limiter;
     } else if (cmd == "dumpq") {
         cout << classifier << endl;
     } else if (cmd == "quit") {
@@ -1390,7 +1987,7 @@ void GlobalInfo::interactive_cmd(const std::string& cmd)
     } else if (cmd == "status") {
         status();
     } else if (cmd == "help" || cmd == "h") {
-        cout << "commands: qlen dumpq reschedule status help quit" << endl;
+        cout << "commands: qlen dumpq reschedule status parallel autoscale ratelimit help quit" << endl;
     }
 }
 
@@ -1415,15 +2012,35 @@ try {
     if (parallel <= 0)
         throw std::runtime_error(fs("MYCELIUM_CRAWLER_PARALLEL can't be negative or 0"));
 
+    int parallel_max = parallel * PARALLEL_MAX_FACTOR;
+    if ((res = getenv("MYCELIUM_CRAWLER_PARALLEL_MAX")))
+        parallel_max = atoi(res);
+
+    if (parallel_max < parallel)
+        throw std::runtime_error(fs("MYCELIUM_CRAWLER_PARALLEL_MAX can't be less than MYCELIUM_CRAWLER_PARALLEL"));
+
     string port("1024");
     if ((res = getenv("CRAWLER_PORT")))
         port.assign(res);
 
+    Url_classifier::Grouping grouping = Url_classifier::BY_HOST;
+    if ((res = getenv("MYCELIUM_CRAWLER_GROUP_BY"))) {
+        string by(res);
+        if (by == "domain")
+            grouping = Url_classifier::BY_DOMAIN;
+        else if (by == "address")
+            grouping = Url_classifier::BY_ADDRESS;
+        else if (by == "network")
+            grouping = Url_classifier::BY_NETWORK;
+        else if (by != "host")
+            throw std::runtime_error(fs("MYCELIUM_CRAWLER_GROUP_BY must be host, domain, address or network"));
+    }
+
 
     LOG4CXX_INFO(logger, fs("Starting " << parallel << " crawlers"));
 
     event_init();
-    GlobalInfo g(static_cast<size_t>(parallel), port);
+    GlobalInfo g(static_cast<size_t>(parallel), static_cast<size_t>(parallel_max), port, grouping);
     event_set_log_callback(log_cb);
     event_dispatch();
     return EXIT_SUCCESS;
@@ -1,16 +1,13 @@
 #include "Case_folder.hh"
 #include "unicode/utypes.h"
-#include "unicode/putil.h"
-#include "unicode/uiter.h"
 #include "unicode/uchar.h"
 #include "unicode/ucasemap.h"
 
-//#include "ucnv_filter.hh"
 #include "Unicode_wrap.hh"
 
-#include <vector>
+#include <cstring>
 #include <stdexcept>
-#include <iostream>
+#include <stdint.h>
 
 #include "utils.hh"
 
@@ -19,108 +16,109 @@ using namespace std;
 
 namespace features {
 
+namespace {
+	const uint64_t ONES = 0x0101010101010101ULL;
+	const uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+	/// lowercase the 8 ASCII bytes of w at once: the high bit of a byte is set by the sums only if it's in [A-Z]
+	uint64_t lower_ascii(uint64_t w)
+	{
+		const uint64_t ge_A = w + (0x80 - 'A') * ONES;
+		const uint64_t gt_Z = w + (0x7f - 'Z') * ONES;
+		return w | ((ge_A & ~gt_Z & HIGH_BITS) >> 2);
+	}
+
+	/// lowercase s into dest if it's all ASCII
+	bool fold_ascii(const char* s, size_t len, char* dest)
+	{
+		const char* end = s + len;
+		for(; end - s >= 8; s += 8, dest += 8) {
+			uint64_t w;
+			memcpy(&w, s, sizeof(w));
+			if( w & HIGH_BITS )
+				return false;
+			w = lower_ascii(w);
+			memcpy(dest, &w, sizeof(w));
+		}
+		for(; s != end; ++s, ++dest) {
+			if( *s & 0x80 )
+				return false;
+			*dest = *s >= 'A' && *s <= 'Z' ? *s + ('a' - 'A') : *s;
+		}
+		return true;
+	}
+}
+
 Case_folder::Case_folder()
 {
-	status = U_ZERO_ERROR;
-	conv = ucnv_open("utf-8",&status);
-	if( ! U_SUCCESS(status)) 
-		throw runtime_error("ucnv_open failed");
+	UErrorCode status = U_ZERO_ERROR;
+	csm = ucasemap_open("", U_FOLD_CASE_DEFAULT, &status);
+	if( ! U_SUCCESS(status))
+		throw runtime_error(fs("ucasemap_open failed: " << u_errorName(status)));
 }
 
 
 Case_folder::~Case_folder()
 {
-	if( conv )  {
-		ucnv_close(conv);
-		conv = 0;
-	}	
+	if( csm )  {
+		ucasemap_close(csm);
+		csm = 0;
+	}
 }
 
 
-std::string Case_folder::fold_case_utf8(const std::string& in)
+size_t Case_folder::fold(const char* s, size_t len, char* dest, size_t capacity)
 {
-	std::string out;
-	const char* src = in.data();
-	const char* src_limit = in.data() + in.size();
-	size_t done=0;
-	std::vector<UChar> u_buff(in.size());
-	std::vector<char> o_buff(in.size());
-
-	if(in.empty()) {
-		out.clear();
-		return out;
-	}	
-
-	do {
-		status = U_ZERO_ERROR;
-		UChar* target = &u_buff[done];
-		UChar* targetlimit = &u_buff[u_buff.size()];
-		ucnv_toUnicode(conv,&target,targetlimit, &src, src_limit, NULL, TRUE, &status);
-		done += target - &u_buff[done]; 
-		if( status == U_BUFFER_OVERFLOW_ERROR) {
-			u_buff.resize(((u_buff.size()+1))*2);
-			D(cout << "Need to resize to: " << u_buff.size() << endl;)
-		} else if(! U_SUCCESS(status)) {
-			throw unicode_wrap::unicode_error(u_errorName(status));
-		}
-	} while(! U_SUCCESS(status));	
-	u_buff.resize(done);
-
-
-	status = U_ZERO_ERROR;
-	vector<UChar> folded_str(u_buff.size() * 1.2);
-	while(true) {
-		int32_t len = u_strFoldCase(&folded_str[0], folded_str.size(), &u_buff[0], u_buff.size(), U_FOLD_CASE_DEFAULT, &status);
-		if (  (unsigned) len > folded_str.size() && status == U_BUFFER_OVERFLOW_ERROR )
-				folded_str.resize(len);	
-		else if( U_SUCCESS(status) ) {
-			folded_str.resize(len);
-			break;
-		} else {
-			throw std::runtime_error(fs("u_strFoldCase error:" << u_errorName(status)));
-		}	
+	// ASCII folds to the same length, so there's room in dest if it's all ASCII
+	if( len <= capacity && fold_ascii(s, len, dest) )
+		return len;
+
+	UErrorCode status = U_ZERO_ERROR;
+	int32_t res = ucasemap_utf8FoldCase(csm, dest, capacity, s, len, &status);
+	if( status == U_BUFFER_OVERFLOW_ERROR )
+		return res;
+	if( ! U_SUCCESS(status) )
+		throw unicode_wrap::unicode_error(fs("ucasemap_utf8FoldCase error:" << u_errorName(status)));
+	return res;
+}
+
+
+size_t Case_folder::fold(const char* s, size_t len, string& out)
+{
+	const size_t done = out.size();
+	// folding seldom makes text longer, and then by a few bytes
+	out.resize(done + len + 16);
+	size_t res = fold(s, len, &out[done], out.size() - done);
+	if( res > out.size() - done ) {
+		out.resize(done + res);
+		res = fold(s, len, &out[done], res);
 	}
+	out.resize(done + res);
+	return res;
+}
 
-	//const UChar* usource = &u_buff[0];
-	//const UChar* usourcelimit = &u_buff[done];
-
-	const UChar* usource = &folded_str[0];
-	const UChar* usourcelimit = &folded_str[0] + folded_str.size();
-	char* otarget = 0;
-	char* otargetlimit = 0;
-	size_t total=0;
-	do {
-		status = U_ZERO_ERROR;
-		D(cout << "usource: "<< (void*) usource << endl;)
-		D(cout << "usourcelimit: "<<(void*) usourcelimit << endl;)
-		otarget = &o_buff[total];
-		otargetlimit = &o_buff[o_buff.size()];
-		/********/
-		//cout << "ucnv_fromUnicode(" << (void*) otarget <<","<<(void*)otargetlimit<<","<<(void*)usource <<","<<(void*)usourcelimit<<");" << endl;
-		ucnv_fromUnicode(conv, &otarget, otargetlimit, &usource, usourcelimit, NULL, TRUE, &status);
-		total += otarget - &o_buff[total];
-		//cout << "usource: "<< (void*) usource << endl;
-		//cout << "otarget: " << (void*) otarget << endl;
-		/********/
-		//cout.write((char*)&o_buff[0],o_buff.size());
-		//if(total > 32)
-			//cout << makeHexDump(string((char*)&o_buff[total-32],32)) << endl;
-		//cout << makeHexDump(string((char*)otarget,(size_t)(&o_buff[o_buff.size()]-otarget)) << endl;
-		if(U_SUCCESS(status))
-			break;
-		else if(status == U_BUFFER_OVERFLOW_ERROR) {
-			o_buff.resize(((o_buff.size()+1))*2);
-			D(cout << "Need to resize to: " << o_buff.size() << endl;)
-			//cout << "resize: " << o_buff.size() << endl;
-		} else if(! U_SUCCESS(status)) {
-			throw unicode_wrap::unicode_error(u_errorName(status));
-		}
 
-	} while(status  == U_BUFFER_OVERFLOW_ERROR);	
-	out.assign(&o_buff[0],total);
+string Case_folder::fold_case_utf8(const string& in)
+{
+	string out;
+	fold(in.data(), in.size(), out);
 	return out;
 }
 
+
+void Case_folder::fold_tokens(const char* text, const Span* begin, const Span* end, string& arena, vector<Span>& out)
+{
+	arena.clear();
+	out.clear();
+	out.reserve(end - begin);
+	for(const Span* i = begin; i != end; ++i) {
+		Span folded;
+		folded.offset = arena.size();
+		folded.len = fold(text + i->offset, i->len, arena);
+		out.push_back(folded);
+	}
+}
+
 }; // end namespace features
 
 #ifdef EXPORT_PYTHON_INTERFACE
@@ -130,8 +128,8 @@ using namespace features;
 
 BOOST_PYTHON_MODULE_INIT(case_folder)
 {
-	class_<Case_folder>("Case_folder")
+	class_<Case_folder, boost::noncopyable>("Case_folder")
 		.def("fold_case_utf8", &Case_folder::fold_case_utf8)
-	;	
+	;
 }
 #endif
@@ -7,27 +7,63 @@
  */
 
 /**
- * @addtogroup FeatureExtraction 
+ * @addtogroup FeatureExtraction
  * @brief tools to convert text to features
  * @{
  */
 
-#ifndef case_folder_hh 
+#ifndef case_folder_hh
 #define case_folder_hh 1
 #include <string>
+#include <vector>
 #include <unicode/utypes.h>   /* Basic ICU data types */
-#include <unicode/ucnv.h>     /* C   Converter API    */
+#include <unicode/ucasemap.h>
 
 namespace features {
 
+/**
+ * @brief Case folding of UTF-8 text, as u_strFoldCase with the default options
+ * ASCII is lowercased a word at a time, anything else is folded by ICU straight from UTF-8.
+ */
 class Case_folder {
 public:
+	/// where a token is, in bytes, in the text it comes from or in the arena it's folded to
+	struct Span {
+		size_t offset;
+		size_t len;
+	};
+
 	Case_folder();
 	~Case_folder();
+
+	/// @return in, case folded
 	std::string fold_case_utf8(const std::string& in);
-private:	
-	UConverter* conv;
-	UErrorCode status;
+
+	/**
+	 * @brief fold s into dest, nothing is allocated
+	 * @return the length of the folded text, if it's more than capacity it didn't fit and
+	 * dest has to be ignored
+	 */
+	size_t fold(const char* s, size_t len, char* dest, size_t capacity);
+
+	/**
+	 * @brief append s, case folded, to out
+	 * @return the length appended
+	 */
+	size_t fold(const char* s, size_t len, std::string& out);
+
+	/**
+	 * @brief fold the tokens of text in [begin, end) one after another into arena
+	 * @param[out] out out[i] is where token begin + i is in the arena
+	 * The memory of both is kept between calls, so folding a stream of documents allocates
+	 * only while they grow.
+	 */
+	void fold_tokens(const char* text, const Span* begin, const Span* end, std::string& arena, std::vector<Span>& out);
+
+private:
+	UCaseMap* csm;
+	Case_folder(const Case_folder&);
+	Case_folder& operator=(const Case_folder&);
 };
 
 };
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+#include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdint.h>
+
+#include "Charset.hh"
+#include "Unicode_wrap.hh"
+#include "utils.hh"
+
+using namespace std;
+
+namespace charset {
+
+namespace {
+    /// UChars of the buffer between the two converters of to_utf8
+    const size_t PIVOT_SIZE = 4096;
+
+    bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+    }
+
+    bool ascii(const char* s, size_t len)
+    {
+        const char* end = s + len;
+        for (; end - s >= 8; s += 8) {
+            uint64_t w;
+            memcpy(&w, s, sizeof(w));
+            if (w & 0x8080808080808080ULL)
+                return false;
+        }
+        for (; s != end; ++s)
+            if (*s & 0x80)
+                return false;
+        return true;
+    }
+
+    /// @return true if the bytes below 0x80 are ASCII in conv, so ASCII text needs no conversion
+    bool ascii_compatible(UConverter* conv)
+    {
+        char probe[127];
+        for (size_t i = 0; i < sizeof(probe); ++i)
+            probe[i] = i + 1;
+        UChar u[sizeof(probe)];
+        UErrorCode status = U_ZERO_ERROR;
+        const int32_t n = ucnv_toUChars(conv, u, sizeof(probe), probe, sizeof(probe), &status);
+        if (U_FAILURE(status) || n != static_cast<int32_t>(sizeof(probe)))
+            return false;
+        for (size_t i = 0; i < sizeof(probe); ++i)
+            if (u[i] != static_cast<UChar>(probe[i]))
+                return false;
+        return true;
+    }
+
+    UConverter* converter(const string& label)
+    {
+        try {
+            return label.empty() ? 0 : unicode_wrap::thread_converter(label);
+        } catch (unicode_wrap::unicode_error& e) {
+            return 0;
+        }
+    }
+
+    /// a label as it comes in headers and attributes, without spaces or quotes around
+    string clean(const string& label)
+    {
+        return boost::trim_copy_if(label, boost::is_any_of(" \t\r\n\f\"'"));
+    }
+
+    /// the value of charset= in the content of a meta http-equiv or a Content-Type
+    string from_content(const string& content)
+    {
+        const string lower = boost::to_lower_copy(content);
+        for (size_t i = lower.find("charset"); i != string::npos; i = lower.find("charset", i)) {
+            i += 7;
+            while (i < lower.size() && is_space(lower[i]))
+                ++i;
+            if (i == lower.size() || lower[i] != '=')
+                continue;
+            ++i;
+            while (i < lower.size() && is_space(lower[i]))
+                ++i;
+            const char quote = i < lower.size() && (lower[i] == '"' || lower[i] == '\'') ? lower[i++] : 0;
+            const size_t b = i;
+            while (i < lower.size() && lower[i] != quote && lower[i] != ';' && ! (! quote && is_space(lower[i])))
+                ++i;
+            return content.substr(b, i - b);
+        }
+        return string();
+    }
+
+    /**
+     * @brief read the attribute at p, moving past it
+     * @return false if there are no more in the tag
+     */
+    bool attribute(const char*& p, const char* end, string& name, string& value)
+    {
+        while (p != end && (is_space(*p) || *p == '/'))
+            ++p;
+        if (p == end || *p == '>')
+            return false;
+        const char* b = p;
+        while (p != end && *p != '=' && *p != '>' && *p != '/' && ! is_space(*p))
+            ++p;
+        name.assign(b, p);
+        boost::to_lower(name);
+        value.clear();
+        while (p != end && is_space(*p))
+            ++p;
+        if (p == end || *p != '=')
+            return true;
+        ++p;
+        while (p != end && is_space(*p))
+            ++p;
+        if (p != end && (*p == '"' || *p == '\'')) {
+            const char quote = *p++;
+            b = p;
+            while (p != end && *p != quote)
+                ++p;
+            value.assign(b, p);
+            if (p != end)
+                ++p;
+        } else {
+            b = p;
+            while (p != end && *p != '>' && ! is_space(*p))
+                ++p;
+            value.assign(b, p);
+        }
+        return true;
+    }
+
+    bool is_utf16_or_32(UConverter* conv)
+    {
+        switch (ucnv_getType(conv)) {
+            case UCNV_UTF16: case UCNV_UTF16_BigEndian: case UCNV_UTF16_LittleEndian:
+            case UCNV_UTF32: case UCNV_UTF32_BigEndian: case UCNV_UTF32_LittleEndian:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+string detect(const char* s, size_t len, const string& http_charset, source_t& source, size_t& bom_len)
+{
+    bom_len = 0;
+    const char* bom = utils::unicode_BOM(reinterpret_cast<const uint8_t*>(s), len, &bom_len);
+    if (bom) {
+        source = SOURCE_BOM;
+        return bom;
+    }
+
+    string label = clean(http_charset);
+    if (converter(label)) {
+        source = SOURCE_HTTP;
+        return label;
+    }
+
+    label = clean(prescan(s, len));
+    UConverter* conv = converter(label);
+    if (conv) {
+        source = SOURCE_META;
+        // it was read as ASCII, so it's not what it says
+        return is_utf16_or_32(conv) ? "UTF-8" : label;
+    }
+
+    source = SOURCE_GUESS;
+    if (valid_utf8(s, len))
+        return "UTF-8";
+    if (utils::looks_latin1(reinterpret_cast<const uint8_t*>(s), len))
+        return "ISO-8859-1";
+    return "windows-1252";
+}
+
+string prescan(const char* s, size_t len)
+{
+    const char* end = s + min(len, PRESCAN_BYTES);
+    string name;
+    string value;
+    for (const char* p = find(s, end, '<'); p != end; p = find(p, end, '<')) {
+        if (end - p >= 4 && ! strncmp(p, "<!--", 4)) {
+            static const char COMMENT_END[] = "-->";
+            p = search(p + 4, end, COMMENT_END, COMMENT_END + 3);
+            continue;
+        }
+        if (end - p < 6 || strncasecmp(p + 1, "meta", 4) || ! (is_space(p[5]) || p[5] == '/')) {
+            ++p;
+            continue;
+        }
+        p += 5;
+        string charset;
+        string content;
+        bool content_type = false;
+        while (attribute(p, end, name, value)) {
+            if (name == "charset")
+                charset = value;
+            else if (name == "content")
+                content = value;
+            else if (name == "http-equiv")
+                content_type = boost::iequals(value, "content-type");
+        }
+        if (! charset.empty())
+            return charset;
+        if (content_type) {
+            charset = from_content(content);
+            if (! charset.empty())
+                return charset;
+        }
+    }
+    return string();
+}
+
+bool valid_utf8(const char* s, size_t len)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(s);
+    const uint8_t* end = p + len;
+    while (p != end) {
+        if (end - p >= 8) {
+            uint64_t w;
+            memcpy(&w, p, sizeof(w));
+            if (! (w & 0x8080808080808080ULL)) {
+                p += 8;
+                continue;
+            }
+        }
+        if (*p < 0x80) {
+            ++p;
+            continue;
+        }
+        // the ranges of the second byte exclude overlongs, surrogates and past U+10FFFF
+        ptrdiff_t n;
+        uint8_t lo = 0x80;
+        uint8_t hi = 0xBF;
+        if (*p >= 0xC2 && *p <= 0xDF) {
+            n = 1;
+        } else if (*p == 0xE0) {
+            n = 2;
+            lo = 0xA0;
+        } else if (*p == 0xED) {
+            n = 2;
+            hi = 0x9F;
+        } else if (*p >= 0xE1 && *p <= 0xEF) {
+            n = 2;
+        } else if (*p == 0xF0) {
+            n = 3;
+            lo = 0x90;
+        } else if (*p >= 0xF1 && *p <= 0xF3) {
+            n = 3;
+        } else if (*p == 0xF4) {
+            n = 3;
+            hi = 0x8F;
+        } else {
+            return false;
+        }
+        if (end - p <= n || p[1] < lo || p[1] > hi)
+            return false;
+        for (ptrdiff_t i = 2; i <= n; ++i)
+            if ((p[i] & 0xC0) != 0x80)
+                return false;
+        p += n + 1;
+    }
+    return true;
+}
+
+bool needs_conversion(const char* s, size_t len, const string& charset)
+{
+    UConverter* conv = unicode_wrap::thread_converter(charset);
+    if (ucnv_getType(conv) == UCNV_UTF8)
+        return ! valid_utf8(s, len);
+    return ! (ascii(s, len) && ascii_compatible(conv));
+}
+
+void to_utf8(const char* s, size_t len, const string& charset, string& out)
+{
+    UConverter* from = unicode_wrap::thread_converter(charset);
+    if (ucnv_getType(from) == UCNV_LATIN_1) {
+        unicode_wrap::latin1_to_utf8(s, len, out);
+        return;
+    }
+    UConverter* utf8 = unicode_wrap::thread_converter("UTF-8");
+    UChar pivot[PIVOT_SIZE];
+    UChar* pivot_source = pivot;
+    UChar* pivot_target = pivot;
+    const char* source = s;
+    const char* source_end = s + len;
+    const size_t done = out.size();
+    // a byte in gives at most a UChar, so it's converted in one go
+    out.resize(done + UCNV_GET_MAX_BYTES_FOR_STRING(len, ucnv_getMaxCharSize(utf8)));
+    UErrorCode status = U_ZERO_ERROR;
+    char* target = &out[0] + done;
+    ucnv_convertEx(utf8, from, &target, &out[0] + out.size(), &source, source_end,
+        pivot, &pivot_source, &pivot_target, pivot + PIVOT_SIZE, TRUE, TRUE, &status);
+    out.resize(target - &out[0]);
+    if (U_FAILURE(status))
+        throw unicode_wrap::unicode_error(string("ucnv_convertEx: ") + u_errorName(status));
+}
+
+}; // namespace charset
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup Unicode
+ * @{
+ */
+#pragma once
+
+#include <string>
+
+/**
+ * @brief Find out the charset of a document and convert it to UTF-8, before lexing it
+ *
+ * The charset is taken, in this order, from a byte order mark, the charset of the HTTP
+ * Content-Type header, a meta tag in the first bytes of the document, or else guessed from its
+ * bytes. Labels that ICU doesn't know are skipped.
+ */
+namespace charset {
+
+    /// where detect() found the charset
+    enum source_t {
+        SOURCE_BOM,
+        SOURCE_HTTP,
+        SOURCE_META,
+        SOURCE_GUESS
+    };
+
+    /// how many bytes of the document are searched for a meta charset
+    const size_t PRESCAN_BYTES = 1024;
+
+    /**
+     * @brief the charset of the document in s
+     * @param http_charset the charset of the HTTP headers, empty if there wasn't one
+     * @param[out] source where it was found
+     * @param[out] bom_len the length of the byte order mark, 0 if there isn't one
+     * @return a charset that ICU can open
+     */
+    std::string detect(const char* s, size_t len, const std::string& http_charset, source_t& source, size_t& bom_len);
+
+    /**
+     * @brief look for <meta charset=...> or <meta http-equiv="content-type" content="...; charset=...">
+     * in the first PRESCAN_BYTES of s
+     * @return the label, as written, or "" if there's none
+     */
+    std::string prescan(const char* s, size_t len);
+
+    /// @return true if s is well formed UTF-8, without overlongs, surrogates or code points past U+10FFFF
+    bool valid_utf8(const char* s, size_t len);
+
+    /**
+     * @brief whether s has to be converted to be read as UTF-8
+     * @return false if it's valid UTF-8 in a charset that is UTF-8 or a superset of ASCII that
+     * shares its bytes, like ASCII text in ISO-8859-1
+     */
+    bool needs_conversion(const char* s, size_t len, const std::string& charset);
+
+    /**
+     * @brief append s, in charset, to out as UTF-8
+     * It's converted in chunks through a fixed buffer, what can't be converted is replaced.
+     * @throw unicode_wrap::unicode_error if the charset is not known
+     */
+    void to_utf8(const char* s, size_t len, const std::string& charset, std::string& out);
+};
+
+/** @} */
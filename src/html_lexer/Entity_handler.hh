@@ -13,24 +13,42 @@
  * @{
  */
 #pragma once
+#include <cstddef>
 #include <string>
-#include <map>
 
+/**
+ * @brief Decodes character entity and numeric character references
+ *
+ * Named references are looked up in the HTML5 entity set, unknown ones are dropped. Decimal
+ * (&amp;#65;) and hex (&amp;#x41;) references out of the unicode range or to unassigned code points
+ * are dropped too. A '&amp;' that doesn't start a reference terminated by ';' is kept as is.
+ */
 class Entity_handler {
 public:
-	Entity_handler();
-
 	// Return utf8 representation of the given character entity
-	std::string char_entity(const std::string&);
-	std::string replace_all_entities(const std::string&);
-	std::string replace_char_entities(const std::string&);
-	std::string replace_dec_numchar_ref(const std::string&);
-	std::string replace_hex_numchar_ref(const std::string&);
-	std::string dec_numchar_ref(const std::string&);
-	std::string hex_numchar_ref(const std::string&);
+	std::string char_entity(const std::string&) const;
+
+	/**
+	 * Look up a named reference in a static table with a perfect hash, generated by
+	 * utils/gen_html_entities.py
+	 * @param name without '&amp;' and ';'
+	 * @param[out] utf8_len length of the result
+	 * @return the utf8 of the entity, not null terminated, 0 if there's none with that name
+	 */
+	static const char* find(const char* name, size_t len, size_t& utf8_len);
+
+	/// @return str with its references decoded
+	std::string replace_all_entities(const std::string& str);
+
+	/**
+	 * Append s with its references decoded to out, in one pass. Decoded text is not scanned
+	 * again, so "&amp;amp;#65;" gives "&amp;#65;"
+	 */
+	void decode(const char* s, size_t len, std::string& out) const;
 
-	typedef std::map<std::string,std::string> charent_t;
-	charent_t charent;
+private:
+	/// append the utf8 of code point c, nothing if it's not assigned
+	static void append_utf8(unsigned c, std::string& out);
 };
 
 /** @} */
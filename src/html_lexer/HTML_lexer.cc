@@ -1,14 +1,18 @@
+#include <cstring>
 #include <memory>
 #include <stdexcept>
 #include <functional>
 #include <boost/tokenizer.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/regex.hpp>
+#include <boost/thread/tss.hpp>
 
 
 #include "Url.hh"
 #include "utils.hh"
 #include "content_type.hh"
 #include "HTML_lexer.hh"
+#include "Charset.hh"
 
 
 using namespace std;
@@ -37,195 +41,184 @@ static const boost::regex CHARSET_RE("charset=("token"+)",boost::regex_constants
 
 HTML_lexer::HTML_lexer(std::istream* i, std::ostream* txtout, const std::string* base_url, std::ostream* lnkout, std::ostream* warnings, Analysis* analysis, bool get_text_if_body_tag_only) :
     yyFlexLexer(i,0),
-    stag_op(),
-    ctag_op(),
     tokens(),
+    arena(),
     normalize(true),
     did_word_break(false),
-    txtout(txtout),
+    streams(txtout, lnkout, warnings),
+    sink(&streams),
     base_url(),
-    lnkout(lnkout),
-    warnings(warnings),
     analysis(analysis),
     flags(),
     curlink(),
     entity_handler(),
-    get_text_if_body_tag_only(get_text_if_body_tag_only)
+    get_text_if_body_tag_only(get_text_if_body_tag_only),
+    input_buf(),
+    input(&input_buf),
+    scratch(),
+    warning_buf(),
+    utf8_buf()
+{
+    init(base_url);
+}
+
+HTML_lexer::HTML_lexer(Lex_sink* sink, const std::string* base_url, Analysis* analysis, bool get_text_if_body_tag_only) :
+    yyFlexLexer(0,0),
+    tokens(),
+    arena(),
+    normalize(true),
+    did_word_break(false),
+    streams(),
+    sink(sink),
+    base_url(),
+    analysis(analysis),
+    flags(),
+    curlink(),
+    entity_handler(),
+    get_text_if_body_tag_only(get_text_if_body_tag_only),
+    input_buf(),
+    input(&input_buf),
+    scratch(),
+    warning_buf(),
+    utf8_buf()
+{
+    init(base_url);
+}
+
+void HTML_lexer::init(const std::string* base_url)
 {
     if( base_url ) {
         this->base_url = *base_url;
         if( ! this->base_url.absolute() )
             throw runtime_error(fs("base_url: " << *base_url << " is not absolute" << endl));
+    } else {
+        this->base_url.clear();
     }
 
-    // tag ops
-    // boost::function<void()> fnb = boost::bind(&Test::f,this);
+    initial_state();
+    tokens.clear();
+    arena.clear();
+    did_word_break = false;
+    curlink.clear();
+    flags.reset();
     if (! get_text_if_body_tag_only)
         flags.set(FLAG_GET_TEXT);
+}
+
+HTML_lexer& HTML_lexer::reset(std::istream* i, std::ostream* txtout, const std::string* base_url, std::ostream* lnkout, std::ostream* warnings, Analysis* analysis, bool get_text_if_body_tag_only)
+{
+    switch_streams(i,NULL);
+    streams = Stream_sink(txtout, lnkout, warnings);
+    sink = &streams;
+    this->analysis = analysis;
+    this->get_text_if_body_tag_only = get_text_if_body_tag_only;
+    init(base_url);
+    return *this;
+}
+
+HTML_lexer& HTML_lexer::reset(Lex_sink* sink, const std::string* base_url, Analysis* analysis, bool get_text_if_body_tag_only)
+{
+    this->sink = sink;
+    this->analysis = analysis;
+    this->get_text_if_body_tag_only = get_text_if_body_tag_only;
+    init(base_url);
+    return *this;
+}
 
+int HTML_lexer::lex(const char* s, size_t len)
+{
+    tokens.clear();
+    arena.clear();
+    input_buf.assign(s, len);
+    input.clear();
+    // reuses the flex buffer, which reads from input through LexerInput
+    yyrestart(&input);
+    initial_state();
+    return yylex();
+}
+
+int HTML_lexer::lex(const char* s, size_t len, const std::string& http_charset, std::string& read_as)
+{
+    charset::source_t source;
+    size_t bom_len = 0;
+    read_as = charset::detect(s, len, http_charset, source, bom_len);
+    s += bom_len;
+    len -= bom_len;
+    if( ! charset::needs_conversion(s, len, read_as) )
+        return lex(s, len);
+    utf8_buf.clear();
+    charset::to_utf8(s, len, read_as, utf8_buf);
+    return lex(utf8_buf.data(), utf8_buf.size());
+}
+
+void HTML_lexer::data(const char* str, int len)
+{
+    // a pending token, like the end of a script, is processed first as it always was
+    if( ! tokens.empty() ) {
+        addtoken(SGML_DATA, str, len);
+        process();
+        return;
+    }
+    if( ! flags.test(FLAG_GET_TEXT) )
+        return;
 
-    stag_op.insert(make_pair("body",boost::bind(&HTML_lexer::op_body,this)));
-    stag_op.insert(make_pair("a",boost::bind(&HTML_lexer::op_a,this)));
-    stag_op.insert(make_pair("frame",boost::bind(&HTML_lexer::op_frame,this)));
-    stag_op.insert(make_pair("iframe",boost::bind(&HTML_lexer::op_frame,this)));
-    stag_op.insert(make_pair("script", boost::bind(&HTML_lexer::op_script,this)));
-    stag_op.insert(make_pair("style", boost::bind(&HTML_lexer::op_style,this)));
-
-    // close tag ops
-    ctag_op.insert(make_pair("body",boost::bind(&HTML_lexer::op_body_c,this)));
-    ctag_op.insert(make_pair("a",boost::bind(&HTML_lexer::op_a_c,this)));
-    ctag_op.insert(make_pair("frame",boost::bind(&HTML_lexer::op_frame_c,this)));
-    ctag_op.insert(make_pair("iframe",boost::bind(&HTML_lexer::op_frame_c,this)));
-    ctag_op.insert(make_pair("script", boost::bind(&HTML_lexer::op_script_c,this)));
-    ctag_op.insert(make_pair("style", boost::bind(&HTML_lexer::op_style_c,this)));
-
-
-    stag_op.insert(make_pair("link", boost::bind(&HTML_lexer::op_link,this)));
-    ctag_op.insert(make_pair("link", boost::bind(&HTML_lexer::op_link_c,this)));
-
-    // word breaks
-    stag_op.insert(make_pair("applet", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("applet", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("base", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("base", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("blockquote", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("blockquote", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("br", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("br", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("button", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("button", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("caption", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("caption", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("dd", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("dd", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("div", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("div", boost::bind(&HTML_lexer::word_break,this)));
-//    stag_op.insert(make_pair("span", boost::bind(&HTML_lexer::word_break,this)));
-//    ctag_op.insert(make_pair("span", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("dfn", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("dfn", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("dl", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("dl", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("dt", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("dt", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("fieldset", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("fieldset", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("form", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("form", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("h1", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("h1", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("head", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("head", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("hr", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("hr", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("img", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("img", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("input", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("input", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("li", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("li", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("map", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("map", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("menu", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("menu", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("meta", boost::bind(&HTML_lexer::op_meta,this)));
-    ctag_op.insert(make_pair("meta", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("noframes", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("noframes", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("object", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("object", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("ol", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("ol", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("optgroup", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("optgroup", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("option", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("option", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("p", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("p", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("param", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("param", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("pre", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("pre", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("q", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("q", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("samp", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("samp", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("select", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("select", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("table", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("table", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("tbody", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("tbody", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("td", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("td", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("textarea", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("textarea", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("tfoot", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("tfoot", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("th", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("th", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("thead", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("thead", boost::bind(&HTML_lexer::word_break,this)));
-//    stag_op.insert(make_pair("title", boost::bind(&HTML_lexer::word_break,this)));
-//    ctag_op.insert(make_pair("title", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("title", boost::bind(&HTML_lexer::op_title,this)));
-    ctag_op.insert(make_pair("title", boost::bind(&HTML_lexer::op_title_c,this)));
-
-    stag_op.insert(make_pair("tr", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("tr", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("tt", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("tt", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("ul", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("ul", boost::bind(&HTML_lexer::word_break,this)));
-    stag_op.insert(make_pair("xmp", boost::bind(&HTML_lexer::word_break,this)));
-    ctag_op.insert(make_pair("xmp", boost::bind(&HTML_lexer::word_break,this)));
+    const char* text = str;
+    size_t n = len;
+    if( memchr(str, '&', len) ) {
+        scratch.clear();
+        entity_handler.decode(str, len, scratch);
+        text = scratch.data();
+        n = scratch.size();
+    }
+    if( flags.test(FLAG_INLINK) )
+        link_text_add(text, n);
+    else
+        text_add(text, n);
 }
 
 void HTML_lexer::addtoken(SGML_tok_t toktype, const char* str, int len, bool case_insensitive)
 {
     Token t;
-    string tmp(str,len);
-    string s = entity_handler.replace_all_entities(tmp);
+    t.type = toktype;
+    t.offset = arena.size();
+    // most tokens have no references
+    if( memchr(str, '&', len) )
+        entity_handler.decode(str, len, arena);
+    else
+        arena.append(str, len);
+    t.len = arena.size() - t.offset;
     if( case_insensitive ) {
-        boost::to_lower(s);
-        t.type = toktype;
-        t.content = s;
-    } else {
-        t.type = toktype;
-        t.content = s;
+        boost::iterator_range<char*> r(&arena[0] + t.offset, &arena[0] + arena.size());
+        boost::to_lower(r);
     }
     tokens.push_back(t);
 }
 
-std::ostream& operator<<(std::ostream& os, const struct HTML_lexer::Token& t)
+std::ostream& HTML_lexer::print(std::ostream& os, const Token& t) const
 {
-    os << "type: " << HTML_lexer::sgml_tok_xlate(t.type) << endl
-        << "content: " << t.content;
+    os << "type: " << sgml_tok_xlate(t.type) << endl
+        << "content: " << text(t);
     return os;
 }
 
 
 void HTML_lexer::warn(const std::string& warning)
 {
-    if( warnings && warnings->good() ) {
-        (*warnings) << warning;
-    }
+    sink->warning(warning.data(), warning.size());
 }
 
 void HTML_lexer::warn(const char* warning)
 {
-    if( warnings && warnings->good() ) {
-        (*warnings) << warning;
-    }
+    sink->warning(warning, strlen(warning));
 }
 
 void HTML_lexer::warn(const char* warning, const char* str, int len)
 {
-    if( warnings && warnings->good() ) {
-        (*warnings) << warning << ": yytext: \"";
-        (*warnings).write(str, len);
-        (*warnings) << "\"" << endl;
-    }
+    warning_buf.assign(warning);
+    warning_buf.append(": yytext: \"");
+    warning_buf.append(str, len);
+    warning_buf.append("\"\n");
+    sink->warning(warning_buf.data(), warning_buf.size());
 
 
 //    ostringstream os(curdoc->warnings,ios::app);
@@ -241,13 +234,12 @@ void HTML_lexer::warn(const char* warning, const char* str, int len)
 }
 
 
-void HTML_lexer::text_add(const string& text)
+void HTML_lexer::text_add(const char* text, size_t len)
 {
     if( unlikely(flags.test(FLAG_GET_TITLE)) && analysis )
-        analysis->title += text;
+        analysis->title.append(text, len);
 
-    if( txtout && txtout->good() )
-        (*txtout) << text;
+    sink->text(text, len);
 
     did_word_break = false;
 }
@@ -256,8 +248,8 @@ void HTML_lexer::text_word_break()
 {
     //curdoc->words.resize(curdoc->words.size()+1);
     //curdoc->words.insert(curdoc->words.end(),string());
-    if( txtout && txtout->good() && ! did_word_break ) {
-        (*txtout) << endl;
+    if( ! did_word_break ) {
+        sink->word_break();
         did_word_break = true;
     }
 
@@ -296,11 +288,11 @@ void HTML_lexer::link_add(const string& link)
     //curlink.words.resize(1);
 }
 
-void HTML_lexer::link_text_add(const string& text)
+void HTML_lexer::link_text_add(const char* text, size_t len)
 {
     // add it to normal text
-    text_add(text);
-    curlink.txt.append(text);
+    text_add(text, len);
+    curlink.txt.append(text, len);
 //    if(curlink.words.empty())
 //        curlink.words.insert(curlink.words.end(),string());
 //    curlink.words.back().append(text);
@@ -320,8 +312,8 @@ void HTML_lexer::submit_link()
 {
     //curdoc->links.push_back(curlink);
     // FIXME
-    if( curlink && lnkout && lnkout->good() )
-        (*lnkout) << curlink;
+    if( curlink )
+        sink->link(curlink);
     curlink.clear();
 }
 
@@ -393,40 +385,34 @@ void HTML_lexer::op_meta()
 
 #if 0
     for(tokens_t::const_iterator i = tokens.begin(); i != tokens.end(); ++i) {
-        cout << toknames[i->type] << ": \"" << i->content << "\"" << endl;
+        cout << toknames[i->type] << ": \"" << text(*i) << "\"" << endl;
     }
 #endif
 
 
-    typedef map<string,string> tag_t;
-    tag_t tag;
-    tag_map(tokens, tag);
+    const Token* content = attribute("content");
+    if( ! content )
+        return;
     // robots
     {
-        tag_t::iterator name_i;
-        tag_t::iterator content_i;
-        if( (name_i = tag.find("name")) != tag.end() && iequals(name_i->second, "robots")
-            && (content_i = tag.find("content")) != tag.end() ) {
-
-            meta_name_robots(content_i->second);
-        }
+        const Token* name = attribute("name");
+        if( name && iequals(text(*name), "robots") )
+            meta_name_robots(copy_range<string>(text(*content)));
     }
     // http-equiv
     {
-        tag_t::iterator http_equiv_i;
-        tag_t::iterator content_i;
-        if( ((http_equiv_i = tag.find("http-equiv")) != tag.end() ) ) {
-            if( iequals(http_equiv_i->second, "content-type")
-                && (content_i = tag.find("content")) != tag.end()) {
-
-                smatch charset_m;
-                if ( regex_search(content_i->second, charset_m, CHARSET_RE) )
+        const Token* http_equiv = attribute("http-equiv");
+        if( http_equiv ) {
+            const text_t value = text(*content);
+            if( iequals(text(*http_equiv), "content-type") ) {
+
+                cmatch charset_m;
+                if ( regex_search(value.begin(), value.end(), charset_m, CHARSET_RE) )
                     analysis->charset = boost::trim_copy(charset_m[1].str());
 
-            } else if( iequals(http_equiv_i->second, "refresh")
-                && (content_i = tag.find("content")) != tag.end()) {
-                smatch m;
-                if ( regex_search(content_i->second, m, META_REFRESH_RE) ) {
+            } else if( iequals(text(*http_equiv), "refresh") ) {
+                cmatch m;
+                if ( regex_search(value.begin(), value.end(), m, META_REFRESH_RE) ) {
                     link_add(m[1].str());
                     submit_link();
                 }
@@ -461,19 +447,13 @@ void HTML_lexer::op_link()
         return;
 
     using namespace boost;
-    typedef map<string,string> tag_t;
-    tag_t tag;
-    tag_map(tokens, tag);
-    tag_t::iterator href_i;
-    if( (href_i = tag.find("href")) != tag.end() ) {
+    const Token* href_t = attribute("href");
+    if( href_t ) {
         // see if it looks like rss or atom
-        tag_t::iterator rel_i;
-        tag_t::iterator type_i;
-        //tag_t::iterator title_i;
-        if( ((rel_i = tag.find("rel")) != tag.end() && iequals(rel_i->second,"alternate"))
-            && ((type_i = tag.find("type")) != tag.end())
-        ) {
-            string href = href_i->second;
+        const Token* rel = attribute("rel");
+        const Token* type = attribute("type");
+        if( rel && iequals(text(*rel),"alternate") && type ) {
+            string href = copy_range<string>(text(*href_t));
             boost::trim(href);
             string href_cpy = href;
             if( base_url ) {
@@ -495,11 +475,11 @@ void HTML_lexer::op_link()
                     warn(fs("runtime_error exception (link rel): " << e.what() << " href: " << href << " base_url: " << base_url.get()));
                 }
             }
-            if (iequals(type_i->second,"application/rss+xml")) {
+            if (iequals(text(*type),"application/rss+xml")) {
                 analysis->rss2 = href;
-            } else if( iequals(type_i->second,"application/atom+xml")) {
+            } else if( iequals(text(*type),"application/atom+xml")) {
                 analysis->atom = href;
-            } else if(iequals(type_i->second,"text/xml")) {
+            } else if(iequals(text(*type),"text/xml")) {
                 analysis->rss = href;
             }
         }
@@ -517,29 +497,27 @@ void HTML_lexer::op_a()
         return;
 
     for(tokens_t::const_iterator i = tokens.begin(); i != tokens.end(); ++i) { // look for href
-        if( i->type == SGML_ATTRNAME && i->content.compare(0,4,"href",0,4) == 0 && (i+1) != tokens.end() && (i+1)->type == SGML_LITERAL ){
-            //cout << "link add: |" << (i+1)->content <<"|"<< endl;
-            link_add((i+1)->content);
+        if( i->type == SGML_ATTRNAME && boost::starts_with(text(*i), "href") && (i+1) != tokens.end() && (i+1)->type == SGML_LITERAL ){
+            //cout << "link add: |" << text(*(i+1)) <<"|"<< endl;
+            link_add(boost::copy_range<string>(text(*(i+1))));
             flags[FLAG_INLINK] = true;
-        } else if(i->type == SGML_ATTRNAME && i->content.compare(0,4,"href",0,4) == 0 && (i+1) == tokens.end()) {
+        } else if(i->type == SGML_ATTRNAME && boost::starts_with(text(*i), "href") && (i+1) == tokens.end()) {
             cerr << "empty href=" << " yyin: " << yyin->tellg() << endl;
             cerr << "token stack: " << endl;
             for(tokens_t::const_iterator j = tokens.begin(); j != tokens.end(); ++j) {
-                cerr <<  (*j) << endl;
+                print(cerr, *j) << endl;
             }
             cerr << endl;
             //throw runtime_error("OMG");
             //
-        } else if( i->type == SGML_ATTRNAME && i->content.compare(0,3,"rel") == 0 && (i+1) != tokens.end() && (i+1)->type == SGML_LITERAL ){
-            string content = (i+1)->content;
-            typedef boost::tokenizer<boost::char_separator<char> > tokenizer;
+        } else if( i->type == SGML_ATTRNAME && boost::starts_with(text(*i), "rel") && (i+1) != tokens.end() && (i+1)->type == SGML_LITERAL ){
+            const text_t content = text(*(i+1));
+            typedef boost::tokenizer<boost::char_separator<char>, const char*> tokenizer;
             boost::char_separator<char> sep("\" ");
-            tokenizer tokens(content,sep);
+            tokenizer tokens(content.begin(), content.end(), sep);
             for (tokenizer::iterator j=tokens.begin(); j != tokens.end(); ++j) {
                 //cout << "rel: " << *j << " " << curlink.url << endl;
-                string tok = *j;
-                boost::to_lower(tok);
-                if( tok == "nofollow" ) {
+                if( boost::iequals(*j, "nofollow") ) {
                     flags[FLAG_LINK_NOFOLLOW] = true;
                 }
                 // rss
@@ -570,18 +548,17 @@ void HTML_lexer::op_frame()
     if( ! flags.test(FLAG_GET_TEXT))
         return;
     for(tokens_t::const_iterator i = tokens.begin(); i != tokens.end(); ++i) { // look for href
-        if( i->type == SGML_ATTRNAME && i->content.compare(0,3,"src",0,3) == 0 &&  (i+1) != tokens.end() && (i+1)->type == SGML_LITERAL ){
-            //cout << "add link in frame: " << (i+1)->content << endl;
-            //cout << "link add: " << (i+1)->content << endl;
-            link_add((i+1)->content);
+        if( i->type == SGML_ATTRNAME && boost::starts_with(text(*i), "src") &&  (i+1) != tokens.end() && (i+1)->type == SGML_LITERAL ){
+            //cout << "add link in frame: " << text(*(i+1)) << endl;
+            link_add(boost::copy_range<string>(text(*(i+1))));
             flags[FLAG_INLINK] = true;
-        } else if(i->type == SGML_ATTRNAME && i->content.compare(0,3,"src",0,3) == 0 && (i+1) == tokens.end()) {
+        } else if(i->type == SGML_ATTRNAME && boost::starts_with(text(*i), "src") && (i+1) == tokens.end()) {
 
             //throw runtime_error("jeebus");
             cerr << "empty frame src=" << " yyin: " << yyin->tellg() << endl;
             cerr << "token stack: " << endl;
             for(tokens_t::const_iterator j = tokens.begin(); j != tokens.end(); ++j) {
-                cerr <<  (*j) << endl;
+                print(cerr, *j) << endl;
             }
             cerr << endl;
 
@@ -717,16 +694,65 @@ std::string HTML_lexer::sgml_tok_xlate(enum HTML_lexer::SGML_tok_t tok)
     }
 }
 
-void HTML_lexer::tag_map(tokens_t& tok, std::map<std::string, std::string>& m)
+const HTML_lexer::Token* HTML_lexer::attribute(const char* name) const
 {
-    m.clear();
-    for(tokens_t::const_iterator i = tok.begin(); i != tok.end(); ++i) {
-        if( i->type == SGML_ATTRNAME && (i+1) != tok.end() && (i+1)->type == SGML_LITERAL ) {
-            m[i->content] = (i+1)->content;
-        }
+    // the last one wins, as it did in the map
+    const Token* res = 0;
+    for(tokens_t::const_iterator i = tokens.begin(); i != tokens.end(); ++i) {
+        if( i->type == SGML_ATTRNAME && (i+1) != tokens.end() && (i+1)->type == SGML_LITERAL
+            && boost::equals(text(*i), name) )
+            res = &*(i+1);
+    }
+    return res;
+}
+
+/// the tags that separate words, with the same op on start and end
+#define WORD_BREAK_TAGS \
+    case TAG_APPLET: case TAG_BASE: case TAG_BLOCKQUOTE: case TAG_BR: case TAG_BUTTON: \
+    case TAG_CAPTION: case TAG_DD: case TAG_DIV: case TAG_DFN: case TAG_DL: case TAG_DT: \
+    case TAG_FIELDSET: case TAG_FORM: case TAG_H1: case TAG_HEAD: case TAG_HR: case TAG_IMG: \
+    case TAG_INPUT: case TAG_LI: case TAG_MAP: case TAG_MENU: case TAG_NOFRAMES: case TAG_OBJECT: \
+    case TAG_OL: case TAG_OPTGROUP: case TAG_OPTION: case TAG_P: case TAG_PARAM: case TAG_PRE: \
+    case TAG_Q: case TAG_SAMP: case TAG_SELECT: case TAG_TABLE: case TAG_TBODY: case TAG_TD: \
+    case TAG_TEXTAREA: case TAG_TFOOT: case TAG_TH: case TAG_THEAD: case TAG_TR: case TAG_TT: \
+    case TAG_UL: case TAG_XMP
+
+void HTML_lexer::start_tag(html_tag::tag_t tag)
+{
+    using namespace html_tag;
+    switch( tag ) {
+        case TAG_A: op_a(); break;
+        case TAG_BODY: op_body(); break;
+        case TAG_FRAME: case TAG_IFRAME: op_frame(); break;
+        case TAG_LINK: op_link(); break;
+        case TAG_META: op_meta(); break;
+        case TAG_SCRIPT: op_script(); break;
+        case TAG_STYLE: op_style(); break;
+        case TAG_TITLE: op_title(); break;
+        WORD_BREAK_TAGS: word_break(); break;
+        default: break;
+    }
+}
+
+void HTML_lexer::end_tag(html_tag::tag_t tag)
+{
+    using namespace html_tag;
+    switch( tag ) {
+        case TAG_A: op_a_c(); break;
+        case TAG_BODY: op_body_c(); break;
+        case TAG_FRAME: case TAG_IFRAME: op_frame_c(); break;
+        case TAG_LINK: op_link_c(); break;
+        case TAG_META: word_break(); break;
+        case TAG_SCRIPT: op_script_c(); break;
+        case TAG_STYLE: op_style_c(); break;
+        case TAG_TITLE: op_title_c(); break;
+        WORD_BREAK_TAGS: word_break(); break;
+        default: break;
     }
 }
 
+#undef WORD_BREAK_TAGS
+
 void HTML_lexer::process()
 {
 
@@ -736,29 +762,23 @@ void HTML_lexer::process()
     D(cout << "************" << endl;
     cout << "Process: " << endl;
     for(tokens_t::const_iterator i = tokens.begin(); i != tokens.end(); ++i) {
-        cout << toknames[i->type] << ": \"" << i->content << "\"" << endl;
+        cout << toknames[i->type] << ": \"" << text(*i) << "\"" << endl;
     }
     cout << endl;);
 
 
-    Token cur = tokens.front();
-    if(cur.type == SGML_START ) {
-        tag_op_t::iterator i;
-        if( ( i = stag_op.find(cur.content)) != stag_op.end() )
-            i->second(); // exec function pointer associated with this tag start
-    }
-    if(cur.type == SGML_END) {
-        tag_op_t::iterator i;
-        if( ( i = ctag_op.find(cur.content)) != ctag_op.end() )
-            i->second();
-
-    }
+    const Token& cur = tokens.front();
+    const char* content = arena.data() + cur.offset;
+    if(cur.type == SGML_START )
+        start_tag(html_tag::lookup(content, cur.len));
+    if(cur.type == SGML_END)
+        end_tag(html_tag::lookup(content, cur.len));
     if(cur.type == SGML_DATA) {
         if( flags.test(FLAG_GET_TEXT) ) {
             if( flags.test(FLAG_INLINK) ) { // link text
-                link_text_add(cur.content);
+                link_text_add(content, cur.len);
             } else { // out of link text
-                text_add(cur.content);
+                text_add(content, cur.len);
             }
         }
     }
@@ -785,6 +805,7 @@ void HTML_lexer::process()
 */
 
     tokens.clear();
+    arena.clear();
 }
 
 /* void HTML_lexer::word_breaker() {
@@ -799,6 +820,22 @@ void HTML_lexer::finalize()
 }
 
 
+namespace {
+/// \\x01url\\x02text\\x03, without the control chars up to 0x08
+void append_link(string& out, const struct link& l)
+{
+    out.push_back('\x01');
+    for(string::const_iterator i = l.url.begin(); i != l.url.end(); ++i)
+        if( static_cast<unsigned char>(*i) > 0x08 )
+            out.push_back(*i);
+    out.push_back('\x02');
+    for(string::const_iterator i = l.txt.begin(); i != l.txt.end(); ++i)
+        if( static_cast<unsigned char>(*i) > 0x08 )
+            out.push_back(*i);
+    out.push_back('\x03');
+}
+}
+
 std::ostream& operator<<(std::ostream& os, const struct link& l)
 {
 //    string::size_type pos = string::npos;
@@ -819,37 +856,82 @@ std::ostream& operator<<(std::ostream& os, const struct link& l)
     b.as_list().push_back(t);
     os << b;
 #endif
-    os << '\x01';
-    for(string::const_iterator i = l.url.begin(); i != l.url.end(); ++i)
-        if( *i > 0x08 )
-            os << *i;
-    os << '\x02';
-    for(string::const_iterator i = l.txt.begin(); i != l.txt.end(); ++i)
-        if( *i > 0x08 )
-            os << *i;
-    os << '\x03';
+    string buf;
+    append_link(buf, l);
+    os << buf;
     return os;
 }
 
 
-ProcHTML html_lex(const std::string& html_in, const std::string& base_url)
+void Stream_sink::text(const char* s, size_t len)
+{
+    if( txtout && txtout->good() )
+        txtout->write(s, len);
+}
+
+void Stream_sink::word_break()
+{
+    if( txtout && txtout->good() )
+        (*txtout) << endl;
+}
+
+void Stream_sink::link(const struct link& l)
+{
+    if( lnkout && lnkout->good() )
+        (*lnkout) << l;
+}
+
+void Stream_sink::warning(const char* s, size_t len)
+{
+    if( warnings && warnings->good() )
+        warnings->write(s, len);
+}
+
+
+void ProcHTML_sink::text(const char* s, size_t len)
+{
+    result.text.append(s, len);
+}
+
+void ProcHTML_sink::word_break()
+{
+    result.text.push_back('\n');
+}
+
+void ProcHTML_sink::link(const struct link& l)
+{
+    append_link(result.links, l);
+}
+
+void ProcHTML_sink::warning(const char* s, size_t len)
+{
+    result.warnings.append(s, len);
+}
+
+
+ProcHTML html_lex(const std::string& html_in, const std::string& base_url, const std::string& http_charset)
 {
     ProcHTML result;
-    istringstream in(html_in);
-    ostringstream txt;
-    ostringstream lnk;
-    ostringstream warn;
+    ProcHTML_sink sink(result);
     const string* base = 0;
     if (!base_url.empty())
         base = &base_url;
 
-    HTML_lexer html_lexer(&in, &txt, base, &lnk, &warn, &result.analysis, false);
-    html_lexer.yylex();
-
+    string read_as;
+    thread_html_lexer().reset(&sink, base, &result.analysis, false).lex(html_in.data(), html_in.size(), http_charset, read_as);
     result.base_url = base_url;
-    result.text = txt.str();
-    result.links = lnk.str();
-    result.warnings = warn.str();
+    result.analysis.charset = read_as;
 
     return result;
 }
+
+namespace {
+boost::thread_specific_ptr<HTML_lexer> thread_lexer;
+}
+
+HTML_lexer& thread_html_lexer()
+{
+    if( ! thread_lexer.get() )
+        thread_lexer.reset(new HTML_lexer(static_cast<Lex_sink*>(0)));
+    return *thread_lexer;
+}
@@ -25,14 +25,11 @@
 #include <bitset>
 #include <stdexcept>
 
-#include <tr1/unordered_map>
-#include <boost/function.hpp>
-#include <boost/bind.hpp>
-
 #undef yyFlexLexer
 #include <FlexLexer.h>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/range/iterator_range.hpp>
 
 #include <unicode/utypes.h>   /* Basic ICU data types */
 #include <unicode/ucnv.h>     /* C   Converter API    */
@@ -42,6 +39,7 @@
 #include "Unicode_wrap.hh"
 #include "Case_folder.hh"
 #include "Entity_handler.hh"
+#include "Html_tag.hh"
 #include "utils.hh"
 #include "Url.hh"
 
@@ -77,6 +75,7 @@ public:
     std::string rss2;
     std::string rss;
     std::string atom;
+    /// the charset of the meta tags, html_lex sets the one the document was read as
     std::string charset;
     bool index;
     bool follow;
@@ -84,6 +83,51 @@ public:
 };
 
 
+/**
+ * @brief Receives what HTML_lexer finds, as it goes through the document
+ *
+ * The pointers passed are only valid during the call, they point into the lexer buffers.
+ */
+class Lex_sink {
+public:
+    virtual ~Lex_sink() {}
+
+    /// text of the document, with references decoded
+    virtual void text(const char* s, size_t len) = 0;
+
+    /// a break between words, like a block tag, not called twice in a row
+    virtual void word_break() = 0;
+
+    /// a link with its anchor text, absolute if the lexer has a base url
+    virtual void link(const struct link& l) = 0;
+
+    virtual void warning(const char* s, size_t len) { (void) s; (void) len; }
+};
+
+
+/**
+ * @brief Writes to streams, text with a newline for word breaks and links one after the other as
+ * \\x01url\\x02text\\x03, any of them can be null
+ */
+class Stream_sink : public Lex_sink {
+public:
+    Stream_sink(std::ostream* txtout = 0, std::ostream* lnkout = 0, std::ostream* warnings = 0) :
+        txtout(txtout),
+        lnkout(lnkout),
+        warnings(warnings)
+    {}
+
+    void text(const char* s, size_t len);
+    void word_break();
+    void link(const struct link& l);
+    void warning(const char* s, size_t len);
+
+    std::ostream* txtout;
+    std::ostream* lnkout;
+    std::ostream* warnings;
+};
+
+
 /**
  * @class HTML_lexer HTML_lexer.hh
  *
@@ -102,13 +146,17 @@ public:
  *
  * Tokens get pushed into a vector, then some instructions call HTML_lexer::process()
  *
- * Tokens have type of token (an enum), and contents
+ * Tokens have type of token (an enum), and the offset of their contents in an arena that is
+ * cleared along with them, so after the first tags lexing allocates nothing for tokens
  *
  * To process several streams with the same lexer object you can call the base class switch_streams member function. Or set_istream and set_doc
  *
  * lexer.switch_streams(static_cast<istream*>(&is),NULL);
  * lexer.yylex();
  * When yylex() is called, the doc that was passed is filled
+ *
+ * To lex a document in memory without copying the whole of it into a stream, construct it with a
+ * Lex_sink and call lex(const char*, size_t). flex still copies each chunk it reads into its buffer.
  */
 class HTML_lexer:public yyFlexLexer 
 {
@@ -130,12 +178,36 @@ public:
      */
     HTML_lexer(std::istream* in, std::ostream* txtout, const std::string* base_url=0, std::ostream* lnkout=0, std::ostream* warnings = 0, Analysis* analysis=0, bool get_text_if_body_tag_only=true);
 
-    /// Change input stream, etc.
+    /**
+     * @brief Constructor for lexing with lex()
+     * @param[out] sink receives text, links and warnings, it's not owned
+     */
+    explicit HTML_lexer(Lex_sink* sink, const std::string* base_url=0, Analysis* analysis=0, bool get_text_if_body_tag_only=true);
+
+    /**
+     * @brief Change input stream, etc. and forget the previous document
+     * Leaves the lexer as the constructor with the same arguments would, keeping the memory it
+     * allocated.
+     */
     HTML_lexer& reset(std::istream* i, std::ostream* txtout, const std::string* base_url=0, std::ostream* lnkout=0, std::ostream* warnings = 0,  Analysis* analysis=0, bool get_text_if_body_tag_only=true);
 
+    /// @brief As the other reset, for lexing with lex()
+    HTML_lexer& reset(Lex_sink* sink, const std::string* base_url=0, Analysis* analysis=0, bool get_text_if_body_tag_only=true);
+
     /// Process it @return 0 on success -1 on failure
     int yylex();
 
+    /// Process the document in s, which must stay valid until it returns @return as yylex
+    int lex(const char* s, size_t len);
+
+    /**
+     * @brief As lex(), for a document in any charset, which is converted to UTF-8 first unless
+     * it can be read as it is, @sa charset::detect
+     * @param http_charset the charset of the HTTP headers, empty if there wasn't one
+     * @param[out] read_as the charset the document was read as
+     */
+    int lex(const char* s, size_t len, const std::string& http_charset, std::string& read_as);
+
 protected:
     /// SGML types of token
     enum SGML_tok_t {
@@ -155,41 +227,45 @@ protected:
     void warn(const std::string& warning);
 
 
-    /// A token, tags, are subdivided in tokens
+    /// A token, tags, are subdivided in tokens, their text is kept in the arena
     struct Token {
         SGML_tok_t type;
-        std::string    content;
-        Token(): type(),content() {}
-        Token(SGML_tok_t t, std::string c): type(t), content(c) {}
+        /// offset and length of the text in arena
+        size_t offset;
+        size_t len;
     };
 
-    friend std::ostream& operator <<(std::ostream& os, const struct Token& t);
-
-
     typedef std::vector<struct Token> tokens_t;
-    typedef boost::function<void()> callback_t;
-    typedef std::tr1::unordered_map<std::string, callback_t> tag_op_t; 
+    typedef boost::iterator_range<const char*> text_t;
+
+    /// @return the text of t, valid until the next addtoken
+    text_t text(const Token& t) const { return text_t(arena.data() + t.offset, arena.data() + t.offset + t.len); }
+    /// @return the literal of the last attribute called name in the current tag, or 0
+    const Token* attribute(const char* name) const;
+    std::ostream& print(std::ostream& os, const Token& t) const;
 
     void link_add(const std::string& link);
-    void link_text_add(const std::string& text);
+    void link_text_add(const char* text, size_t len);
     void link_text_word_break();
     void submit_link();
 
-    void text_add(const std::string& text);
+    void text_add(const char* text, size_t len);
     void text_word_break();
 
     void finalize();
 
+    /// character data, passed on without making a token when nothing is pending
+    void data(const char* str, int len);
+
     void addtoken(SGML_tok_t toktype, const char* str, int len, bool case_insensitive=false);
     void process();
-
-    void tag_map(tokens_t& tok, std::map<std::string, std::string>& m);
-
-
-    tag_op_t stag_op;
-    tag_op_t ctag_op;
+    /// call the op of a start or end tag
+    void start_tag(html_tag::tag_t tag);
+    void end_tag(html_tag::tag_t tag);
 
     tokens_t tokens;
+    /// text of the tokens, cleared with them so that its capacity is reused
+    std::string arena;
     enum flag_t { 
         /**
          * if set text will be indexed
@@ -214,10 +290,10 @@ protected:
 private:
     bool normalize;
     bool did_word_break;
-    std::ostream* txtout;
+    /// output of the stream constructor
+    Stream_sink streams;
+    Lex_sink* sink;
     Url    base_url;
-    std::ostream* lnkout;
-    std::ostream* warnings;
     Analysis* analysis;        
     std::bitset<FLAGSIZE> flags;
     struct link curlink;
@@ -247,12 +323,30 @@ private:
     Entity_handler entity_handler;
     bool get_text_if_body_tag_only;
 
-};
+    /// lex() input, flex reads it in chunks into its own buffer
+    struct Memory_buf : public std::streambuf {
+        void assign(const char* s, size_t len) { char* p = const_cast<char*>(s); setg(p, p, p + len); }
+    };
+    Memory_buf input_buf;
+    std::istream input;
+    /// reused for decoding data
+    std::string scratch;
+    /// reused for formatting warnings
+    std::string warning_buf;
+    /// reused for documents converted to UTF-8
+    std::string utf8_buf;
+
+    /// sets the base url and clears the state of the document
+    void init(const std::string* base_url);
 
-/// @cond
-std::ostream& operator<<(std::ostream& os, const struct HTML_lexer::Token& t);
-/// @endcond
+    /**
+     * @brief BEGIN(INITIAL), defined in html.ll
+     * yyrestart() doesn't reset the start condition, it's left as it was if something threw
+     * out of yylex() before <<EOF>>.
+     */
+    void initial_state();
 
+};
 
 
 /**
@@ -278,30 +372,36 @@ public:
     Analysis analysis;
 };
 
+/// Fills a ProcHTML with the output of the lexer, in the format of Stream_sink
+class ProcHTML_sink : public Lex_sink {
+public:
+    explicit ProcHTML_sink(ProcHTML& result) : result(result) {}
+
+    void text(const char* s, size_t len);
+    void word_break();
+    void link(const struct link& l);
+    void warning(const char* s, size_t len);
+
+    ProcHTML& result;
+};
+
 /**
  * @brief Parse HTML document
- * @param html_in input HTML
+ * @param html_in input HTML, in any charset, @sa HTML_lexer::lex
  * @param base_url the base url needed for relative links in the HTML
- * @return ProcHTML result
+ * @param http_charset the charset of the HTTP headers, empty if there wasn't one
+ * @return ProcHTML result, with analysis.charset set to the charset the document was read as
  */
-ProcHTML html_lex(const std::string& html_in, const std::string& base_url);
+ProcHTML html_lex(const std::string& html_in, const std::string& base_url, const std::string& http_charset = std::string());
 
+/**
+ * @brief The lexer of the calling thread, which html_lex uses for every document
+ * It's created on first use and destroyed with the thread, reset() it before each document.
+ */
+HTML_lexer& thread_html_lexer();
 
 
 
 
-inline HTML_lexer& HTML_lexer::reset(std::istream* i, std::ostream* txtout, const std::string* base_url, std::ostream* lnkout, std::ostream* warnings, Analysis* analysis, bool get_text_if_body_tag_only)
-{
-    switch_streams(i,NULL);
-    this->txtout = txtout;
-    if( base_url )
-        this->base_url = *base_url;
-    this->lnkout = lnkout;
-    this->warnings = warnings;
-    this->analysis = analysis;
-    this->get_text_if_body_tag_only = get_text_if_body_tag_only;
-
-    return *this;    
-}
 
 /** @} */
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+// boost first, the D() macro of utils.hh breaks its headers
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "Html_batch.hh"
+
+using namespace std;
+
+namespace html_batch {
+
+namespace {
+    /// fewer documents than this per thread aren't worth starting one
+    const size_t MIN_DOCS = 8;
+
+    /// hands out the indices of [0, n) one at a time
+    class Queue {
+    public:
+        explicit Queue(size_t n) : m_mutex(), m_next(0), m_n(n) {}
+
+        bool pop(size_t& i)
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            if (m_next == m_n)
+                return false;
+            i = m_next++;
+            return true;
+        }
+
+    private:
+        boost::mutex m_mutex;
+        size_t m_next;
+        const size_t m_n;
+    };
+
+    /// runs f(lexer, i) for the documents of the queue with the lexer of the thread
+    template<class F>
+    struct Worker {
+        Worker(Queue& queue, F f) : queue(queue), f(f) {}
+
+        void operator()() const
+        {
+            HTML_lexer& lexer = thread_html_lexer();
+            size_t i;
+            while (queue.pop(i))
+                f(lexer, i);
+        }
+
+        Queue& queue;
+        F f;
+    };
+
+    /// run f(lexer, i) for i in [0, n), in the calling thread and threads - 1 more
+    template<class F>
+    void for_each_doc(size_t n, size_t threads, F f)
+    {
+        if (! threads)
+            threads = max(boost::thread::hardware_concurrency(), 1u);
+        threads = min(threads, max<size_t>(n / MIN_DOCS, 1));
+
+        Queue queue(n);
+        Worker<F> worker(queue, f);
+        boost::thread_group group;
+        for (size_t t = 1; t < threads; ++t)
+            group.create_thread(worker);
+        worker();
+        group.join_all();
+    }
+
+    const string* base_url(const Doc& doc)
+    {
+        return doc.base_url->empty() ? 0 : doc.base_url;
+    }
+
+    /// @return the charset the document was read as
+    string lex_doc(HTML_lexer& lexer, const Doc& doc)
+    {
+        static const string NONE;
+        string read_as;
+        lexer.lex(doc.html, doc.len, doc.http_charset ? *doc.http_charset : NONE, read_as);
+        return read_as;
+    }
+
+    struct To_sink {
+        To_sink(const Doc* docs, Sink& sink) : docs(docs), sink(sink) {}
+
+        void operator()(HTML_lexer& lexer, size_t i) const
+        {
+            Lex_sink* s = sink.sink(i);
+            Analysis* analysis = sink.analysis(i);
+            try {
+                const string read_as = lex_doc(lexer.reset(s, base_url(docs[i]), analysis, false), docs[i]);
+                if (analysis)
+                    analysis->charset = read_as;
+            } catch (runtime_error& e) {
+                s->warning(e.what(), strlen(e.what()));
+            }
+        }
+
+        const Doc* docs;
+        Sink& sink;
+    };
+
+    struct To_proc_html {
+        To_proc_html(const vector<Doc>& docs, vector<ProcHTML>& out) : docs(docs), out(out) {}
+
+        void operator()(HTML_lexer& lexer, size_t i) const
+        {
+            ProcHTML& result = out[i];
+            ProcHTML_sink sink(result);
+            try {
+                result.analysis.charset = lex_doc(lexer.reset(&sink, base_url(docs[i]), &result.analysis, false), docs[i]);
+            } catch (runtime_error& e) {
+                result.warnings.append(e.what());
+            }
+            result.base_url = *docs[i].base_url;
+        }
+
+        const vector<Doc>& docs;
+        vector<ProcHTML>& out;
+    };
+}
+
+void lex(const Doc* begin, const Doc* end, Sink& sink, size_t threads)
+{
+    for_each_doc(end - begin, threads, To_sink(begin, sink));
+}
+
+void lex(const vector<Doc>& docs, vector<ProcHTML>& out, size_t threads)
+{
+    out.clear();
+    out.resize(docs.size());
+    for_each_doc(docs.size(), threads, To_proc_html(docs, out));
+}
+
+}; // namespace html_batch
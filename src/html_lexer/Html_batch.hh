@@ -0,0 +1,69 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup LexicalAnalysis
+ * @{
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "HTML_lexer.hh"
+
+/**
+ * @brief Lex many documents in one call
+ *
+ * As url_batch, meant for the python bindings: nothing here touches python objects so the GIL
+ * can be released for the whole batch, and the documents are spread among threads, each one
+ * lexing with its own lexer. Documents are handed out one at a time as they vary a lot in size.
+ */
+namespace html_batch {
+
+    /// A document, the memory is the caller's and has to outlive the call
+    struct Doc {
+        Doc(const std::string& html, const std::string& base_url, const std::string* http_charset = 0) :
+            html(html.data()),
+            len(html.size()),
+            base_url(&base_url),
+            http_charset(http_charset)
+        {}
+        /// in any charset, @sa HTML_lexer::lex
+        const char* html;
+        size_t len;
+        /// the url of the document, to resolve relative links, empty to leave them as they are
+        const std::string* base_url;
+        /// the charset of the HTTP headers, or 0
+        const std::string* http_charset;
+    };
+
+    /// Receives the output of lex(), it's called from several threads at once
+    class Sink {
+    public:
+        virtual ~Sink() {}
+
+        /// @return the sink for document i, called once before lexing it, in the thread that lexes it
+        virtual Lex_sink* sink(size_t i) = 0;
+
+        /// @return where the analysis of the document goes, or 0, its charset is the one the document was read as
+        virtual Analysis* analysis(size_t) { return 0; }
+    };
+
+    /**
+     * @brief lex the documents in [begin, end), document begin + i goes to sink.sink(i)
+     * @param threads 0 uses one per core, small batches are lexed in the calling thread
+     * A base url that is not absolute is reported as a warning of its document, which is not lexed.
+     */
+    void lex(const Doc* begin, const Doc* end, Sink& sink, size_t threads = 1);
+
+    /// lex every document into out, in the same order, @sa lex for threads
+    void lex(const std::vector<Doc>& docs, std::vector<ProcHTML>& out, size_t threads = 1);
+};
+
+/** @} */
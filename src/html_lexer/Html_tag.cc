@@ -0,0 +1,40 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+#include "Html_tag.hh"
+#include "perfect_hash.hh"
+
+#include <cstring>
+#include <stdint.h>
+
+namespace {
+#include "html_tags.inc"
+
+const char* const NAMES[] = {
+    "",
+#define HTML_TAG(id, name) name,
+#include "html_tags.inc"
+#undef HTML_TAG
+};
+}
+
+namespace html_tag {
+
+tag_t lookup(const char* name, size_t len)
+{
+    const tag_t tag = static_cast<tag_t>(TAG_SLOTS[perfect_hash::slot(TAG_DISPLACEMENTS, name, len)]);
+    const char* n = NAMES[tag];
+    return strlen(n) == len && memcmp(n, name, len) == 0 ? tag : TAG_UNKNOWN;
+}
+
+const char* name(tag_t tag)
+{
+    return tag < TAG_MAX ? NAMES[tag] : "";
+}
+
+};
@@ -0,0 +1,38 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup LexicalAnalysis
+ * @{
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/// Element names as an enum, the list is generated by utils/gen_html_tags.py
+namespace html_tag {
+
+enum tag_t {
+    TAG_UNKNOWN,
+#define HTML_TAG(id, name) TAG_##id,
+#include "html_tags.inc"
+#undef HTML_TAG
+    TAG_MAX
+};
+
+/// @return the tag with that lowercase name, TAG_UNKNOWN if it's not one we know
+tag_t lookup(const char* name, size_t len);
+inline tag_t lookup(const std::string& name) { return lookup(name.data(), name.size()); }
+
+/// @return the lowercase name of tag, "" for TAG_UNKNOWN
+const char* name(tag_t tag);
+
+};
+
+/** @} */
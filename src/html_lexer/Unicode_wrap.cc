@@ -6,13 +6,163 @@
  * code package.
  */
 
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
 #include "Unicode_wrap.hh"
 #include <cstring>
+#include <map>
+#include <stdint.h>
+#include "Charset.hh"
 #include "utils.hh" // DLOG
 using namespace std;
 
 namespace unicode_wrap {
 
+namespace {
+	/// UChars of the buffer between the two converters of Converter::convert
+	const size_t PIVOT_SIZE = 4096;
+
+	/**
+	 * @brief the name ICU knows charset by
+	 * ICU ignores case, '-' and '_' in labels, so this is what the converters are cached by,
+	 * otherwise every spelling of a label from a header would keep one open.
+	 * @throw unicode_error if the charset is not known
+	 */
+	string canonical(const string& charset)
+	{
+		UErrorCode status = U_ZERO_ERROR;
+		// ucnv_open would give the default converter for ""
+		const char* name = charset.empty() ? 0 : ucnv_getAlias(charset.c_str(), 0, &status);
+		if( ! name || ! U_SUCCESS(status) )
+			throw unicode_error("Can't open conversion: '" + charset + "' " + u_errorName(status));
+		return name;
+	}
+
+	/**
+	 * Converters opened once for the whole process by their canonical name. They are only
+	 * cloned, never used to convert, so threads don't share conversion state.
+	 */
+	class Converter_templates {
+		public:
+			Converter_templates() : convs(), mutex() {}
+			~Converter_templates()
+			{
+				for(map<string, UConverter*>::iterator i = convs.begin(); i != convs.end(); ++i)
+					ucnv_close(i->second);
+			}
+
+			/// @param name as given by canonical()
+			UConverter* clone(const string& name)
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				map<string, UConverter*>::iterator i = convs.find(name);
+				UErrorCode status = U_ZERO_ERROR;
+				if( i == convs.end() ) {
+					UConverter* conv = ucnv_open(name.c_str(), &status);
+					if( ! conv || ! U_SUCCESS(status) ) {
+						if( conv )
+							ucnv_close(conv);
+						throw unicode_error("Can't open conversion: '" + name + "' " + u_errorName(status));
+					}
+					i = convs.insert(make_pair(name, conv)).first;
+				}
+#if U_ICU_VERSION_MAJOR_NUM >= 71
+				UConverter* conv = ucnv_clone(i->second, &status);
+#else
+				// with no buffer ICU allocates the clone, which is not an error but a warning
+				int32_t size = U_CNV_SAFECLONE_BUFFERSIZE;
+				UConverter* conv = ucnv_safeClone(i->second, 0, &size, &status);
+#endif
+				if( ! conv || ! U_SUCCESS(status) )
+					throw unicode_error("ucnv_safeClone: '" + name + "' " + u_errorName(status));
+				return conv;
+			}
+
+		private:
+			map<string, UConverter*> convs;
+			boost::mutex mutex;
+			Converter_templates(const Converter_templates&);
+			Converter_templates& operator=(const Converter_templates&);
+	};
+
+	Converter_templates& templates()
+	{
+		static Converter_templates templates;
+		return templates;
+	}
+
+	/// converters of a thread by their canonical name
+	class Converter_cache {
+		public:
+			Converter_cache() : convs() {}
+			~Converter_cache()
+			{
+				for(map<string, UConverter*>::iterator i = convs.begin(); i != convs.end(); ++i)
+					ucnv_close(i->second);
+			}
+			map<string, UConverter*> convs;
+		private:
+			Converter_cache(const Converter_cache&);
+			Converter_cache& operator=(const Converter_cache&);
+	};
+
+	boost::thread_specific_ptr<Converter_cache> thread_convs;
+
+	bool ascii(const string& s)
+	{
+		const char* p = s.data();
+		const char* end = p + s.size();
+		for(; end - p >= 8; p += 8) {
+			uint64_t w;
+			memcpy(&w, p, sizeof(w));
+			if( w & 0x8080808080808080ULL )
+				return false;
+		}
+		for(; p != end; ++p)
+			if( *p & 0x80 )
+				return false;
+		return true;
+	}
+}
+
+UConverter* open_converter(const string& charset)
+{
+	return templates().clone(canonical(charset));
+}
+
+UConverter* thread_converter(const string& charset)
+{
+	if( ! thread_convs.get() )
+		thread_convs.reset(new Converter_cache);
+	map<string, UConverter*>& convs = thread_convs->convs;
+	const string name = canonical(charset);
+	map<string, UConverter*>::iterator i = convs.find(name);
+	if( i != convs.end() )
+		return i->second;
+
+	UConverter* conv = templates().clone(name);
+	convs[name] = conv;
+	return conv;
+}
+
+void latin1_to_utf8(const char* s, size_t len, string& out)
+{
+	size_t done = out.size();
+	out.resize(done + 2 * len);
+	char* o = &out[0] + done;
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(s);
+	const uint8_t* end = p + len;
+	for(; p != end; ++p) {
+		if( *p < 0x80 ) {
+			*o++ = *p;
+		} else {
+			*o++ = 0xC0 | (*p >> 6);
+			*o++ = 0x80 | (*p & 0x3F);
+		}
+	}
+	out.resize(o - &out[0]);
+}
+
 string cp2utf8(const UChar32 c)
 {
 	string result;
@@ -22,111 +172,72 @@ string cp2utf8(const UChar32 c)
 	vector<char> utf8;
 	UnicodeString s=c;
 	UErrorCode status = U_ZERO_ERROR;
-	UConverter* conv = ucnv_open("utf8", &status);
-	if( ! U_SUCCESS(status)) {
-		string err = "Can't open conversion to utf8 reason: ";
-		throw unicode_error(err + u_errorName(status));
-	}	
+	UConverter* conv = thread_converter("UTF-8");
+	ucnv_resetFromUnicode(conv);
 	utf8.resize(UCNV_GET_MAX_BYTES_FOR_STRING(s.length(),ucnv_getMaxCharSize(conv)));
 	int32_t size = ucnv_fromUChars(conv,&utf8[0],utf8.size(),s.getBuffer(),s.length(),&status);
-	if( U_SUCCESS(status) ) {
-		result.assign(&utf8[0],size);
-	} else {
+	if( ! U_SUCCESS(status) ) {
 		string err = "ucnv_fromUChars: ";
-		ucnv_close(conv);
 		throw unicode_error(err + u_errorName(status));
 	}
-	ucnv_close(conv);
+	result.assign(&utf8[0],size);
 	return result;
 }
 
-// FIXME
 void Converter::convert_unicode_to(const string& enc, const UnicodeString &s, vector<char>& res) 
 {
 	DLOG(cout << "Converter::convert_unicode_to(" << enc << ")" << endl;)
-	status = U_ZERO_ERROR;
-	if(in_conv) {
-		ucnv_close(in_conv);
-		in_conv=0;
-	}	
-	in_conv = my_ucnv_open(enc.c_str());
-	if( ! U_SUCCESS(status)) {
-		string err = "Can't open conversion to " + enc;
-		throw unicode_error(err + u_errorName(status));
-	}	
-	size_t need = UCNV_GET_MAX_BYTES_FOR_STRING(s.length(),ucnv_getMaxCharSize(in_conv));
-	DLOG(cout << "need:" << need << endl; )
-	res.resize(need);
-	int32_t size = ucnv_fromUChars(in_conv,&res[0],res.size(),s.getBuffer(),s.length(),&status);
+	UConverter* conv = thread_converter(enc);
+	UErrorCode status = U_ZERO_ERROR;
+	res.resize(UCNV_GET_MAX_BYTES_FOR_STRING(s.length(),ucnv_getMaxCharSize(conv)));
+	int32_t size = ucnv_fromUChars(conv,&res[0],res.size(),s.getBuffer(),s.length(),&status);
 	if( ! U_SUCCESS(status)) {
 		string err = "ucnv_fromUChars error: ";
 		throw unicode_error(err + u_errorName(status));
 	}	
 	res.resize(size);
-	ucnv_close(in_conv);
-	in_conv=0;
 }
 
 void Converter::convert_to_unicode(const string& in_encoding, const string& in_content, UnicodeString& str) {
 	DLOG(cout << "Converter::convert_to_unicode(" << in_encoding << "," << in_content << ")" << endl;)
-	DLOG(cout << "in_content_size: " << in_content.size() << endl;)
-	status = U_ZERO_ERROR;
-	if(in_conv) {
-		ucnv_close(in_conv);
-		in_conv=0;
-	}	
-	in_conv = my_ucnv_open(in_encoding.c_str());
-	DLOG(cout << "we need: " << UCNV_GET_MAX_BYTES_FOR_STRING(in_content.length(),ucnv_getMaxCharSize(in_conv)) << endl;)
-	const char* source = in_content.data();
-	const char* sourcelimit =  in_content.data() + in_content.size();
-	size_t done=0;
-	do {
+	UConverter* conv = thread_converter(in_encoding);
+	UErrorCode status = U_ZERO_ERROR;
+	// there are no more UChars than bytes but in a few stateful charsets, for those ICU says how many
+	int32_t capacity = in_content.size() + 1;
+	int32_t size = ucnv_toUChars(conv, str.getBuffer(capacity), capacity, in_content.data(), in_content.size(), &status);
+	str.releaseBuffer(U_SUCCESS(status) ? size : 0);
+	if( status == U_BUFFER_OVERFLOW_ERROR ) {
 		status = U_ZERO_ERROR;
-		UChar* target = &u_buff[done];
-		UChar* targetlimit = &u_buff[u_buff.size()];
-		ucnv_toUnicode(in_conv,&target,targetlimit, &source, sourcelimit, NULL, TRUE, &status);
-		done += target - &u_buff[done]; 
-		if( status == U_BUFFER_OVERFLOW_ERROR) {
-			u_buff.resize(((u_buff.size()+1))*2);
-			DLOG(cout << "Need to resize to: " << u_buff.size() << endl;)
-		} else {
-			if( ! U_SUCCESS(status)) 
-				throw unicode_error(u_errorName(status));
-		}		
-	} while(! U_SUCCESS(status));	
-	//cout << makeHexDump(string((char*)&u_buff[0],u_buff.size())) << endl;
-	//cout << "done: " << done;
-	memcpy(str.getBuffer(done),&u_buff[0],sizeof(UChar)*done);
-	str.releaseBuffer(done);
-	//printUnicodeString(str);
-	ucnv_close(in_conv);
-	in_conv=0;
+		capacity = size + 1;
+		size = ucnv_toUChars(conv, str.getBuffer(capacity), capacity, in_content.data(), in_content.size(), &status);
+		str.releaseBuffer(U_SUCCESS(status) ? size : 0);
+	}
+	if( ! U_SUCCESS(status) )
+		throw unicode_error(u_errorName(status));
 }
 
-// FIXME, think if this can leak or not
-//
 Converter::Converter(const string& in_encoding, const string& out_encoding) :
 	in_encoding(in_encoding),
 	out_encoding(out_encoding),
-	in_conv(my_ucnv_open(in_encoding.c_str())),
-	out_conv(my_ucnv_open(out_encoding.c_str())),
-	status(U_ZERO_ERROR),
-	u_buff(),
-	o_buff()
-{ }
+	in_conv(0),
+	out_conv(0)
+{
+	open(in_encoding, out_encoding);
+}
 
 Converter::Converter() :
 	in_encoding(),
 	out_encoding(),
 	in_conv(0),
-	out_conv(0),
-	status(U_ZERO_ERROR),
-	u_buff(),
-	o_buff()
-
+	out_conv(0)
 {}
 
 Converter::~Converter()
+{
+	close();
+}
+
+void Converter::close()
 {
 	if(out_conv) {
 		ucnv_close(out_conv);
@@ -140,91 +251,63 @@ Converter::~Converter()
 
 void Converter::open(const std::string& in_encoding, const std::string& out_encoding)
 {
+	close();
 	this->in_encoding = in_encoding;
 	this->out_encoding = out_encoding;
-	if(out_conv) {
-		ucnv_close(out_conv);
-		out_conv=0;
-	}	
-	if(in_conv)	{
-		ucnv_close(in_conv);
-		in_conv=0;
-	}	
-	in_conv = my_ucnv_open(in_encoding.c_str());
-	out_conv = my_ucnv_open(out_encoding.c_str());
+	in_conv = open_converter(in_encoding);
+	try {
+		out_conv = open_converter(out_encoding);
+	} catch(...) {
+		close();
+		throw;
+	}
 }
 
-UConverter* Converter::my_ucnv_open(const char* encoding)
+bool Converter::convert_direct(const string& in_content, string& out_content)
 {
-	status = U_ZERO_ERROR;
-	UConverter* cnv = ucnv_open(encoding, &status);
-	if( ! U_SUCCESS(status)) {
-		string err = "Can't open conversion: '";
-		err += encoding + '\'';
-		throw unicode_error(err + u_errorName(status));
+	if( ucnv_getType(out_conv) != UCNV_UTF8 )
+		return false;
+	switch( ucnv_getType(in_conv) ) {
+		case UCNV_UTF8:
+			if( ! charset::valid_utf8(in_content.data(), in_content.size()) )
+				return false;
+			out_content = in_content;
+			return true;
+		case UCNV_US_ASCII:
+			if( ! ascii(in_content) )
+				return false;
+			out_content = in_content;
+			return true;
+		case UCNV_LATIN_1:
+			out_content.clear();
+			latin1_to_utf8(in_content.data(), in_content.size(), out_content);
+			return true;
+		default:
+			return false;
 	}
-	return cnv;
 }
 
-
 void Converter::convert(const string& in_content, string& out_content) {
 	DLOG(cout << "Converter::convert(" << in_content << "," << out_content << ")" << endl;)
-	DLOG(cout << "u_buff.size():" << u_buff.size() << endl; )
-	const char* source = in_content.data();
-	const char* sourcelimit =  in_content.data() + in_content.size();
-	size_t done=0;
-	do {
-		status = U_ZERO_ERROR;
-		UChar* target = &u_buff[done];
-		UChar* targetlimit = &u_buff[u_buff.size()];
-		ucnv_toUnicode(in_conv,&target,targetlimit, &source, sourcelimit, NULL, TRUE, &status);
-		done += target - &u_buff[done]; 
-		if( status == U_BUFFER_OVERFLOW_ERROR) {
-			u_buff.resize(((u_buff.size()+1))*2);
-			DLOG(cout << "Need to resize to: " << u_buff.size() << endl;)
-		} else if(! U_SUCCESS(status)) {
-			throw unicode_error(u_errorName(status));
-	//	} else if( target != targetlimit ) {
-	//		cerr << hex << target << " != " << targetlimit << dec << endl;
-		}
-	} while(! U_SUCCESS(status));	
-	//cout << makeHexDump(string((char*)&u_buff[0],u_buff.size())) << endl;
-
-	const UChar* usource = &u_buff[0];
-	const UChar* usourcelimit = &u_buff[done];
-	char* otarget = 0;
-	char* otargetlimit = 0;
-	size_t total=0;
-//	vector<char> o_buff(ucnv_getMinCharSize(out_conv) * u_buff.size() * sizeof(UChar));
-	do {
-		status = U_ZERO_ERROR;
-		DLOG(cout << "usource: "<< (void*) usource << endl;)
-		DLOG(cout << "usourcelimit: "<<(void*) usourcelimit << endl;)
-		otarget = &o_buff[total];
-		otargetlimit = &o_buff[o_buff.size()];
-		/********/
-		//cout << "ucnv_fromUnicode(" << (void*) otarget <<","<<(void*)otargetlimit<<","<<(void*)usource <<","<<(void*)usourcelimit<<");" << endl;
-		ucnv_fromUnicode(out_conv, &otarget, otargetlimit, &usource, usourcelimit, NULL, TRUE, &status);
-		total += otarget - &o_buff[total];
-		//cout << "usource: "<< (void*) usource << endl;
-		//cout << "otarget: " << (void*) otarget << endl;
-		/********/
-		//cout.write((char*)&o_buff[0],o_buff.size());
-		//if(total > 32)
-			//cout << makeHexDump(string((char*)&o_buff[total-32],32)) << endl;
-		//cout << makeHexDump(string((char*)otarget,(size_t)(&o_buff[o_buff.size()]-otarget)) << endl;
-		if(U_SUCCESS(status))
-			break;
-		else if(status == U_BUFFER_OVERFLOW_ERROR) {
-			o_buff.resize(((o_buff.size()+1))*2);
-			DLOG(cout << "Need to resize to: " << o_buff.size() << endl;)
-			//cout << "resize: " << o_buff.size() << endl;
-		} else if(! U_SUCCESS(status)) {
-			throw unicode_error(u_errorName(status));
-		}
+	if( convert_direct(in_content, out_content) )
+		return;
 
-	} while(status  == U_BUFFER_OVERFLOW_ERROR);	
-	out_content.assign(&o_buff[0],total);
+	ucnv_reset(in_conv);
+	ucnv_reset(out_conv);
+	UChar pivot[PIVOT_SIZE];
+	UChar* pivot_source = pivot;
+	UChar* pivot_target = pivot;
+	const char* source = in_content.data();
+	const char* sourcelimit = in_content.data() + in_content.size();
+	// a byte in gives at most a UChar, so it's converted in one go
+	out_content.resize(UCNV_GET_MAX_BYTES_FOR_STRING(in_content.size(),ucnv_getMaxCharSize(out_conv)));
+	UErrorCode status = U_ZERO_ERROR;
+	char* target = &out_content[0];
+	ucnv_convertEx(out_conv, in_conv, &target, &out_content[0] + out_content.size(), &source, sourcelimit,
+		pivot, &pivot_source, &pivot_target, pivot + PIVOT_SIZE, TRUE, TRUE, &status);
+	out_content.resize(target - &out_content[0]);
+	if( ! U_SUCCESS(status) )
+		throw unicode_error(u_errorName(status));
 }
 
 }; // end namespace
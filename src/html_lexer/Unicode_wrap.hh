@@ -40,9 +40,29 @@ class unicode_error : public std::runtime_error {
  */
 std::string cp2utf8(const UChar32);
 
+/**
+ * @brief The converter of this thread for charset, opened on first use and kept until the thread exits
+ * Labels that ICU takes as the same charset, like "utf8" and "UTF-8", give the same converter.
+ * Not to be closed by the caller, it can be in any state, so ucnv_reset it before use.
+ * @throw unicode_error if the charset is not known
+ */
+UConverter* thread_converter(const std::string& charset);
+
+/**
+ * @brief A new converter for charset, cloned from one opened once for the whole process
+ * To be closed by the caller with ucnv_close.
+ * @throw unicode_error if the charset is not known
+ */
+UConverter* open_converter(const std::string& charset);
+
+/// append s, in ISO-8859-1, to out as UTF-8
+void latin1_to_utf8(const char* s, size_t len, std::string& out);
+
 
 /** 
  * @brief Wrapper class for text transcoding
+ * ASCII, UTF-8 and ISO-8859-1 to UTF-8 are converted directly, anything else in one pass
+ * through ICU. The converters come from open_converter.
  */
 class Converter {
 	public:
@@ -57,14 +77,13 @@ class Converter {
 		void convert_unicode_to(const std::string& enc, const UnicodeString &s, std::vector<char>& res);
 
 	private:
-		UConverter* my_ucnv_open(const char* encoding);
+		void close();
+		/// @return false if there's no shortcut from in_conv to out_conv for in_content
+		bool convert_direct(const std::string& in_content, std::string& out_content);
 		std::string in_encoding;
 		std::string out_encoding;
 		UConverter* in_conv;
 		UConverter* out_conv;
-		UErrorCode status;
-		std::vector<UChar> u_buff;
-		std::vector<char> o_buff;
 		Converter(const Converter&);	
 		Converter& operator=(const Converter&);	
 };
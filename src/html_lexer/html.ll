@@ -275,8 +275,7 @@ literal		({LIT}[^\"]*{LIT})|({LITA}[^\']*{LITA})
   /* abcd -- data characters */
   /* ([^<&]|(<[^<&a-zA-Z!->?])|(&[^<&#a-zA-Z]))+|.	{ */
 [^<]*|.	{ 
-		addtoken(SGML_DATA, yytext, yyleng);
-		process();
+		data(yytext, yyleng);
 	}
 
 <SCRIPT>[^<]*|.	{ 
@@ -489,3 +488,8 @@ literal		({LIT}[^\"]*{LIT})|({LITA}[^\']*{LITA})
 
 
 %%
+
+void HTML_lexer::initial_state()
+{
+	BEGIN(INITIAL);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2012 Pedro Larroy Tovar
+ *
+ * This file is subject to the terms and conditions
+ * defined in file 'LICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/**
+ * @addtogroup LexicalAnalysis
+ * @{
+ */
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * Lookup in the tables with a minimal perfect hash generated by utils/perfect_hash.py, which
+ * hashes the same way
+ */
+namespace perfect_hash {
+
+/// FNV-1a, seeded
+inline uint32_t fnv(const char* s, size_t len, uint32_t seed)
+{
+    uint32_t h = 0x811c9dc5 ^ seed;
+    for (size_t i = 0; i < len; ++i)
+        h = (h ^ static_cast<unsigned char>(s[i])) * 0x01000193;
+    return h;
+}
+
+/**
+ * @return the only slot where key can be, it still has to be compared as keys that are not in the
+ * table land on some slot too
+ */
+template<size_t N>
+inline size_t slot(const int16_t (&displacements)[N], const char* key, size_t len)
+{
+    const int32_t d = displacements[fnv(key, len, 0) % N];
+    return d < 0 ? -d - 1 : fnv(key, len, d) % N;
+}
+
+};
+
+/** @} */
@@ -0,0 +1,68 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include "Case_folder.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+BOOST_AUTO_TEST_CASE(Case_folder_fold)
+{
+    features::Case_folder folder;
+    const string tests[][2] = {
+        {"", ""},
+        {"Hello", "hello"},
+        {"@AZ[`az{ MIXED case, longer than a word 0123456789", "@az[`az{ mixed case, longer than a word 0123456789"},
+        {"CAF\xc3\x89 Stra\xc3\x9f" "e", "caf\xc3\xa9 strasse"},
+        {"\xce\xa3\xce\x9f\xce\xa6\xce\x99\xce\x91", "\xcf\x83\xce\xbf\xcf\x86\xce\xb9\xce\xb1"},
+        // short ASCII, then a long word that grows
+        {"ABCDEFGH\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f\xc3\x9f",
+            "abcdefghssssssssssssssssssssssssssssssssssss"},
+    };
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+        BOOST_CHECK_EQUAL(folder.fold_case_utf8(tests[i][0]), tests[i][1]);
+
+    // every ASCII byte as tolower
+    string ascii;
+    for (int c = 0; c < 0x80; ++c)
+        ascii += static_cast<char>(c);
+    string lower = ascii;
+    for (size_t i = 0; i < lower.size(); ++i)
+        lower[i] = tolower(lower[i]);
+    BOOST_CHECK_EQUAL(folder.fold_case_utf8(ascii), lower);
+
+    // into a buffer, too small says how much it needs
+    char buf[8];
+    BOOST_CHECK_EQUAL(folder.fold("ABC", 3, buf, sizeof(buf)), 3u);
+    BOOST_CHECK_EQUAL(string(buf, 3), "abc");
+    // U+0390 folds to three code points
+    BOOST_CHECK_EQUAL(folder.fold("A\xce\x90", 3, buf, 4), 7u);
+    BOOST_CHECK_EQUAL(folder.fold("A\xce\x90", 3, buf, sizeof(buf)), 7u);
+    BOOST_CHECK_EQUAL(string(buf, 7), "a\xce\xb9\xcc\x88\xcc\x81");
+    string out = "prefix";
+    BOOST_CHECK_EQUAL(folder.fold("\xce\x90\xce\x90\xce\x90\xce\x90\xce\x90\xce\x90\xce\x90\xce\x90\xce\x90", 18, out), 54u);
+    BOOST_CHECK_EQUAL(out.size(), 60u);
+}
+
+BOOST_AUTO_TEST_CASE(Case_folder_fold_tokens)
+{
+    features::Case_folder folder;
+    const string text = "The QUICK Stra\xc3\x9f" "e";
+    const features::Case_folder::Span tokens[] = {{0, 3}, {4, 5}, {10, 7}};
+    string arena = "stale";
+    vector<features::Case_folder::Span> out;
+    folder.fold_tokens(text.data(), tokens, tokens + 3, arena, out);
+    BOOST_REQUIRE_EQUAL(out.size(), 3u);
+    BOOST_CHECK_EQUAL(arena, "thequickstrasse");
+    BOOST_CHECK_EQUAL(arena.substr(out[1].offset, out[1].len), "quick");
+    BOOST_CHECK_EQUAL(arena.substr(out[2].offset, out[2].len), "strasse");
+
+    folder.fold_tokens(text.data(), tokens, tokens + 1, arena, out);
+    BOOST_CHECK_EQUAL(out.size(), 1u);
+    BOOST_CHECK_EQUAL(arena, "the");
+}
+/// @}
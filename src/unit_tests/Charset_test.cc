@@ -0,0 +1,124 @@
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <string>
+#include "Charset.hh"
+#include "Unicode_wrap.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+namespace {
+
+string detect(const string& doc, const string& http_charset, charset::source_t expected_source)
+{
+    charset::source_t source;
+    size_t bom_len = 0;
+    const string res = charset::detect(doc.data(), doc.size(), http_charset, source, bom_len);
+    BOOST_CHECK_EQUAL(source, expected_source);
+    return res;
+}
+
+string to_utf8(const string& in, const string& cs)
+{
+    string out;
+    charset::to_utf8(in.data(), in.size(), cs, out);
+    return out;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(Charset_detect)
+{
+    const string meta = "<html><head><meta charset=\"ISO-8859-15\"></head><body>text</body></html>";
+    // BOM, then http, then meta, then a guess
+    BOOST_CHECK_EQUAL(detect("\xef\xbb\xbf" + meta, "Shift_JIS", charset::SOURCE_BOM), "UTF-8");
+    BOOST_CHECK_EQUAL(detect(meta, " \"Shift_JIS\" ", charset::SOURCE_HTTP), "Shift_JIS");
+    BOOST_CHECK_EQUAL(detect(meta, "no-such-charset", charset::SOURCE_META), "ISO-8859-15");
+    BOOST_CHECK_EQUAL(detect("<p>caf\xc3\xa9</p>", "", charset::SOURCE_GUESS), "UTF-8");
+    BOOST_CHECK_EQUAL(detect("<p>caf\xe9</p>", "", charset::SOURCE_GUESS), "ISO-8859-1");
+    BOOST_CHECK_EQUAL(detect("<p>\x93quoted\x94</p>", "", charset::SOURCE_GUESS), "windows-1252");
+    // a meta that says UTF-16 was read as ASCII
+    BOOST_CHECK_EQUAL(detect("<meta charset=utf-16>", "", charset::SOURCE_META), "UTF-8");
+
+    charset::source_t source;
+    size_t bom_len = 0;
+    BOOST_CHECK_EQUAL(charset::detect("\xff\xfe\0\0x\0\0\0", 8, "", source, bom_len), "UTF-32LE");
+    BOOST_CHECK_EQUAL(bom_len, 4u);
+    BOOST_CHECK_EQUAL(charset::detect("\xff\xfex\0", 4, "", source, bom_len), "UTF-16LE");
+    BOOST_CHECK_EQUAL(bom_len, 2u);
+    BOOST_CHECK_EQUAL(charset::detect("\xfe\xff\0x", 4, "", source, bom_len), "UTF-16BE");
+}
+
+BOOST_AUTO_TEST_CASE(Charset_prescan)
+{
+    const string tests[][2] = {
+        {"<meta charset=utf-8>", "utf-8"},
+        {"<META CHARSET='koi8-r'/>", "koi8-r"},
+        {"<meta http-equiv=\"Content-Type\" content=\"text/html; charset=EUC-JP\">", "EUC-JP"},
+        {"<meta content='text/html;charset=\"gb2312\"' http-equiv=content-type>", "gb2312"},
+        {"<meta name=\"description\" content=\"charset=koi8-r\"><meta charset=big5>", "big5"},
+        {"<!-- <meta charset=koi8-r> --><meta charset=latin2>", "latin2"},
+        {"<metal charset=koi8-r>", ""},
+        {"<p>no meta</p>", ""},
+        {"<meta charset", ""},
+    };
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+        BOOST_CHECK_EQUAL(charset::prescan(tests[i][0].data(), tests[i][0].size()), tests[i][1]);
+
+    // only the first bytes are searched
+    const string late = string(charset::PRESCAN_BYTES, ' ') + "<meta charset=koi8-r>";
+    BOOST_CHECK_EQUAL(charset::prescan(late.data(), late.size()), "");
+}
+
+BOOST_AUTO_TEST_CASE(Charset_valid_utf8)
+{
+    const char* valid[] = {"", "ascii only, longer than a word", "caf\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf", "\xed\x9f\xbf"};
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); ++i)
+        BOOST_CHECK_MESSAGE(charset::valid_utf8(valid[i], strlen(valid[i])), valid[i]);
+    // stray continuation, overlongs, surrogate, past U+10FFFF, truncated
+    const char* invalid[] = {"\x80", "\xc0\xaf", "\xe0\x80\xaf", "\xf0\x80\x80\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80",
+        "\xf5\x80\x80\x80", "abcdefgh\xc3", "\xe2\x82", "\xe2\x28\xa1"};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+        BOOST_CHECK_MESSAGE(! charset::valid_utf8(invalid[i], strlen(invalid[i])), i);
+}
+
+BOOST_AUTO_TEST_CASE(Charset_to_utf8)
+{
+    BOOST_CHECK(! charset::needs_conversion("caf\xc3\xa9", 5, "utf-8"));
+    BOOST_CHECK(charset::needs_conversion("caf\xc3", 4, "utf-8"));
+    BOOST_CHECK(! charset::needs_conversion("plain", 5, "ISO-8859-1"));
+    BOOST_CHECK(! charset::needs_conversion("plain", 5, "windows-1252"));
+    BOOST_CHECK(charset::needs_conversion("caf\xe9", 4, "ISO-8859-1"));
+    BOOST_CHECK(charset::needs_conversion("plain", 5, "UTF-16LE"));
+
+    BOOST_CHECK_EQUAL(to_utf8("caf\xe9", "ISO-8859-1"), "caf\xc3\xa9");
+    BOOST_CHECK_EQUAL(to_utf8("\x80", "windows-1252"), "\xe2\x82\xac");
+    BOOST_CHECK_EQUAL(to_utf8("\x93\xfa\x96\x7b", "Shift_JIS"), "\xe6\x97\xa5\xe6\x9c\xac");
+    BOOST_CHECK_EQUAL(to_utf8(string("x\0\xac\x20", 4), "UTF-16LE"), "x\xe2\x82\xac");
+    // invalid UTF-8 is replaced
+    BOOST_CHECK_EQUAL(to_utf8("a\xc3z", "UTF-8"), "a\xef\xbf\xbdz");
+
+    // longer than the buffers, and appended
+    string big;
+    for (size_t i = 0; i < 100000; ++i)
+        big += "caf\xe9 ";
+    string out = "prefix";
+    charset::to_utf8(big.data(), big.size(), "ISO-8859-1", out);
+    BOOST_REQUIRE_EQUAL(out.size(), 6 + big.size() + 100000);
+    BOOST_CHECK_EQUAL(out.substr(0, 12), "prefixcaf\xc3\xa9 ");
+    BOOST_CHECK_EQUAL(out.substr(out.size() - 6), "caf\xc3\xa9 ");
+    // the most it can grow, three bytes out for each byte in
+    const string euros(200000, '\x80');
+    out.clear();
+    charset::to_utf8(euros.data(), euros.size(), "windows-1252", out);
+    BOOST_REQUIRE_EQUAL(out.size(), 3 * euros.size());
+    BOOST_CHECK_EQUAL(out.substr(out.size() - 3), "\xe2\x82\xac");
+
+    BOOST_CHECK_THROW(to_utf8("x", "no-such-charset"), unicode_wrap::unicode_error);
+    BOOST_CHECK_EQUAL(unicode_wrap::thread_converter("latin1"), unicode_wrap::thread_converter("latin1"));
+}
+/// @}
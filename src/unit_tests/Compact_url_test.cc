@@ -0,0 +1,67 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <utility>
+#include "Compact_url.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+namespace {
+
+void check_round_trip(const string& s)
+{
+    Url u(s);
+    Compact_url c(u);
+    u.normalize();
+    BOOST_CHECK_EQUAL(c.get(), u.get());
+    BOOST_CHECK_EQUAL(c.fingerprint(), u.fingerprint());
+
+    Url back = c.to_url();
+    BOOST_CHECK(back.normalized());
+    BOOST_CHECK_EQUAL(back.get(), u.get());
+    BOOST_CHECK_EQUAL(back.scheme(), u.scheme());
+    BOOST_CHECK_EQUAL(back.userinfo(), u.userinfo());
+    BOOST_CHECK_EQUAL(back.host(), u.host());
+    BOOST_CHECK_EQUAL(back.port(), u.port());
+    BOOST_CHECK_EQUAL(back.path(), u.path());
+    BOOST_CHECK_EQUAL(back.query(), u.query());
+    BOOST_CHECK_EQUAL(back.fragment(), u.fragment());
+    BOOST_CHECK(back == u);
+}
+
+} // end anon ns
+
+BOOST_AUTO_TEST_CASE(Compact_url_round_trip)
+{
+    check_round_trip("");
+    check_round_trip("http://a.com");
+    check_round_trip("HTTP://Us%65r@WwW.Ex%41mple.COM:8080/%7euser/./a/../b%2f?q=%7e%2a#%7e");
+    check_round_trip("http://[fe80::202:3fff:feb7:e652]:80/rabo/mo?q=a#f");
+    check_round_trip("http://u@[::1]/");
+    check_round_trip("file:///tmp/a/");
+    check_round_trip("//host/a//b/?#");
+    check_round_trip("relative/path?q");
+    check_round_trip("http://www.example.com/a/long/path/that/doesnt/fit/inline/index.html?with=query");
+}
+
+BOOST_AUTO_TEST_CASE(Compact_url_copy)
+{
+    Compact_url a(Url("http://www.example.com/a/long/path/that/doesnt/fit/inline/index.html"));
+    Compact_url b(Url("http://short.com/"));
+    Compact_url c(a);
+    BOOST_CHECK(c == a);
+    c = b;
+    BOOST_CHECK(c == b);
+    BOOST_CHECK(c != a);
+    Compact_url d(std::move(a));
+    BOOST_CHECK_EQUAL(d.host(), "www.example.com");
+    BOOST_CHECK(a.empty());
+    BOOST_CHECK(d.host_is("www.example.com"));
+    BOOST_CHECK(b.compare_host(d) < 0);
+    BOOST_CHECK_EQUAL(d.compare_host(d), 0);
+}
+/// @}
@@ -0,0 +1,148 @@
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <stdexcept>
+#include "Concurrency_controller.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+namespace {
+
+/// a sample where there's more work and bandwidth to spare
+Concurrency_controller::Sample room(size_t busy)
+{
+    Concurrency_controller::Sample s;
+    s.kBs = 100;
+    s.cpu = 10;
+    s.handle_kBs = 50;
+    s.busy = busy;
+    s.waiting = 10;
+    return s;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(Concurrency_controller_increase)
+{
+    Concurrency_controller c(4, 2, 8);
+    // nothing changes until it's enabled
+    BOOST_CHECK(! c.enabled());
+    BOOST_CHECK_EQUAL(c.update(room(4)), 4u);
+    c.enabled(true);
+
+    // additive increase while every handle is busy and there are urls waiting
+    BOOST_CHECK_EQUAL(c.update(room(4)), 5u);
+    c.step = 2;
+    BOOST_CHECK_EQUAL(c.update(room(5)), 7u);
+    // up to the maximum
+    BOOST_CHECK_EQUAL(c.update(room(7)), 8u);
+    BOOST_CHECK_EQUAL(c.update(room(8)), 8u);
+    c.step = 1;
+
+    // it holds if some handles are idle, nothing is waiting, the link is saturated or the setpoint is reached
+    c.active(5);
+    BOOST_CHECK_EQUAL(c.update(room(4)), 5u);
+    Concurrency_controller::Sample s = room(5);
+    s.waiting = 0;
+    BOOST_CHECK_EQUAL(c.update(s), 5u);
+    s = room(5);
+    s.handle_kBs = 0.5;
+    BOOST_CHECK_EQUAL(c.update(s), 5u);
+    c.target_kBs(100);
+    BOOST_CHECK_EQUAL(c.update(room(5)), 5u);
+    // and grows below it
+    s = room(5);
+    s.kBs = 99;
+    BOOST_CHECK_EQUAL(c.update(s), 6u);
+}
+
+BOOST_AUTO_TEST_CASE(Concurrency_controller_decrease)
+{
+    Concurrency_controller c(8, 2, 8);
+    c.enabled(true);
+    c.target_kBs(100);
+    c.max_cpu(90);
+
+    // multiplicative decrease on CPU
+    Concurrency_controller::Sample s = room(8);
+    s.cpu = 95;
+    BOOST_CHECK_EQUAL(c.update(s), 6u);
+    // it holds between the setpoint and the tolerance over it
+    s = room(6);
+    s.kBs = 105;
+    BOOST_CHECK_EQUAL(c.update(s), 6u);
+    // and backs off over it
+    s.kBs = 120;
+    BOOST_CHECK_EQUAL(c.update(s), 4u);
+    // down to the minimum
+    BOOST_CHECK_EQUAL(c.update(s), 3u);
+    BOOST_CHECK_EQUAL(c.update(s), 2u);
+    BOOST_CHECK_EQUAL(c.update(s), 2u);
+
+    // 0 disables the CPU check and the bandwidth setpoint
+    c.max_cpu(0);
+    c.target_kBs(0);
+    s.cpu = 400;
+    BOOST_CHECK_EQUAL(c.update(s), 3u);
+
+    // with a single handle the decrease rounds to 0, it stays at 1
+    Concurrency_controller one(1, 1, 4);
+    one.enabled(true);
+    s.cpu = 100;
+    one.max_cpu(90);
+    BOOST_CHECK_EQUAL(one.update(s), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(Concurrency_controller_clamp)
+{
+    Concurrency_controller c(20, 2, 8);
+    BOOST_CHECK_EQUAL(c.active(), 8u);
+    c.active(0);
+    BOOST_CHECK_EQUAL(c.active(), 2u);
+    c.active(5);
+    BOOST_CHECK_EQUAL(c.active(), 5u);
+
+    // a new range clamps the active handles
+    c.range(1, 3);
+    BOOST_CHECK_EQUAL(c.active(), 3u);
+    c.range(4, 10);
+    BOOST_CHECK_EQUAL(c.active(), 4u);
+    BOOST_CHECK_EQUAL(c.min_active(), 4u);
+    BOOST_CHECK_EQUAL(c.max_active(), 10u);
+
+    BOOST_CHECK_THROW(c.range(0, 10), invalid_argument);
+    BOOST_CHECK_THROW(c.range(5, 4), invalid_argument);
+    BOOST_CHECK_THROW(Concurrency_controller(4, 0, 8), invalid_argument);
+    // a bad range leaves it as it was
+    BOOST_CHECK_EQUAL(c.min_active(), 4u);
+    BOOST_CHECK_EQUAL(c.max_active(), 10u);
+}
+
+BOOST_AUTO_TEST_CASE(Concurrency_controller_override)
+{
+    // what the "parallel" console command does: disable the controller and set the handles
+    Concurrency_controller c(4, 1, 16);
+    c.enabled(true);
+    BOOST_CHECK_EQUAL(c.update(room(4)), 5u);
+    c.enabled(false);
+    c.active(12);
+    Concurrency_controller::Sample s = room(12);
+    BOOST_CHECK_EQUAL(c.update(s), 12u);
+    s.cpu = 400;
+    BOOST_CHECK_EQUAL(c.update(s), 12u);
+    c.active(100);
+    BOOST_CHECK_EQUAL(c.update(s), 16u);
+
+    // "autoscale on" takes over from the manual setting, here backing off because of the CPU
+    c.enabled(true);
+    BOOST_CHECK_EQUAL(c.update(s), 12u);
+
+    ostringstream os;
+    os << c;
+    BOOST_CHECK_EQUAL(os.str(), "active: 12 range: [1, 16] autoscale: on target: 0 KB/s max cpu: 90%");
+}
+/// @}
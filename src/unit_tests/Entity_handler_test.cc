@@ -0,0 +1,175 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/regex.hpp>
+
+#include <random>
+#include <sstream>
+#include <string>
+#include "Entity_handler.hh"
+#include "Unicode_wrap.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ *
+ * Differential test of the single pass entity decoder against the regex passes it replaced.
+ */
+using namespace std;
+
+namespace {
+
+const size_t ITERATIONS = 20000;
+
+string ref_numchar_ref(const string& digits, int base)
+{
+    string result;
+    try {
+        unsigned long num = stoul(digits, 0, base);
+        if (num <= UCHAR_MAX_VALUE)
+            result = unicode_wrap::cp2utf8(static_cast<UChar32>(num));
+    } catch (exception& e) {
+    }
+    return result;
+}
+
+/// one regex pass, replacing the first group of every match with f
+template<class F>
+string ref_replace(const string& str, const boost::regex& re, F f)
+{
+    string result;
+    boost::smatch m;
+    string::const_iterator from = str.begin();
+    while (regex_search(from, str.end(), m, re)) {
+        result.append(from, m[0].first);
+        result.append(f(string(m[1].first, m[1].second)));
+        from = m[0].second;
+    }
+    result.append(from, str.end());
+    return result;
+}
+
+/// the three passes Entity_handler::replace_all_entities used to do
+string ref_replace_all(Entity_handler& eh, const string& str)
+{
+    const boost::regex char_re("&([[:alpha:]_:][\\w._:-]*);", boost::regex_constants::perl);
+    const boost::regex dec_re("&#(\\d+);", boost::regex_constants::perl);
+    const boost::regex hex_re("&#x([[:xdigit:]]+);", boost::regex_constants::perl);
+    string result = ref_replace(str, char_re, [&](const string& s) { return eh.char_entity(s); });
+    result = ref_replace(result, dec_re, [](const string& s) { return ref_numchar_ref(s, 10); });
+    return ref_replace(result, hex_re, [](const string& s) { return ref_numchar_ref(s, 16); });
+}
+
+/**
+ * Tokens made of text and references. The regex passes decoded their own output, a piece that
+ * decodes to '&' could start a reference with what follows, so those are left out, and the
+ * pieces that are not references end in a space so that no reference spans two pieces.
+ */
+struct Fuzzer {
+    Fuzzer() : rng(1234) {}
+
+    size_t uniform(size_t n) { return rng() % n; }
+
+    unsigned code_point()
+    {
+        static const unsigned SAMPLES[] = {0, 9, 0x41, 0xa0, 0xd800, 0xdfff, 0xfffd, 0xfffe, 0x1f600, 0x10ffff, 0x110000};
+        unsigned c;
+        do
+            c = uniform(3) ? SAMPLES[uniform(sizeof(SAMPLES) / sizeof(SAMPLES[0]))] : uniform(0x30000);
+        while (c == '&');
+        return c;
+    }
+
+    string piece()
+    {
+        static const char* const TEXT[] = {"hello ", "a b ", "\xc3\xb1 ", "; ", "# ", "x41 ", "65 ", " "};
+        static const char* const NAMED[] = {"lt", "gt", "quot", "nbsp", "eacute", "Eacute", "euro", "QUOT", "COPY",
+            "hearts", "unknown", "x", "_a", ":b", "a.b-c_1", "Lt", "\xc3\xb1"};
+        static const char* const MALFORMED[] = {"& ", "&; ", "&# ", "&#; ", "&#x; ", "&#xg; ", "&#X41; ", "&#12a; ",
+            "&lt ", "&1; ", "&-a; ", "&&lt ", "&#x41 ", "&#65 "};
+        ostringstream os;
+        switch (uniform(6)) {
+            case 0:
+                os << TEXT[uniform(sizeof(TEXT) / sizeof(TEXT[0]))];
+                break;
+            case 1:
+                os << '&' << NAMED[uniform(sizeof(NAMED) / sizeof(NAMED[0]))] << ';';
+                break;
+            case 2:
+                os << "&#" << string(uniform(3), '0') << dec << code_point() << ';';
+                break;
+            case 3:
+                os << "&#x" << string(uniform(2), '0') << (uniform(2) ? uppercase : nouppercase) << hex << code_point() << ';';
+                break;
+            default:
+                os << MALFORMED[uniform(sizeof(MALFORMED) / sizeof(MALFORMED[0]))];
+                break;
+        }
+        return os.str();
+    }
+
+    string token()
+    {
+        string res;
+        for (size_t n = uniform(8); n; --n)
+            res += piece();
+        return res;
+    }
+
+    mt19937 rng;
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(Entity_handler_decode)
+{
+    Entity_handler eh;
+    BOOST_CHECK_EQUAL(eh.replace_all_entities(""), "");
+    BOOST_CHECK_EQUAL(eh.replace_all_entities("no references"), "no references");
+    BOOST_CHECK_EQUAL(eh.replace_all_entities("a &lt; b &amp;&amp; c"), "a < b && c");
+    BOOST_CHECK_EQUAL(eh.replace_all_entities("&#65;&#x42;&#x0043;&#0068;"), "ABCD");
+    BOOST_CHECK_EQUAL(eh.replace_all_entities("&eacute;&#233;&#xe9;"), "\xc3\xa9\xc3\xa9\xc3\xa9");
+    BOOST_CHECK_EQUAL(eh.replace_all_entities("&#x1F600;"), "\xf0\x9f\x98\x80");
+    // unknown, out of range and unassigned are dropped
+    BOOST_CHECK_EQUAL(eh.replace_all_entities("a&unknown;b&#x110000;c&#99999999999;d&#xfffe;e"), "abcde");
+    // surrogates are replaced
+    BOOST_CHECK_EQUAL(eh.replace_all_entities("&#xd800;"), "\xef\xbf\xbd");
+    // not references
+    BOOST_CHECK_EQUAL(eh.replace_all_entities("& &; &# &#; &#x; &lt &#X41; &"), "& &; &# &#; &#x; &lt &#X41; &");
+    // decoded text is not decoded again
+    BOOST_CHECK_EQUAL(eh.replace_all_entities("&amp;lt; &amp;#65; &#38;#65;"), "&lt; &#65; &#65;");
+
+    string out = "prefix ";
+    eh.decode("&gt;x", 5, out);
+    BOOST_CHECK_EQUAL(out, "prefix >x");
+}
+
+BOOST_AUTO_TEST_CASE(Entity_handler_html5)
+{
+    Entity_handler eh;
+    BOOST_CHECK_EQUAL(eh.char_entity("amp"), "&");
+    BOOST_CHECK_EQUAL(eh.char_entity("AMP"), "&");
+    BOOST_CHECK_EQUAL(eh.char_entity("CounterClockwiseContourIntegral"), "\xe2\x88\xb3");
+    // two code points
+    BOOST_CHECK_EQUAL(eh.char_entity("NotEqualTilde"), "\xe2\x89\x82\xcc\xb8");
+    BOOST_CHECK_EQUAL(eh.char_entity("lang"), "\xe2\x9f\xa8");
+    BOOST_CHECK_EQUAL(eh.char_entity("Amp"), "");
+    BOOST_CHECK_EQUAL(eh.char_entity("am"), "");
+    BOOST_CHECK_EQUAL(eh.char_entity("ampx"), "");
+    BOOST_CHECK_EQUAL(eh.char_entity(""), "");
+
+    size_t len = 0;
+    const char* utf8 = Entity_handler::find("nbsp", 4, len);
+    BOOST_REQUIRE(utf8);
+    BOOST_CHECK_EQUAL(string(utf8, len), "\xc2\xa0");
+    BOOST_CHECK(! Entity_handler::find("nbspx", 5, len));
+}
+
+BOOST_AUTO_TEST_CASE(Entity_handler_differential)
+{
+    Entity_handler eh;
+    Fuzzer fuzz;
+    for (size_t i = 0; i < ITERATIONS; ++i) {
+        const string s = fuzz.token();
+        BOOST_CHECK_MESSAGE(eh.replace_all_entities(s) == ref_replace_all(eh, s), "decoding: " << s);
+    }
+}
+/// @}
@@ -0,0 +1,193 @@
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "HTML_lexer.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ *
+ * A lexer that is reset gives the same results as a new one, whatever state the previous
+ * document left it in.
+ */
+using namespace std;
+
+namespace {
+
+struct Doc {
+    const char* html;
+    const char* base_url;
+};
+
+/// documents that end in the middle of something, followed by ones that would be affected
+const Doc DOCS[] = {
+    {"<html><head><title>First &amp; only</title></head><body><p>Hello <a href=\"/a\">a link</a></body></html>", "http://example.com/dir/page.html"},
+    {"<body>unclosed <a href=\"/open\" rel=\"nofollow\">link text", "http://example.com/"},
+    {"no body tag, <a href=\"rel.html\">relative</a> links", ""},
+    {"<html><head><title>never closed", "http://example.org/x/y"},
+    {"<body><script>var a = 1 < 2; document.write('<b>", "http://example.org/"},
+    {"<meta name=\"robots\" content=\"noindex, nofollow\"><meta http-equiv=\"Content-Type\" content=\"text/html; charset=ISO-8859-1\">"
+        "<link rel=\"alternate\" type=\"application/rss+xml\" href=\"/feed.xml\"><body>text", "http://example.net/"},
+    {"<body><div>caf&eacute; <frame src=\"/frame.html\">", "http://example.com/"},
+    {"<meta charset=\"windows-1252\"><body>\x93quoted\x94 <a href=\"/caf\xe9\">caf\xe9", "http://example.com/"},
+    {"<a href=\"x.html\">after</a> plain <b>text</b> &#8364;10", "http://example.com/dir/"},
+    {"", ""},
+    {"<body><p unclosed attribute=\"", "http://example.com/"},
+    {"<html><body>the end</body></html>", "http://example.com/last"},
+};
+const size_t NDOCS = sizeof(DOCS) / sizeof(DOCS[0]);
+
+ProcHTML lex_fresh(const Doc& doc)
+{
+    ProcHTML result;
+    ProcHTML_sink sink(result);
+    const string base_url = doc.base_url;
+    HTML_lexer lexer(&sink, base_url.empty() ? 0 : &base_url, &result.analysis, false);
+    string read_as;
+    lexer.lex(doc.html, strlen(doc.html), "", read_as);
+    result.base_url = base_url;
+    result.analysis.charset = read_as;
+    return result;
+}
+
+void check_equal(const ProcHTML& a, const ProcHTML& b, const Doc& doc)
+{
+    BOOST_TEST_MESSAGE("document: " << doc.html);
+    BOOST_CHECK_EQUAL(a.text, b.text);
+    BOOST_CHECK_EQUAL(a.links, b.links);
+    BOOST_CHECK_EQUAL(a.warnings, b.warnings);
+    BOOST_CHECK_EQUAL(a.base_url, b.base_url);
+    BOOST_CHECK_EQUAL(a.analysis.title, b.analysis.title);
+    BOOST_CHECK_EQUAL(a.analysis.rss2, b.analysis.rss2);
+    BOOST_CHECK_EQUAL(a.analysis.rss, b.analysis.rss);
+    BOOST_CHECK_EQUAL(a.analysis.atom, b.analysis.atom);
+    BOOST_CHECK_EQUAL(a.analysis.charset, b.analysis.charset);
+    BOOST_CHECK_EQUAL(a.analysis.index, b.analysis.index);
+    BOOST_CHECK_EQUAL(a.analysis.follow, b.analysis.follow);
+}
+
+/// throws when it gets a link, the lexer is then in the middle of the tag that ends the anchor
+class Throwing_sink : public Lex_sink {
+public:
+    void text(const char* s, size_t len) { (void) s; (void) len; }
+    void word_break() {}
+    void link(const struct link& l) { (void) l; throw runtime_error("sink failed"); }
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(HTML_lexer_reuse)
+{
+    // every document after every other one, through the lexer of this thread
+    for (size_t i = 0; i < NDOCS; ++i) {
+        for (size_t j = 0; j < NDOCS; ++j) {
+            html_lex(DOCS[i].html, DOCS[i].base_url);
+            check_equal(html_lex(DOCS[j].html, DOCS[j].base_url), lex_fresh(DOCS[j]), DOCS[j]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(HTML_lexer_reset_after_throw)
+{
+    const string base_url = "http://example.com/";
+    const char html[] = "<body><a href=\"/x\">anchor</a><p class=\"after\">text";
+    Throwing_sink throwing;
+    for (size_t j = 0; j < NDOCS; ++j) {
+        BOOST_CHECK_THROW(thread_html_lexer().reset(&throwing, &base_url, 0, false).lex(html, sizeof(html) - 1), runtime_error);
+        check_equal(html_lex(DOCS[j].html, DOCS[j].base_url), lex_fresh(DOCS[j]), DOCS[j]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(HTML_lexer_charset)
+{
+    const ProcHTML latin1 = html_lex("<body>caf\xe9 <a href=\"/caf\xe9\">l\xe0</a></body>", "http://example.com/");
+    BOOST_CHECK_EQUAL(latin1.analysis.charset, "ISO-8859-1");
+    BOOST_CHECK(latin1.text.find("caf\xc3\xa9") != string::npos);
+    BOOST_CHECK(latin1.links.find("l\xc3\xa0") != string::npos);
+
+    const ProcHTML http = html_lex("<body>\x93quoted\x94</body>", "", "windows-1252");
+    BOOST_CHECK_EQUAL(http.analysis.charset, "windows-1252");
+    BOOST_CHECK(http.text.find("\xe2\x80\x9cquoted\xe2\x80\x9d") != string::npos);
+
+    // the BOM is not text
+    const ProcHTML bom = html_lex("\xef\xbb\xbf<body>text</body>", "");
+    BOOST_CHECK_EQUAL(bom.analysis.charset, "UTF-8");
+    BOOST_CHECK_EQUAL(bom.text, html_lex("<body>text</body>", "").text);
+}
+
+BOOST_AUTO_TEST_CASE(HTML_lexer_in_memory)
+{
+    // a page several times the flex buffer, lexed from memory as from a stream
+    string page = "<html><head><title>Index &amp; archive</title>"
+        "<link rel=\"alternate\" type=\"application/rss+xml\" href=\"/feed.xml\"></head><body>\n";
+    for (size_t i = 0; i < 2000; ++i)
+        page += "<div class=\"post\"><p>Post " + to_string(i) + ", caf&eacute; &#8364;" + to_string(i) +
+            " <a href=\"/posts/" + to_string(i) + ".html\">read more</a></p></div>\n";
+    page += "</body></html>";
+    BOOST_REQUIRE(page.size() > 4 * 16384);
+    const string base_url = "http://example.com/blog/";
+
+    // and a prefix, which lex() must not read past
+    const size_t lens[] = {page.size(), page.size() / 2};
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); ++i) {
+        istringstream in(page.substr(0, lens[i]));
+        ostringstream txt;
+        ostringstream lnk;
+        Analysis analysis;
+        HTML_lexer streams(&in, &txt, &base_url, &lnk, 0, &analysis, false);
+        BOOST_CHECK_EQUAL(streams.yylex(), 0);
+
+        ostringstream mem_txt;
+        ostringstream mem_lnk;
+        Stream_sink sink(&mem_txt, &mem_lnk);
+        Analysis mem_analysis;
+        HTML_lexer mem(&sink, &base_url, &mem_analysis, false);
+        BOOST_CHECK_EQUAL(mem.lex(page.data(), lens[i]), 0);
+
+        BOOST_CHECK_EQUAL(mem_txt.str(), txt.str());
+        BOOST_CHECK_EQUAL(mem_lnk.str(), lnk.str());
+        BOOST_CHECK_EQUAL(mem_analysis.title, analysis.title);
+        BOOST_CHECK_EQUAL(mem_analysis.rss2, analysis.rss2);
+    }
+
+    ProcHTML result = html_lex(page, base_url);
+    BOOST_CHECK_EQUAL(result.analysis.title, "Index & archive");
+    BOOST_CHECK(result.text.find("Post 1999, caf\xc3\xa9 \xe2\x82\xac" "1999") != string::npos);
+    BOOST_CHECK(result.links.find("http://example.com/posts/1999.html") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(HTML_lexer_reset_streams)
+{
+    istringstream in;
+    ostringstream txt;
+    ostringstream lnk;
+    Analysis analysis;
+    HTML_lexer lexer(&in, &txt, 0, &lnk, 0, &analysis, false);
+    for (size_t i = 0; i < NDOCS; ++i) {
+        const string base_url = DOCS[i].base_url;
+        istringstream doc_in(DOCS[i].html);
+        ostringstream doc_txt;
+        ostringstream doc_lnk;
+        Analysis doc_analysis;
+        lexer.reset(&doc_in, &doc_txt, base_url.empty() ? 0 : &base_url, &doc_lnk, 0, &doc_analysis, false);
+        lexer.yylex();
+
+        // streams are lexed as they come, without charset conversion
+        istringstream fresh_in(DOCS[i].html);
+        ostringstream fresh_txt;
+        ostringstream fresh_lnk;
+        Analysis fresh_analysis;
+        HTML_lexer fresh(&fresh_in, &fresh_txt, base_url.empty() ? 0 : &base_url, &fresh_lnk, 0, &fresh_analysis, false);
+        fresh.yylex();
+
+        BOOST_CHECK_EQUAL(doc_txt.str(), fresh_txt.str());
+        BOOST_CHECK_EQUAL(doc_lnk.str(), fresh_lnk.str());
+        BOOST_CHECK_EQUAL(doc_analysis.title, fresh_analysis.title);
+        BOOST_CHECK_EQUAL(doc_analysis.charset, fresh_analysis.charset);
+        BOOST_CHECK_EQUAL(doc_analysis.index, fresh_analysis.index);
+    }
+}
+
+/// @}
@@ -0,0 +1,64 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include "Host_table.hh"
+#include "Public_suffix.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+BOOST_AUTO_TEST_CASE(Public_suffix_registered_domain)
+{
+    using public_suffix::registered_domain;
+    // some of the test vectors of the public suffix list
+    BOOST_CHECK_EQUAL(registered_domain("com"), "com");
+    BOOST_CHECK_EQUAL(registered_domain("example.com"), "example.com");
+    BOOST_CHECK_EQUAL(registered_domain("b.example.com"), "example.com");
+    BOOST_CHECK_EQUAL(registered_domain("a.b.example.com"), "example.com");
+    BOOST_CHECK_EQUAL(registered_domain("uk"), "uk");
+    BOOST_CHECK_EQUAL(registered_domain("co.uk"), "co.uk");
+    BOOST_CHECK_EQUAL(registered_domain("www.bbc.co.uk"), "bbc.co.uk");
+    // wildcard and exception
+    BOOST_CHECK_EQUAL(registered_domain("c.ck"), "c.ck");
+    BOOST_CHECK_EQUAL(registered_domain("b.c.ck"), "b.c.ck");
+    BOOST_CHECK_EQUAL(registered_domain("a.b.c.ck"), "b.c.ck");
+    BOOST_CHECK_EQUAL(registered_domain("www.ck"), "www.ck");
+    BOOST_CHECK_EQUAL(registered_domain("www.www.ck"), "www.ck");
+    BOOST_CHECK_EQUAL(registered_domain("a.city.kobe.jp"), "city.kobe.jp");
+    // rules deeper than two labels, and second levels of any country
+    BOOST_CHECK_EQUAL(registered_domain("kyoto.jp"), "kyoto.jp");
+    BOOST_CHECK_EQUAL(registered_domain("ayabe.kyoto.jp"), "ayabe.kyoto.jp");
+    BOOST_CHECK_EQUAL(registered_domain("www.city.ayabe.kyoto.jp"), "city.ayabe.kyoto.jp");
+    BOOST_CHECK_EQUAL(registered_domain("www.town.ayabe.kyoto.jp"), "town.ayabe.kyoto.jp");
+    BOOST_CHECK_EQUAL(registered_domain("www.school.pvt.k12.ma.us"), "school.pvt.k12.ma.us");
+    BOOST_CHECK_EQUAL(registered_domain("www.example.co.at"), "example.co.at");
+    // unlisted tld, the default rule is *
+    BOOST_CHECK_EQUAL(registered_domain("b.example.unlistedtld"), "example.unlistedtld");
+    BOOST_CHECK_EQUAL(registered_domain("www.example.com."), "example.com.");
+    BOOST_CHECK_EQUAL(registered_domain("192.168.0.1"), "192.168.0.1");
+    BOOST_CHECK_EQUAL(registered_domain("[::1]"), "[::1]");
+    BOOST_CHECK_EQUAL(registered_domain(""), "");
+}
+
+BOOST_AUTO_TEST_CASE(Host_table_intern)
+{
+    Host_table t;
+    const uint32_t a = t.intern("a.example.com");
+    const uint32_t b = t.intern("b.example.com");
+    BOOST_CHECK(a != b);
+    BOOST_CHECK_EQUAL(t.intern("a.example.com"), a);
+    BOOST_CHECK_EQUAL(t.name(a), "a.example.com");
+    BOOST_CHECK_EQUAL(t.domain(a), t.domain(b));
+    BOOST_CHECK_EQUAL(t.name(t.domain(a)), "example.com");
+    BOOST_CHECK_EQUAL(t.domain(t.domain(a)), t.domain(a));
+    // a, its domain and b
+    BOOST_CHECK_EQUAL(t.size(), 3u);
+    BOOST_CHECK_EQUAL(t.find("example.com"), t.domain(a));
+    BOOST_CHECK_EQUAL(t.find("c.example.com"), Host_table::NONE);
+    t.clear();
+    BOOST_CHECK_EQUAL(t.size(), 0u);
+}
+/// @}
@@ -0,0 +1,92 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include "Html_batch.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+namespace {
+
+/// collects the text of every document, each one is only touched by the thread lexing it
+class Text_sink : public html_batch::Sink {
+public:
+    explicit Text_sink(size_t n) : sinks(n), results(n) {}
+
+    struct Text : public Lex_sink {
+        void text(const char* s, size_t len) { txt.append(s, len); }
+        void word_break() { txt.push_back('\n'); }
+        void link(const struct link& l) { txt.append(l.url); }
+        string txt;
+    };
+
+    Lex_sink* sink(size_t i) { return &sinks[i]; }
+    Analysis* analysis(size_t i) { return &results[i]; }
+
+    vector<Text> sinks;
+    vector<Analysis> results;
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(Html_batch_proc_html)
+{
+    vector<string> html;
+    vector<string> base_urls;
+    for (size_t i = 0; i < 500; ++i) {
+        html.push_back("<html><head><title>doc " + to_string(i) + "</title></head><body><p>text &amp; <a href=\"/"
+            + to_string(i) + "\">link</a></body></html>");
+        base_urls.push_back(i % 3 ? "http://example.com/dir/" : "");
+    }
+    base_urls[7] = "not/absolute";
+    vector<html_batch::Doc> docs;
+    for (size_t i = 0; i < html.size(); ++i)
+        docs.push_back(html_batch::Doc(html[i], base_urls[i]));
+
+    vector<ProcHTML> one;
+    html_batch::lex(docs, one, 1);
+    vector<ProcHTML> many;
+    html_batch::lex(docs, many, 4);
+
+    BOOST_REQUIRE_EQUAL(one.size(), docs.size());
+    BOOST_REQUIRE_EQUAL(many.size(), docs.size());
+    BOOST_CHECK(one[7].text.empty());
+    BOOST_CHECK(one[7].warnings.find("not absolute") != string::npos);
+    for (size_t i = 0; i < docs.size(); ++i) {
+        BOOST_CHECK_EQUAL(one[i].text, many[i].text);
+        BOOST_CHECK_EQUAL(one[i].links, many[i].links);
+        BOOST_CHECK_EQUAL(one[i].warnings, many[i].warnings);
+        BOOST_CHECK_EQUAL(one[i].base_url, base_urls[i]);
+        BOOST_CHECK_EQUAL(many[i].analysis.title, one[i].analysis.title);
+        if (i == 7)
+            continue;
+        const ProcHTML single = html_lex(html[i], base_urls[i]);
+        BOOST_CHECK_EQUAL(many[i].text, single.text);
+        BOOST_CHECK_EQUAL(many[i].links, single.links);
+        BOOST_CHECK_EQUAL(many[i].analysis.title, single.analysis.title);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Html_batch_sink)
+{
+    vector<string> html;
+    for (size_t i = 0; i < 100; ++i)
+        html.push_back("<title>t" + to_string(i) + "</title><body><a href=\"a" + to_string(i) + "\">x</a>");
+    const string base_url = "http://example.com/";
+    vector<html_batch::Doc> docs;
+    for (size_t i = 0; i < html.size(); ++i)
+        docs.push_back(html_batch::Doc(html[i], base_url));
+
+    Text_sink sink(docs.size());
+    html_batch::lex(&docs[0], &docs[0] + docs.size(), sink, 0);
+    for (size_t i = 0; i < docs.size(); ++i) {
+        const ProcHTML single = html_lex(html[i], base_url);
+        BOOST_CHECK_EQUAL(sink.results[i].title, single.analysis.title);
+        BOOST_CHECK(sink.sinks[i].txt.find("http://example.com/a" + to_string(i)) != string::npos);
+    }
+}
+/// @}
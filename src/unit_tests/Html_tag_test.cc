@@ -0,0 +1,31 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include "Html_tag.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+using namespace html_tag;
+
+BOOST_AUTO_TEST_CASE(Html_tag_lookup)
+{
+    BOOST_CHECK_EQUAL(lookup("a"), TAG_A);
+    BOOST_CHECK_EQUAL(lookup("body"), TAG_BODY);
+    BOOST_CHECK_EQUAL(lookup("h1"), TAG_H1);
+    BOOST_CHECK_EQUAL(lookup(string("xmp")), TAG_XMP);
+    BOOST_CHECK_EQUAL(lookup(""), TAG_UNKNOWN);
+    BOOST_CHECK_EQUAL(lookup("blah"), TAG_UNKNOWN);
+    BOOST_CHECK_EQUAL(lookup("ab"), TAG_UNKNOWN);
+    BOOST_CHECK_EQUAL(lookup("abbrx"), TAG_UNKNOWN);
+    // names are lowercased by the lexer
+    BOOST_CHECK_EQUAL(lookup("BODY"), TAG_UNKNOWN);
+    BOOST_CHECK_EQUAL(lookup(string("a\0", 2)), TAG_UNKNOWN);
+
+    for (int t = TAG_UNKNOWN + 1; t < TAG_MAX; ++t)
+        BOOST_CHECK_EQUAL(lookup(name(static_cast<tag_t>(t))), t);
+    BOOST_CHECK_EQUAL(string(name(TAG_UNKNOWN)), "");
+}
+/// @}
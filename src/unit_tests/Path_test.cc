@@ -0,0 +1,73 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include "Url.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+namespace {
+
+string normalized(const string& s)
+{
+    Path p(s);
+    p.normalize();
+    BOOST_CHECK_EQUAL(p.size(), p.get().size());
+    return p.get();
+}
+
+/// resolve a reference as the html lexer does with links
+string resolve(const string& ref)
+{
+    Url base("http://a/b/c/d;p?q");
+    Url r(ref);
+    r.normalize();
+    base.merge_ref(r);
+    base.normalize();
+    return base.get();
+}
+
+} // end anon ns
+
+BOOST_AUTO_TEST_CASE(Path_remove_dot_segments)
+{
+    BOOST_CHECK_EQUAL(normalized("/a/b/c/./../../g"), "/a/g");
+    BOOST_CHECK_EQUAL(normalized("/a//b/"), "/a/b/");
+    BOOST_CHECK_EQUAL(normalized("/./a"), "/a");
+    BOOST_CHECK_EQUAL(normalized("/../a/.."), "/");
+    BOOST_CHECK_EQUAL(normalized("/a/."), "/a/");
+    BOOST_CHECK_EQUAL(normalized("/a/..b/c.."), "/a/..b/c..");
+    // relative paths keep what is left to be resolved against a base
+    BOOST_CHECK_EQUAL(normalized("mid/content=5/../6"), "mid/6");
+    BOOST_CHECK_EQUAL(normalized("../a/../../b"), "../../b");
+    BOOST_CHECK_EQUAL(normalized("./a/./b"), "./a/b");
+}
+
+BOOST_AUTO_TEST_CASE(Path_merge)
+{
+    // RFC 3986 5.4
+    BOOST_CHECK_EQUAL(resolve("g"), "http://a/b/c/g");
+    BOOST_CHECK_EQUAL(resolve("./g"), "http://a/b/c/g");
+    BOOST_CHECK_EQUAL(resolve("g/"), "http://a/b/c/g/");
+    BOOST_CHECK_EQUAL(resolve("/g"), "http://a/g");
+    BOOST_CHECK_EQUAL(resolve("?y"), "http://a/b/c/d;p?y");
+    BOOST_CHECK_EQUAL(resolve("g?y#s"), "http://a/b/c/g?y#s");
+    BOOST_CHECK_EQUAL(resolve(";x"), "http://a/b/c/;x");
+    BOOST_CHECK_EQUAL(resolve(""), "http://a/b/c/d;p?q");
+    BOOST_CHECK_EQUAL(resolve("."), "http://a/b/c/");
+    BOOST_CHECK_EQUAL(resolve(".."), "http://a/b/");
+    BOOST_CHECK_EQUAL(resolve("../g"), "http://a/b/g");
+    BOOST_CHECK_EQUAL(resolve("../../"), "http://a/");
+    BOOST_CHECK_EQUAL(resolve("../../../../g"), "http://a/g");
+    BOOST_CHECK_EQUAL(resolve("/./g"), "http://a/g");
+    BOOST_CHECK_EQUAL(resolve("/../g"), "http://a/g");
+    BOOST_CHECK_EQUAL(resolve("g.."), "http://a/b/c/g..");
+    BOOST_CHECK_EQUAL(resolve("./g/."), "http://a/b/c/g/");
+    BOOST_CHECK_EQUAL(resolve("g;x=1/../y"), "http://a/b/c/y");
+    BOOST_CHECK_EQUAL(resolve("g?y/../x"), "http://a/b/c/g?y/../x");
+    BOOST_CHECK_EQUAL(resolve("g#s/./x"), "http://a/b/c/g#s/./x");
+}
+/// @}
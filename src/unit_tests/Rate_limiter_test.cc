@@ -0,0 +1,157 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include "Rate_limiter.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+namespace {
+
+/// what fake_clock says, in microseconds
+int64_t g_now = 1000000;
+
+utils::timer fake_clock()
+{
+    return utils::timer(g_now);
+}
+
+/// let ms milliseconds pass and refill
+void pass(Rate_limiter& r, int64_t ms)
+{
+    g_now += ms * 1000;
+    r.refill();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(Rate_limiter_token_bucket)
+{
+    utils::timer t(0);
+    Token_bucket unlimited(0, t);
+    unlimited.consume(1 << 30);
+    BOOST_CHECK(unlimited.available());
+
+    // 100 KB/s, the burst is half a second worth of tokens and it starts full
+    Token_bucket b(102400, t);
+    b.consume(51199);
+    BOOST_CHECK(b.available());
+    b.consume(1);
+    BOOST_CHECK(! b.available());
+    // the debt of a chunk written past the limit is paid by the next refills
+    b.consume(1000);
+    b.refill(t += 5000);
+    BOOST_CHECK(! b.available());
+    b.refill(t += 5000);
+    BOOST_CHECK(b.available());
+    // never more than the burst
+    b.refill(t += 60000000);
+    b.consume(51200);
+    BOOST_CHECK(! b.available());
+
+    // slow buckets still let a whole curl write through
+    Token_bucket slow(1024, t);
+    slow.consume(16383);
+    BOOST_CHECK(slow.available());
+    slow.consume(1);
+    BOOST_CHECK(! slow.available());
+
+    // a lower rate cuts the tokens to its burst, removing the limit makes it available
+    b.refill(t += 60000000);
+    b.rate(1024);
+    b.consume(16384);
+    BOOST_CHECK(! b.available());
+    b.rate(0);
+    BOOST_CHECK(b.available());
+}
+
+BOOST_AUTO_TEST_CASE(Rate_limiter_chain)
+{
+    Rate_limiter r(&fake_clock);
+    BOOST_CHECK(! r.limited());
+    Rate_limiter::Chain none = r.chain("www.example.com");
+    BOOST_CHECK(! none.group && ! none.host);
+    BOOST_CHECK(r.admit(none));
+    BOOST_CHECK_EQUAL(r.max_recv_speed(none), 0);
+
+    r.group("partner.com", 64);
+    r.group("img.partner.com", 32);
+    r.host("www.partner.com", 16);
+    BOOST_CHECK(r.limited());
+
+    // the longest suffix on a label boundary
+    Rate_limiter::Chain www = r.chain("www.partner.com");
+    BOOST_CHECK(www.group && www.host);
+    BOOST_CHECK_EQUAL(www.group->rate(), 64 * 1024);
+    BOOST_CHECK_EQUAL(r.chain("partner.com").group, www.group);
+    BOOST_CHECK_EQUAL(r.chain("a.img.partner.com").group->rate(), 32 * 1024);
+    BOOST_CHECK(! r.chain("xpartner.com").group);
+    BOOST_CHECK(! r.chain("partner.com.evil.org").group);
+    BOOST_CHECK(! r.chain("img.partner.com").host);
+
+    // a transfer is capped by the lowest of its group and host, the global limit is enforced by pausing
+    r.global(8);
+    BOOST_CHECK_EQUAL(r.max_recv_speed(www), 16 * 1024);
+    BOOST_CHECK_EQUAL(r.max_recv_speed(r.chain("cdn.partner.com")), 64 * 1024);
+
+    // changing a limit keeps the bucket, removing it takes it out of new chains
+    r.host("www.partner.com", 4);
+    BOOST_CHECK_EQUAL(r.chain("www.partner.com").host, www.host);
+    BOOST_CHECK_EQUAL(www.host->rate(), 4 * 1024);
+    r.host("www.partner.com", 0);
+    BOOST_CHECK(! r.chain("www.partner.com").host);
+    // and a transfer that still holds it isn't limited by it
+    BOOST_CHECK_EQUAL(www.host->rate(), 0);
+    BOOST_CHECK(www.host->available());
+}
+
+BOOST_AUTO_TEST_CASE(Rate_limiter_pause_resume)
+{
+    // bursts of 51200, 32768 and 16384 bytes, refilled with 102.4, 65.536 and 16.384 bytes per ms
+    Rate_limiter r(&fake_clock);
+    r.global(100);
+    r.group("partner.com", 64);
+    r.host("www.partner.com", 16);
+    const Rate_limiter::Chain www = r.chain("www.partner.com");
+    const Rate_limiter::Chain img = r.chain("img.partner.com");
+    const Rate_limiter::Chain other = r.chain("www.example.com");
+
+    // the host bucket runs out first, the others go on
+    r.consume(www, 16384);
+    BOOST_CHECK(! r.admit(www));
+    BOOST_CHECK(r.admit(img));
+    BOOST_CHECK(r.admit(other));
+    // it resumes once refilled over 0
+    pass(r, 1);
+    BOOST_CHECK(r.admit(www));
+
+    // the bytes were charged to the group too, 16449.536 left
+    r.consume(img, 16450);
+    BOOST_CHECK(! r.admit(img));
+    BOOST_CHECK(! r.admit(www));
+    BOOST_CHECK(r.admit(other));
+    pass(r, 1);
+    BOOST_CHECK(r.admit(img));
+    r.consume(img, 100);
+    BOOST_CHECK(! r.admit(img));
+
+    // and to the global bucket, 18470.8 left, which pauses everything
+    r.consume(other, 18471);
+    BOOST_CHECK(! r.admit(other));
+    BOOST_CHECK(! r.admit(Rate_limiter::Chain()));
+    pass(r, 1);
+    BOOST_CHECK(r.admit(other));
+
+    // after a long pause they are all full again, but no more than a burst
+    pass(r, 60000);
+    BOOST_CHECK(r.admit(www));
+    r.consume(www, 16384);
+    BOOST_CHECK(! r.admit(www));
+    BOOST_CHECK(r.admit(img));
+    r.consume(img, 16384);
+    BOOST_CHECK(! r.admit(img));
+}
+/// @}
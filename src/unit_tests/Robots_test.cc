@@ -0,0 +1,153 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include "Robots.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+namespace {
+
+/// @return a matcher with the rules in rules, one per line, prefixed by "+" for Allow and "-" for Disallow
+robots::Matcher matcher(const char* rules[], size_t n)
+{
+    robots::Matcher m;
+    for (size_t i = 0; i < n; ++i)
+        m.add(rules[i] + 1, rules[i][0] == '+');
+    return m;
+}
+
+bool allowed(const robots::Matcher& m, const string& url)
+{
+    const string::size_type q = min(url.find('?'), url.size());
+    return m.allowed(url.data(), q, url.data() + q, url.size() - q);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(Robots_wildcard_match)
+{
+    BOOST_CHECK(robots::wildcard_match("/a*b", 4, "/axxb", 5, false));
+    BOOST_CHECK(robots::wildcard_match("/a*b", 4, "/axxbyy", 7, false));
+    BOOST_CHECK(! robots::wildcard_match("/a*b", 4, "/axxbyy", 7, true));
+    BOOST_CHECK(robots::wildcard_match("/a*b", 4, "/abxb", 5, true));
+    BOOST_CHECK(robots::wildcard_match("*", 1, "", 0, true));
+    BOOST_CHECK(! robots::wildcard_match("/a*", 3, "/b", 2, false));
+}
+
+BOOST_AUTO_TEST_CASE(Robots_matcher)
+{
+    const char* rules[] = {
+        "-/a.pdf$",
+        "-/*?",
+        "+/*?page=",
+        "-/private/",
+        "+/private/public/",
+        "-/tie",
+        "+/tie",
+        "+/*.html",
+        "-/b.html",
+        "-/%7Ejoe/",
+        "-/~bob/",
+        "-/a%2fb",
+        "-/space here",
+        "-*",
+        "+/",
+    };
+    const robots::Matcher m = matcher(rules, sizeof(rules) / sizeof(rules[0]));
+    BOOST_CHECK_EQUAL(m.size(), sizeof(rules) / sizeof(rules[0]));
+
+    const char* tests[][2] = {
+        // '$' anchors the end
+        {"/a.pdf", "-"},
+        {"/a.pdfx", "+"},
+        {"/a.pdf/", "+"},
+        // '*' before the query
+        {"/search?q=1", "-"},
+        {"/search", "+"},
+        {"/?", "-"},
+        {"/list?page=2", "+"},
+        // the longest rule wins whatever the order
+        {"/private/", "-"},
+        {"/private/x.html", "-"},
+        {"/private/public/x", "+"},
+        {"/private/publicx", "-"},
+        // on a tie Allow wins, with and without wildcards
+        {"/tie", "+"},
+        {"/tiex", "+"},
+        {"/b.html", "+"},
+        // escapes of unreserved chars are decoded, the rest compared as they are
+        {"/~joe/x", "-"},
+        {"/%7ejoe/x", "-"},
+        {"/%7Ebob/x", "-"},
+        {"/a%2Fb", "-"},
+        {"/a/b", "+"},
+        {"/space%20here", "-"},
+        // "/" is as long as "*"
+        {"/elsewhere", "+"},
+        {"", "+"},
+    };
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+        BOOST_CHECK_MESSAGE(allowed(m, tests[i][0]) == (tests[i][1][0] == '+'), tests[i][0]);
+
+    // longer than the buffer on the stack
+    const string long_url = "/private/" + string(5000, 'x');
+    BOOST_CHECK(! allowed(m, long_url));
+    BOOST_CHECK(allowed(m, "/private/public/" + string(5000, '~')));
+
+    robots::Matcher empty;
+    empty.add("", false);
+    BOOST_CHECK_EQUAL(empty.size(), 0u);
+    BOOST_CHECK(allowed(empty, "/x"));
+}
+
+BOOST_AUTO_TEST_CASE(Robots_user_agent)
+{
+    const string txt =
+        "\xEF\xBB\xBF# comment\n"
+        "User-agent: *\n"
+        "Disallow: /\n"
+        "\n"
+        "User-agent: Mycelium\n"
+        "Disallow: /all-versions\n"
+        "\n"
+        "user-agent: mycelium-news\n"
+        "USER-AGENT: other\n"
+        "disallow: /news   # only news\n"
+        "\n"
+        "User-agent: Mycelium\n"
+        "Disallow: /merged\n"
+        "Sitemap: http://example.com/sitemap.xml\n";
+    robots::Robots r;
+    BOOST_REQUIRE_EQUAL(r.parse(txt), 0);
+    BOOST_CHECK(r.valid);
+    BOOST_REQUIRE_EQUAL(r.sitemaps.size(), 1u);
+    BOOST_CHECK_EQUAL(r.sitemaps[0], "http://example.com/sitemap.xml");
+
+    // the longest product token that is a prefix of the user agent, groups with it merged
+    r.compile("Mycelium/1.0 (+http://example.com)");
+    BOOST_CHECK(! r.allowed("/all-versions"));
+    BOOST_CHECK(! r.allowed("/merged"));
+    BOOST_CHECK(r.allowed("/news"));
+    BOOST_CHECK(r.allowed("/"));
+
+    r.compile("Mycelium-News/2.0");
+    BOOST_CHECK(! r.allowed("/news"));
+    BOOST_CHECK(r.allowed("/all-versions"));
+
+    // a prefix that doesn't end in a word boundary doesn't match, so it's the "*" group
+    r.compile("Myceliumbot/1.0");
+    BOOST_CHECK(! r.allowed("/news"));
+    BOOST_CHECK(! r.allowed("/"));
+
+    BOOST_CHECK(! r.path_allowed("other", "/news?x"));
+    BOOST_CHECK(r.path_allowed("other", "/all-versions"));
+
+    // html instead of a robots.txt
+    robots::Robots html;
+    BOOST_CHECK_EQUAL(html.parse("<html><body>Not found</body></html>\n"), -1);
+}
+/// @}
@@ -0,0 +1,194 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "Sitemap_parser.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+namespace {
+
+struct Entry {
+    string loc;
+    long lastmod;
+    bool sitemap;
+};
+
+struct Collect {
+    Collect(vector<Entry>& entries) : entries(entries) {}
+    void operator()(const string& loc, long lastmod, bool sitemap) const
+    {
+        Entry e = {loc, lastmod, sitemap};
+        entries.push_back(e);
+    }
+    vector<Entry>& entries;
+};
+
+string gzip(const string& in)
+{
+    z_stream zs = z_stream();
+    BOOST_REQUIRE_EQUAL(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY), Z_OK);
+    string out(deflateBound(&zs, in.size()), 0);
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = in.size();
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = out.size();
+    BOOST_REQUIRE_EQUAL(deflate(&zs, Z_FINISH), Z_STREAM_END);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+/// feed doc in chunks of chunk bytes
+bool parse(const string& doc, size_t chunk, vector<Entry>& entries, bool index = true)
+{
+    entries.clear();
+    sitemap::Parser parser(Collect(entries), index);
+    bool ok = true;
+    for (size_t i = 0; i < doc.size() && ok; i += chunk)
+        ok = parser.feed(doc.data() + i, min(chunk, doc.size() - i));
+    BOOST_CHECK_EQUAL(parser.error(), ! ok);
+    BOOST_CHECK_EQUAL(parser.entries(), entries.size());
+    return ok;
+}
+
+const char SITEMAP[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<!-- <url><loc>http://example.com/commented</loc></url> -->\n"
+    "<urlset xmlns=\"http://www.sitemaps.org/schemas/sitemap/0.9\">\n"
+    "  <url>\n"
+    "    <loc> http://example.com/?a=1&amp;b=&#x32;&#51; </loc>\n"
+    "    <lastmod>1997-07-16</lastmod>\n"
+    "    <changefreq>daily</changefreq>\n"
+    "  </url>\n"
+    "  <url><loc><![CDATA[http://example.com/cdata]]x]]]></loc></url>\n"
+    "  <s:url xmlns:s=\"http://www.sitemaps.org/schemas/sitemap/0.9\"><s:loc>http://example.com/ns</s:loc></s:url>\n"
+    "  <url><lastmod>2012-01-01</lastmod></url>\n"
+    "</urlset>\n";
+
+}
+
+BOOST_AUTO_TEST_CASE(Sitemap_parser_chunks)
+{
+    const string doc = SITEMAP;
+    vector<Entry> whole;
+    BOOST_REQUIRE(parse(doc, doc.size(), whole));
+    BOOST_REQUIRE_EQUAL(whole.size(), 3u);
+    BOOST_CHECK_EQUAL(whole[0].loc, "http://example.com/?a=1&b=23");
+    BOOST_CHECK_EQUAL(whole[0].lastmod, 869011200);
+    BOOST_CHECK(! whole[0].sitemap);
+    BOOST_CHECK_EQUAL(whole[1].loc, "http://example.com/cdata]]x]");
+    BOOST_CHECK_EQUAL(whole[1].lastmod, 0);
+    BOOST_CHECK_EQUAL(whole[2].loc, "http://example.com/ns");
+
+    // one byte at a time splits tags, entities and CDATA terminators, plain and compressed
+    const string gz = gzip(doc);
+    for (size_t chunk = 1; chunk < 4; ++chunk) {
+        vector<Entry> entries;
+        BOOST_REQUIRE(parse(doc, chunk, entries));
+        BOOST_REQUIRE_EQUAL(entries.size(), whole.size());
+        for (size_t i = 0; i < whole.size(); ++i) {
+            BOOST_CHECK_EQUAL(entries[i].loc, whole[i].loc);
+            BOOST_CHECK_EQUAL(entries[i].lastmod, whole[i].lastmod);
+        }
+
+        BOOST_REQUIRE(parse(gz, chunk, entries));
+        BOOST_REQUIRE_EQUAL(entries.size(), whole.size());
+        for (size_t i = 0; i < whole.size(); ++i)
+            BOOST_CHECK_EQUAL(entries[i].loc, whole[i].loc);
+    }
+
+    // trailing garbage after the gzip stream is ignored
+    vector<Entry> entries;
+    BOOST_CHECK(parse(gz + "garbage", 7, entries));
+    BOOST_CHECK_EQUAL(entries.size(), whole.size());
+    BOOST_CHECK(! parse(gz.substr(0, 10) + string(100, 'x'), 1, entries));
+}
+
+BOOST_AUTO_TEST_CASE(Sitemap_parser_index)
+{
+    const string doc =
+        "<sitemapindex xmlns=\"http://www.sitemaps.org/schemas/sitemap/0.9\">"
+        "<sitemap><loc>http://example.com/s1.xml.gz</loc><lastmod>2012-02-29T23:59:59Z</lastmod></sitemap>"
+        "<sitemap><loc>http://example.com/s2.xml</loc></sitemap>"
+        "</sitemapindex>";
+    vector<Entry> entries;
+    BOOST_REQUIRE(parse(doc, 5, entries));
+    BOOST_REQUIRE_EQUAL(entries.size(), 2u);
+    BOOST_CHECK(entries[0].sitemap);
+    BOOST_CHECK_EQUAL(entries[0].loc, "http://example.com/s1.xml.gz");
+    BOOST_CHECK_EQUAL(entries[0].lastmod, 1330559999);
+
+    // a sitemap listed in an index can't be an index
+    BOOST_CHECK(parse(doc, 5, entries, false));
+    BOOST_CHECK(entries.empty());
+    BOOST_CHECK(parse(SITEMAP, 5, entries, false));
+    BOOST_CHECK_EQUAL(entries.size(), 3u);
+}
+
+BOOST_AUTO_TEST_CASE(Sitemap_parser_limits)
+{
+    string doc = "<urlset>";
+    for (size_t i = 0; i < sitemap::MAX_ENTRIES; ++i)
+        doc += "<url><loc>http://example.com/" + to_string(i) + "</loc></url>\n";
+    vector<Entry> entries;
+    BOOST_CHECK(parse(doc + "</urlset>", 4096, entries));
+    BOOST_CHECK_EQUAL(entries.size(), sitemap::MAX_ENTRIES);
+    BOOST_CHECK(! parse(doc + "<url><loc>http://example.com/over</loc></url></urlset>", 4096, entries));
+    BOOST_CHECK_EQUAL(entries.size(), sitemap::MAX_ENTRIES);
+
+    // the size is counted uncompressed
+    const string spaces(sitemap::MAX_SIZE, ' ');
+    BOOST_CHECK(parse(spaces, 1 << 16, entries));
+    BOOST_CHECK(! parse(spaces + ' ', 1 << 16, entries));
+    const string bomb = gzip(spaces + ' ');
+    BOOST_CHECK_LT(bomb.size(), 1u << 20);
+    BOOST_CHECK(! parse(bomb, 4096, entries));
+
+    // a huge <loc> is dropped, not buffered
+    BOOST_CHECK(parse("<urlset><url><loc>http://example.com/" + string(100000, 'x') + "</loc></url></urlset>", 4096, entries));
+    BOOST_CHECK(entries.empty());
+}
+
+BOOST_AUTO_TEST_CASE(Sitemap_parser_w3c_datetime)
+{
+    const pair<const char*, long> tests[] = {
+        make_pair("1997", 852076800L),
+        make_pair("1997-07", 867715200L),
+        make_pair("1997-07-16", 869011200L),
+        make_pair("1997-07-16T19:20+01:00", 869077200L),
+        make_pair("1997-07-16T19:20:30+01:00", 869077230L),
+        make_pair("1997-07-16T19:20:30.45+01:00", 869077230L),
+        make_pair("1997-07-16T19:20:30-05:00", 869098830L),
+        make_pair("1997-07-16T18:20:30Z", 869077230L),
+        make_pair("2012-02-29T23:59:59Z", 1330559999L),
+        // invalid
+        make_pair("", 0L),
+        make_pair("97", 0L),
+        make_pair("1997-7", 0L),
+        make_pair("1997-13", 0L),
+        make_pair("1997-07-32", 0L),
+        make_pair("1997-07-16T19:20", 0L),
+        make_pair("1997-07-16T19:20:30", 0L),
+        make_pair("1997-07-16T24:00Z", 0L),
+        make_pair("1997-07-16T19:20+0100", 0L),
+        make_pair("1997-07-16 19:20Z", 0L),
+        make_pair("1997-07-16T19:20Zjunk", 0L),
+    };
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+        BOOST_CHECK_MESSAGE(sitemap::parse_w3c_datetime(tests[i].first) == tests[i].second, tests[i].first);
+}
+
+BOOST_AUTO_TEST_CASE(Sitemap_parser_entities)
+{
+    BOOST_CHECK_EQUAL(sitemap::decode_xml_entities("a&lt;b&gt;c&quot;&apos;&amp;"), "a<b>c\"'&");
+    BOOST_CHECK_EQUAL(sitemap::decode_xml_entities("&#233;&#x20AC;&#X1F600;"), "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80");
+    // unknown, unterminated or out of range are kept as they are
+    BOOST_CHECK_EQUAL(sitemap::decode_xml_entities("&nbsp;&amp&#0;&#x110000;"), "&nbsp;&amp&#0;&#x110000;");
+}
+/// @}
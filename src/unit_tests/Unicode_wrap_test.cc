@@ -0,0 +1,95 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include "Unicode_wrap.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+namespace {
+
+string convert(const string& in, const string& from, const string& to)
+{
+    unicode_wrap::Converter conv(from, to);
+    string out = "stale";
+    conv.convert(in, out);
+    return out;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(Unicode_wrap_convert)
+{
+    // the direct ones
+    BOOST_CHECK_EQUAL(convert("plain", "US-ASCII", "UTF-8"), "plain");
+    BOOST_CHECK_EQUAL(convert("caf\xc3\xa9", "UTF-8", "utf8"), "caf\xc3\xa9");
+    BOOST_CHECK_EQUAL(convert("caf\xe9 \xff", "ISO-8859-1", "UTF-8"), "caf\xc3\xa9 \xc3\xbf");
+    BOOST_CHECK_EQUAL(convert("", "latin1", "UTF-8"), "");
+    // what they can't take goes through ICU
+    BOOST_CHECK_EQUAL(convert("a\xc3z", "UTF-8", "UTF-8"), "a\xef\xbf\xbdz");
+    BOOST_CHECK_EQUAL(convert("a\xe9z", "US-ASCII", "UTF-8"), "a\xef\xbf\xbdz");
+    BOOST_CHECK_EQUAL(convert("\x93\xfa\x96\x7b", "Shift_JIS", "UTF-8"), "\xe6\x97\xa5\xe6\x9c\xac");
+    BOOST_CHECK_EQUAL(convert("caf\xc3\xa9", "UTF-8", "ISO-8859-1"), "caf\xe9");
+    BOOST_CHECK_EQUAL(convert("x", "UTF-8", "UTF-16LE"), string("x\0", 2));
+
+    // larger than the pivot, and the converter is reused
+    string big;
+    for (size_t i = 0; i < 10000; ++i)
+        big += "\x93\xfa ";
+    unicode_wrap::Converter conv("Shift_JIS", "UTF-8");
+    string out;
+    for (size_t i = 0; i < 2; ++i) {
+        conv.convert(big, out);
+        BOOST_REQUIRE_EQUAL(out.size(), 4 * 10000u);
+        BOOST_CHECK_EQUAL(out.substr(out.size() - 4), "\xe6\x97\xa5 ");
+    }
+    // the most it can grow, three bytes out for each byte in
+    unicode_wrap::Converter euro("windows-1252", "UTF-8");
+    euro.convert(string(200000, '\x80'), out);
+    BOOST_REQUIRE_EQUAL(out.size(), 600000u);
+    BOOST_CHECK_EQUAL(out.substr(0, 3), "\xe2\x82\xac");
+
+    BOOST_CHECK_THROW(unicode_wrap::Converter("UTF-8", "no-such-charset"), unicode_wrap::unicode_error);
+}
+
+BOOST_AUTO_TEST_CASE(Unicode_wrap_unicode_string)
+{
+    unicode_wrap::Converter conv;
+    UnicodeString str;
+    conv.convert_to_unicode("ISO-8859-15", "\xa4 5", str);
+    BOOST_REQUIRE_EQUAL(str.length(), 3);
+    BOOST_CHECK_EQUAL(str.charAt(0), 0x20AC);
+
+    vector<char> res;
+    conv.convert_unicode_to("UTF-8", str, res);
+    BOOST_CHECK_EQUAL(string(res.begin(), res.end()), "\xe2\x82\xac 5");
+
+    BOOST_CHECK_EQUAL(unicode_wrap::cp2utf8(0x1F600), "\xf0\x9f\x98\x80");
+}
+
+BOOST_AUTO_TEST_CASE(Unicode_wrap_open_converter)
+{
+    // clones, each with its own state
+    UConverter* a = unicode_wrap::open_converter("windows-1252");
+    UConverter* b = unicode_wrap::open_converter("windows-1252");
+    BOOST_CHECK(a != b);
+    UErrorCode status = U_ZERO_ERROR;
+    BOOST_CHECK_EQUAL(ucnv_getName(a, &status), ucnv_getName(b, &status));
+    ucnv_close(a);
+    ucnv_close(b);
+    BOOST_CHECK_THROW(unicode_wrap::open_converter(""), unicode_wrap::unicode_error);
+    BOOST_CHECK_THROW(unicode_wrap::open_converter("no-such-charset"), unicode_wrap::unicode_error);
+
+    // the spellings ICU takes as the same charset share the converter of the thread
+    UConverter* utf8 = unicode_wrap::thread_converter("UTF-8");
+    BOOST_CHECK_EQUAL(unicode_wrap::thread_converter("utf8"), utf8);
+    BOOST_CHECK_EQUAL(unicode_wrap::thread_converter("u-t-f---8"), utf8);
+    BOOST_CHECK_EQUAL(unicode_wrap::thread_converter("ISO_8859-1"), unicode_wrap::thread_converter("Latin1"));
+    BOOST_CHECK(unicode_wrap::thread_converter("Shift_JIS") != utf8);
+    BOOST_CHECK_THROW(unicode_wrap::thread_converter("no-such-charset"), unicode_wrap::unicode_error);
+}
+/// @}
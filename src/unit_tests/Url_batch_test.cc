@@ -0,0 +1,56 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include "Url_batch.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+BOOST_AUTO_TEST_CASE(Url_batch_normalize)
+{
+    vector<string> in;
+    for (size_t i = 0; i < 10000; ++i)
+        in.push_back("HTTP://WWW.Ex%41mple" + to_string(i % 7) + ".COM/a/../%7e" + to_string(i) + "?q");
+    in[3] = "http://[bad";
+
+    url_batch::Normalized one;
+    url_batch::normalize(in, one, 1);
+    url_batch::Normalized many;
+    url_batch::normalize(in, many, 4);
+
+    BOOST_REQUIRE_EQUAL(one.urls.size(), in.size());
+    BOOST_CHECK(! one.ok[3]);
+    BOOST_CHECK(one.urls == many.urls);
+    BOOST_CHECK(one.hosts == many.hosts);
+    BOOST_CHECK(one.fingerprints == many.fingerprints);
+    BOOST_CHECK(one.ok == many.ok);
+    for (size_t i = 0; i < in.size(); ++i) {
+        if (i == 3)
+            continue;
+        Url u(in[i]);
+        u.normalize();
+        BOOST_CHECK_EQUAL(one.urls[i], u.get());
+        BOOST_CHECK_EQUAL(one.hosts[i], u.host());
+        BOOST_CHECK_EQUAL(one.fingerprints[i], u.fingerprint());
+    }
+    BOOST_CHECK_EQUAL(one.urls[10], "http://www.example3.com/~10?q");
+}
+
+BOOST_AUTO_TEST_CASE(Url_batch_parse)
+{
+    vector<string> in;
+    in.push_back("http://a.com/b");
+    in.push_back("http://[bad");
+    vector<Url> out;
+    vector<char> ok;
+    url_batch::parse(in, out, ok);
+    BOOST_REQUIRE_EQUAL(out.size(), 2u);
+    BOOST_CHECK(ok[0] && ! ok[1]);
+    BOOST_CHECK_EQUAL(out[0].host(), "a.com");
+    BOOST_CHECK(out[1].empty());
+}
+/// @}
@@ -0,0 +1,217 @@
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Url_classifier.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ */
+using namespace std;
+
+namespace {
+
+Url url(const string& host, const string& path)
+{
+    return Url("http://" + host + path);
+}
+
+/// @return the hosts of the urls in queue n as they are handed out, emptying it
+vector<string> drain(Url_classifier& c, size_t n)
+{
+    vector<string> res;
+    while( ! c.empty_top() || ! c.empty(n) ) {
+        res.push_back(c.peek(n).url.host());
+        c.pop(n);
+    }
+    return res;
+}
+
+/// @return number of runs of the same host in hosts
+size_t runs(const vector<string>& hosts)
+{
+    size_t res = 0;
+    for (size_t i = 0; i < hosts.size(); ++i)
+        if (! i || hosts[i] != hosts[i - 1])
+            ++res;
+    return res;
+}
+
+/// @return the name of the group of the urls in queue n, which must not be empty
+string group_name(Url_classifier& c, size_t n)
+{
+    return c.host_table().name(c.peek(n).group);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(Url_classifier_by_address)
+{
+    Url_classifier c(2, Url_classifier::BY_ADDRESS);
+    BOOST_CHECK(c.by_address());
+    c.push(url("a.example.com", "/1"));
+    c.push(url("b.example.org", "/1"));
+    c.push(url("a.example.com", "/2"));
+    c.push(url("c.example.net", "/1"));
+    // nothing is classified until the addresses are known
+    BOOST_CHECK_EQUAL(c.q_len_unresolved(), 4u);
+    BOOST_CHECK_EQUAL(c.size(), 4u);
+    BOOST_CHECK(! c.empty());
+    BOOST_CHECK(c.empty_top());
+    BOOST_CHECK_EQUAL(c.q_len(0), 0u);
+    BOOST_CHECK_EQUAL(c.q_len(1), 0u);
+
+    // virtual hosts on the same address share a queue
+    c.address("a.example.com", "192.0.2.1");
+    BOOST_CHECK_EQUAL(c.q_len_unresolved(), 2u);
+    BOOST_CHECK_EQUAL(c.q_len(0), 2u);
+    c.address("b.example.org", "192.0.2.1");
+    BOOST_CHECK_EQUAL(c.q_len_unresolved(), 1u);
+    BOOST_CHECK_EQUAL(c.q_len(0), 3u);
+    BOOST_CHECK_EQUAL(group_name(c, 0), "192.0.2.1");
+    BOOST_CHECK_EQUAL(c.peek(0).url.get(), "http://a.example.com/1");
+
+    // one that couldn't be resolved is grouped by its host
+    c.address("c.example.net", "");
+    BOOST_CHECK_EQUAL(c.q_len_unresolved(), 0u);
+    BOOST_CHECK_EQUAL(c.q_len(1), 1u);
+    BOOST_CHECK_EQUAL(group_name(c, 1), "c.example.net");
+
+    // once the address is known urls go straight to their queue
+    c.push(url("b.example.org", "/2"));
+    c.push(url("c.example.net", "/2"));
+    BOOST_CHECK_EQUAL(c.q_len_unresolved(), 0u);
+    BOOST_CHECK_EQUAL(c.q_len(0), 4u);
+    BOOST_CHECK_EQUAL(c.q_len(1), 2u);
+    BOOST_CHECK_EQUAL(c.size(), 6u);
+
+    // a host seen for the first time in address() has no urls waiting
+    c.address("d.example.com", "192.0.2.1");
+    c.push(url("d.example.com", "/1"));
+    BOOST_CHECK_EQUAL(c.q_len(0), 5u);
+}
+
+BOOST_AUTO_TEST_CASE(Url_classifier_by_network)
+{
+    Url_classifier c(3, Url_classifier::BY_NETWORK);
+    c.push(url("a.example.com", "/"));
+    c.push(url("b.example.com", "/"));
+    c.push(url("c.example.com", "/"));
+    c.push(url("d.example.com", "/"));
+    c.address("a.example.com", "192.0.2.1");
+    c.address("b.example.com", "192.0.2.200");
+    c.address("c.example.com", "198.51.100.1");
+    // ipv6 addresses are used as they are
+    c.address("d.example.com", "2001:db8::1");
+    BOOST_CHECK_EQUAL(c.q_len_unresolved(), 0u);
+    BOOST_CHECK_EQUAL(c.q_len(0), 2u);
+    BOOST_CHECK_EQUAL(group_name(c, 0), "192.0.2.0");
+    BOOST_CHECK_EQUAL(c.q_len(1), 1u);
+    BOOST_CHECK_EQUAL(group_name(c, 1), "198.51.100.0");
+    BOOST_CHECK_EQUAL(c.q_len(2), 1u);
+    BOOST_CHECK_EQUAL(group_name(c, 2), "2001:db8::1");
+}
+
+BOOST_AUTO_TEST_CASE(Url_classifier_by_host)
+{
+    Url_classifier hosts(2);
+    BOOST_CHECK(! hosts.by_address());
+    hosts.push(url("www.example.com", "/"));
+    hosts.push(url("img.example.com", "/"));
+    // the address doesn't matter
+    hosts.address("www.example.com", "192.0.2.1");
+    BOOST_CHECK_EQUAL(hosts.q_len_unresolved(), 0u);
+    BOOST_CHECK_EQUAL(hosts.q_len(0), 1u);
+    BOOST_CHECK_EQUAL(hosts.q_len(1), 1u);
+
+    Url_classifier domains(2, Url_classifier::BY_DOMAIN);
+    domains.push(url("www.example.com", "/"));
+    domains.push(url("img.example.com", "/"));
+    BOOST_CHECK_EQUAL(domains.q_len(0), 2u);
+    BOOST_CHECK_EQUAL(group_name(domains, 0), "example.com");
+}
+
+BOOST_AUTO_TEST_CASE(Url_classifier_host_runs)
+{
+    // the urls of a host come out in a row, so that robots.txt is fetched once per host
+    const char* hosts[] = {"a.example.com", "b.example.com", "a.example.com", "c.example.com", "b.example.com", "a.example.com"};
+    Url_classifier c(1, Url_classifier::BY_DOMAIN);
+    for (size_t i = 0; i < 3; ++i)
+        for (size_t j = 0; j < sizeof(hosts) / sizeof(hosts[0]); ++j)
+            c.push(url(hosts[j], "/" + to_string(i) + "/" + to_string(j)));
+    BOOST_CHECK_EQUAL(c.q_len(0), 18u);
+    // the front might be in transfer, it stays where it is
+    BOOST_CHECK_EQUAL(c.peek(0).url.get(), "http://a.example.com/0/0");
+    vector<string> out = drain(c, 0);
+    BOOST_REQUIRE_EQUAL(out.size(), 18u);
+    BOOST_CHECK_EQUAL(runs(out), 3u);
+
+    // also when they come from the top queue, with another domain in the queue
+    c.push(url("www.other.org", "/"));
+    for (size_t i = 0; i < 3; ++i)
+        for (size_t j = 0; j < sizeof(hosts) / sizeof(hosts[0]); ++j)
+            c.push(url(hosts[j], "/" + to_string(i) + "/" + to_string(j)));
+    BOOST_CHECK_EQUAL(c.q_len_top(), 18u);
+    out = drain(c, 0);
+    BOOST_REQUIRE_EQUAL(out.size(), 19u);
+    BOOST_CHECK_EQUAL(out[0], "www.other.org");
+    BOOST_CHECK_EQUAL(runs(out), 4u);
+
+    // and when a handle is released and its urls classified again
+    Url_classifier r(2, Url_classifier::BY_DOMAIN);
+    for (size_t j = 0; j < sizeof(hosts) / sizeof(hosts[0]); ++j)
+        r.push(url(hosts[j], "/" + to_string(j)));
+    r.release(0);
+    for (size_t j = 0; j < sizeof(hosts) / sizeof(hosts[0]); ++j)
+        r.push(url(hosts[j], "/x" + to_string(j)));
+    BOOST_CHECK_EQUAL(runs(drain(r, 1)), 3u);
+    BOOST_CHECK(r.empty());
+}
+
+BOOST_AUTO_TEST_CASE(Url_classifier_release)
+{
+    Url_classifier c(2);
+    c.push(url("a.example.com", "/1"));
+    c.push(url("b.example.com", "/1"));
+    c.push(url("a.example.com", "/2"));
+    c.push(url("c.example.com", "/1"));
+    BOOST_CHECK_EQUAL(c.q_len(0), 2u);
+    BOOST_CHECK_EQUAL(c.q_len(1), 1u);
+    BOOST_CHECK_EQUAL(c.q_len_top(), 1u);
+
+    // the urls of a retired handle go back to be classified again, none is lost
+    c.release(1);
+    BOOST_CHECK_THROW(c.q_len(1), runtime_error);
+    BOOST_CHECK_EQUAL(c.q_len_top(), 2u);
+    BOOST_CHECK_EQUAL(c.size(), 4u);
+    // releasing it again, or one that never existed, does nothing
+    c.release(1);
+    c.release(7);
+    BOOST_CHECK_EQUAL(c.size(), 4u);
+
+    // a queue is created again when it's asked for, with a whole group from the top queue
+    BOOST_CHECK_EQUAL(c.peek(1).url.host(), "c.example.com");
+    BOOST_CHECK_EQUAL(c.q_len(1), 1u);
+    BOOST_CHECK_EQUAL(c.q_len_top(), 1u);
+    c.pop(1);
+    BOOST_CHECK_EQUAL(c.peek(1).url.host(), "b.example.com");
+    c.pop(1);
+    BOOST_CHECK(c.empty(1));
+
+    BOOST_CHECK_EQUAL(c.peek(0).url.get(), "http://a.example.com/1");
+    c.pop(0);
+    BOOST_CHECK_EQUAL(c.peek(0).url.get(), "http://a.example.com/2");
+    c.pop(0);
+    BOOST_CHECK(c.empty());
+    BOOST_CHECK_EQUAL(c.size(), 0u);
+    BOOST_CHECK_THROW(c.peek(0), runtime_error);
+
+    // releasing a handle whose queue is empty loses nothing either
+    c.release(0);
+    BOOST_CHECK(c.empty());
+    c.push(url("d.example.com", "/1"));
+    BOOST_CHECK_EQUAL(c.q_len(1), 1u);
+}
+/// @}
@@ -0,0 +1,135 @@
+#include <boost/test/unit_test.hpp>
+
+#include <cctype>
+#include <random>
+#include <string>
+#include "Url.hh"
+#include "Url_char_class.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ *
+ * Differential tests of the vectorized escaping against byte at a time references.
+ */
+using namespace std;
+using namespace Url_util;
+
+namespace {
+
+const size_t ITERATIONS = 20000;
+
+/// Mostly clean chars so that runs are long, with the ones that get escaped here and there
+const string CLEAN_CHARS = "abcxyzABCXYZ0189-._~/";
+const char DIRTY[] = "%%%:/?#[]@!$&'()*+,;= \"<>\\^`{|}\t\x7f\x80\xc3\xff\0";
+const string DIRTY_CHARS(DIRTY, sizeof(DIRTY) - 1);
+
+struct Fuzzer {
+    Fuzzer() : rng(4321) {}
+
+    size_t uniform(size_t n) { return rng() % n; }
+
+    string str(size_t max_len)
+    {
+        string res;
+        size_t len = uniform(max_len + 1);
+        size_t dirty = uniform(4) ? uniform(20) + 1 : 1000;
+        for (size_t i = 0; i < len; ++i) {
+            if (uniform(dirty) == 0)
+                res.push_back(DIRTY_CHARS[uniform(DIRTY_CHARS.size())]);
+            else if (uniform(8) == 0)
+                res.push_back("0123456789abcdefABCDEFg"[uniform(23)]);
+            else
+                res.push_back(CLEAN_CHARS[uniform(CLEAN_CHARS.size())]);
+        }
+        return res;
+    }
+
+    mt19937 rng;
+};
+
+bool valid_escape(const string& s, size_t i)
+{
+    return s[i] == '%' && i + 2 < s.size() && isxdigit((unsigned char)s[i+1]) && isxdigit((unsigned char)s[i+2]);
+}
+
+char hex(char c)
+{
+    return "0123456789ABCDEF"[c & 0xF];
+}
+
+string ref_escape(const string& s, unsigned char mask)
+{
+    string res;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (! url_char_test(s[i], mask)) {
+            res += s[i];
+        } else if (valid_escape(s, i)) {
+            res += s.substr(i, 3);
+            i += 2;
+        } else {
+            res += '%';
+            res += hex((unsigned char)s[i] >> 4);
+            res += hex(s[i]);
+        }
+    }
+    return res;
+}
+
+/// decode is -1 for every escape, 1 for those in mask, 0 for those not in mask
+string ref_unescape(const string& s, unsigned char mask, int decode)
+{
+    string res;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (valid_escape(s, i)) {
+            char c = (char)strtol(s.substr(i + 1, 2).c_str(), 0, 16);
+            if (decode < 0 || !! url_char_test(c, mask) == !! decode) {
+                res += c;
+                i += 2;
+                continue;
+            }
+        }
+        res += s[i];
+    }
+    return res;
+}
+
+} // end anon ns
+
+
+BOOST_AUTO_TEST_CASE(Url_escape_char_class)
+{
+    const Char_class::Impl impls[] = { Char_class::SCALAR, Char_class::SSSE3, Char_class::AVX2 };
+    Fuzzer f;
+    for (size_t i = 0; i < ITERATIONS; ++i) {
+        const string s = f.str(100);
+        const unsigned char mask = f.uniform(128);
+        const Char_class& cls = Char_class::of(mask);
+        size_t expected = 0;
+        while (expected < s.size() && ! cls.test(s[expected]))
+            ++expected;
+        BOOST_CHECK_EQUAL(cls.find(s.data(), s.size()), expected);
+        for (size_t j = 0; j < sizeof(impls) / sizeof(impls[0]); ++j)
+            if (Char_class::supported(impls[j]))
+                BOOST_CHECK_EQUAL(cls.find(s.data(), s.size(), impls[j]), expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Url_escape_differential)
+{
+    const unsigned char masks[] = { URL_CHAR_RESERVED, URL_CHAR_UNSAFE, URL_CHAR_AUTH, URL_CHAR_PATH,
+        URL_CHAR_QUERY, URL_CHAR_FRAGMENT, URL_CHAR_RESERVED|URL_CHAR_UNSAFE };
+    Fuzzer f;
+    for (size_t i = 0; i < ITERATIONS; ++i) {
+        const string s = f.str(80);
+        const unsigned char mask = masks[f.uniform(sizeof(masks))];
+        BOOST_CHECK_EQUAL(Url::escape(s, mask), ref_escape(s, mask));
+        BOOST_CHECK_EQUAL(Url::unescape(s), ref_unescape(s, 0, -1));
+        BOOST_CHECK_EQUAL(Url::unescape(s, mask), ref_unescape(s, mask, 1));
+        BOOST_CHECK_EQUAL(Url::unescape_not(s, mask), ref_unescape(s, mask, 0));
+        BOOST_CHECK_EQUAL(Url::unescape_safe(s), ref_unescape(s, URL_CHAR_RESERVED|URL_CHAR_UNSAFE, 0));
+    }
+    BOOST_CHECK_EQUAL(Url::escape("/a b/%41%zz", URL_CHAR_PATH), "/a%20b/%41%25zz");
+    BOOST_CHECK_EQUAL(Url::unescape_safe("%41%2F%4"), "A%2F%4");
+}
+/// @}
@@ -0,0 +1,159 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/regex.hpp>
+
+#include <random>
+#include <string>
+#include "Url.hh"
+
+/**
+ * @addtogroup unit_tests
+ * @{
+ *
+ * Differential tests of the hand written url parser against the reference regexps.
+ */
+using namespace std;
+using namespace Url_util;
+
+namespace {
+
+const size_t ITERATIONS = 20000;
+
+/// Chars that are meaningful somewhere in an url, plus some that aren't allowed anywhere
+const string URL_CHARS = "abcvxyzABCFV019:/?#[]@.%-+_~!$&'()*,;= \t\n\x80\xff";
+const string HOST_CHARS = "abvAF0123456789.-:_~";
+const string HEX_CHARS = "0123456789abcdefABCDEFg";
+
+struct Fuzzer {
+    Fuzzer() : rng(1234) {}
+
+    size_t uniform(size_t n) { return rng() % n; }
+
+    string from(const string& alphabet, size_t max_len)
+    {
+        string res;
+        size_t len = uniform(max_len + 1);
+        for (size_t i = 0; i < len; ++i)
+            res.push_back(alphabet[uniform(alphabet.size())]);
+        return res;
+    }
+
+    string octet()
+    {
+        switch (uniform(4)) {
+            case 0: return to_string(uniform(10));
+            case 1: return to_string(uniform(300));
+            case 2: return "0" + to_string(uniform(100));
+            default: return from("0123456789", 4);
+        }
+    }
+
+    string ipv4()
+    {
+        string res = octet();
+        size_t n = uniform(8) ? 3 : uniform(5);
+        for (size_t i = 0; i < n; ++i)
+            res += "." + octet();
+        return res;
+    }
+
+    string ipv6()
+    {
+        size_t groups = uniform(10);
+        size_t dcolon = uniform(3) ? uniform(groups + 1) : groups + 1;
+        string res;
+        for (size_t i = 0; i <= groups; ++i) {
+            if (i == dcolon)
+                res += uniform(10) ? "::" : ":::";
+            else if (i)
+                res += ":";
+            if (i == groups)
+                break;
+            res += (i + 1 == groups && uniform(4) == 0) ? ipv4() : from(HEX_CHARS, 5);
+        }
+        if (uniform(8) == 0 && ! res.empty())
+            res[uniform(res.size())] = HOST_CHARS[uniform(HOST_CHARS.size())];
+        return res;
+    }
+
+    mt19937 rng;
+};
+
+bool same(const boost::ssub_match& m, const Url_split::Part& p)
+{
+    return m.matched == p.matched && (! m.matched || m.str() == p.str());
+}
+
+void check(const char* what, const string& s, bool expected, bool got)
+{
+    if (expected != got)
+        BOOST_ERROR(what << " differs on '" << s << "' regex: " << expected << " parser: " << got);
+}
+
+} // end anon ns
+
+
+BOOST_AUTO_TEST_CASE(Url_parser_split)
+{
+    const boost::regex re(url_regex[RE_URL], boost::regex_constants::perl);
+    Fuzzer f;
+    for (size_t i = 0; i < ITERATIONS; ++i) {
+        const string s = f.from(URL_CHARS, 24);
+        boost::smatch m;
+        BOOST_REQUIRE(boost::regex_match(s, m, re));
+        Url_split parts;
+        split(s.data(), s.size(), parts);
+        // groups: 2 scheme, 4 authority, 5 path, 6 query, 7 fragment
+        if (! (same(m[2], parts.scheme) && same(m[4], parts.authority) && same(m[5], parts.path)
+            && same(m[6], parts.query) && same(m[7], parts.fragment)))
+            BOOST_ERROR("split differs on '" << s << "'");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Url_parser_validators)
+{
+    const boost::regex scheme_re(url_regex[RE_SCHEME]);
+    const boost::regex host_re(url_regex[RE_HOST]);
+    const boost::regex port_re(url_regex[RE_PORT]);
+    const boost::regex ipvfut_re(url_regex[RE_IPVFUT]);
+    const boost::regex ipv6_re(url_regex[RE_IPV6]);
+    const boost::regex ipv4_re(url_regex[RE_IPV4]);
+    Fuzzer f;
+    for (size_t i = 0; i < ITERATIONS; ++i) {
+        string s = f.from(URL_CHARS, 8);
+        check("scheme", s, boost::regex_match(s, scheme_re), is_scheme(s.data(), s.size()));
+
+        s = f.from(HOST_CHARS, 12);
+        check("host", s, boost::regex_match(s, host_re), is_reg_name(s.data(), s.size()));
+
+        s = f.from("0123456789a", 7);
+        check("port", s, boost::regex_match(s, port_re), is_port(s.data(), s.size()));
+
+        s = (f.uniform(2) ? "v" : "") + f.from("aF9.1:-~!x/[", 6);
+        check("ipvfuture", s, boost::regex_match(s, ipvfut_re), is_ipvfuture(s.data(), s.size()));
+
+        s = f.ipv4();
+        check("ipv4", s, boost::regex_match(s, ipv4_re), is_ipv4(s.data(), s.size()));
+
+        s = f.ipv6();
+        check("ipv6", s, boost::regex_match(s, ipv6_re), is_ipv6(s.data(), s.size()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Url_parser_hosts)
+{
+    BOOST_CHECK(is_ipv6("::", 2));
+    BOOST_CHECK(is_ipv6("::1", 3));
+    BOOST_CHECK(is_ipv6("fe80::202:3fff:feb7:e652", 24));
+    BOOST_CHECK(is_ipv6("1:2:3:4:5:6:7:8", 15));
+    BOOST_CHECK(is_ipv6("::ffff:10.0.0.1", 15));
+    BOOST_CHECK(! is_ipv6("1:2:3:4:5:6:7:8:9", 17));
+    BOOST_CHECK(! is_ipv6("1::2::3", 7));
+    BOOST_CHECK(! is_ipv6("1:2:3:4:5:6:7::8", 16));
+    BOOST_CHECK(is_ipv4("192.168.0.255", 13));
+    BOOST_CHECK(! is_ipv4("192.168.0.256", 13));
+    BOOST_CHECK(! is_ipv4("1.2.3", 5));
+    BOOST_CHECK(is_reg_name("www.example.com.", 16));
+    BOOST_CHECK(! is_reg_name("-example.com", 12));
+    BOOST_CHECK(! is_reg_name("example-", 8));
+}
+/// @}
@@ -1,6 +1,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <iostream>
+#include <unordered_set>
 #include "Url.hh"
 
 /**
@@ -181,4 +182,52 @@ BOOST_AUTO_TEST_CASE(Url_test_compare)
     test_size("http://note@domo.com/a/../b/");
     test_size("http://note@domo.com/hello_cat");
 }
+
+BOOST_AUTO_TEST_CASE(Url_test_normalize)
+{
+    Url u("HTTP://Us%65r@WwW.Ex%41mple.COM:8080/%7euser/./a/../b%2f?q=%7e%2a#%7e");
+    BOOST_CHECK(! u.normalized());
+    u.normalize();
+    BOOST_CHECK(u.normalized());
+    BOOST_CHECK_EQUAL(u.get(), "http://User@www.example.com:8080/~user/b%2F?q=~*#~");
+
+    // already normalized, a noop
+    u.normalize();
+    BOOST_CHECK_EQUAL(u.get(), "http://User@www.example.com:8080/~user/b%2F?q=~*#~");
+
+    u.query("?r=%7e");
+    BOOST_CHECK(! u.normalized());
+    u.normalize();
+    BOOST_CHECK_EQUAL(u.get(), "http://User@www.example.com:8080/~user/b%2F?r=~#~");
+}
+
+BOOST_AUTO_TEST_CASE(Url_test_fingerprint)
+{
+    Url a("HTTP://WWW.Example.com/a/../%7euser?q");
+    Url b("http://www.example.com/~user?q");
+    // the fingerprint is the one of the normalized url, normalizing doesn't change it
+    const uint64_t fp = a.fingerprint();
+    BOOST_CHECK_EQUAL(fp, b.fingerprint());
+    a.normalize();
+    BOOST_CHECK_EQUAL(fp, a.fingerprint());
+    BOOST_CHECK(a == b);
+
+    // modifying the url invalidates it
+    b.query("?r");
+    BOOST_CHECK(fp != b.fingerprint());
+    BOOST_CHECK(a != b);
+    b.query("?q");
+    BOOST_CHECK_EQUAL(fp, b.fingerprint());
+
+    // urls that aren't normalized are compared as if they were
+    BOOST_CHECK(Url("HTTP://WWW.Example.com/a/../%7euser?q") == b);
+    BOOST_CHECK(Url("http://www.example.com/%7Euser?q") == Url("http://WWW.example.com/~user?q"));
+    BOOST_CHECK(Url("http://www.example.com/~user?q") != Url("http://www.example.com/~user?r"));
+
+    unordered_set<Url> seen;
+    BOOST_CHECK(seen.insert(a).second);
+    BOOST_CHECK(! seen.insert(b).second);
+    BOOST_CHECK(seen.insert(Url("http://www.example.com/~user")).second);
+    BOOST_CHECK_EQUAL(seen.size(), 2u);
+}
 /// @}
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Generates src/html_lexer/html5_entities.inc, the table of HTML5 named character references with a
+minimal perfect hash, from the WHATWG entities.json (https://html.spec.whatwg.org/entities.json)
+or, if no file is given, from the copy in the python standard library.
+
+Only the names terminated by ';' are included, the lexer doesn't decode the legacy ones without
+it. The names are placed with the minimal perfect hash of perfect_hash.py.
+
+Usage: gen_html_entities.py [entities.json] > src/html_lexer/html5_entities.inc
+"""
+import json
+import sys
+
+from perfect_hash import perfect_hash
+
+__author__ = 'Pedro Larroy'
+__version__ = '1.0'
+
+
+def read_entities(path):
+    """@return dict of name without '&' and ';' to its utf8 bytes"""
+    if path:
+        with open(path) as f:
+            entities = dict((k.lstrip('&'), v['characters']) for k, v in json.load(f).items())
+    else:
+        import html.entities
+        entities = html.entities.html5
+    return dict((k[:-1].encode('ascii'), v.encode('utf-8')) for k, v in entities.items() if k.endswith(';'))
+
+
+def c_string(data):
+    res = []
+    for c in bytearray(data):
+        if c in (ord('"'), ord('\\')) or not 32 <= c < 127:
+            res.append('\\%03o' % c)
+        else:
+            res.append(chr(c))
+    return '"' + ''.join(res) + '"'
+
+
+def main():
+    args = sys.argv[1:]
+    if len(args) > 1:
+        print(__doc__, file=sys.stderr)
+        return 1
+    entities = read_entities(args[0] if args else None)
+    displacements, slots = perfect_hash(sorted(entities))
+    assert max(len(v) for v in entities.values()) < 7
+
+    print('// Generated by utils/gen_html_entities.py from the WHATWG list of named character references, do not edit.')
+    print('// %d entities' % len(slots))
+    print('const size_t ENTITY_COUNT = %d;' % len(slots))
+    print()
+    print('/// displacement of each bucket, the slot itself as -slot - 1 if negative')
+    print('const int16_t ENTITY_DISPLACEMENTS[ENTITY_COUNT] = {')
+    for i in range(0, len(displacements), 16):
+        print('    ' + ' '.join('%d,' % d for d in displacements[i:i + 16]))
+    print('};')
+    print()
+    print('/// names without \'&\' and \';\', in slot order')
+    print('const char ENTITY_NAMES[] =')
+    line = ''
+    for name in slots:
+        if len(line) + len(name) > 100:
+            print('    "%s"' % line)
+            line = ''
+        line += name.decode('ascii')
+    print('    "%s";' % line)
+    print()
+    print('/// offset and length of the name, utf8')
+    print('const Entity ENTITIES[ENTITY_COUNT] = {')
+    offset = 0
+    for name in slots:
+        print('    {%d, %d, %d, %s},' % (offset, len(name), len(entities[name]), c_string(entities[name])))
+        offset += len(name)
+    print('};')
+    assert offset < 65536
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,67 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+"""
+Generates src/html_lexer/html_tags.inc, the element names known to the lexer with a minimal perfect
+hash to map them to html_tag::tag_t.
+
+The file has two parts: with HTML_TAG defined it expands to HTML_TAG(ID, "name") for every tag,
+in enum order, otherwise it defines the hash tables for html_tag::lookup.
+
+Usage: gen_html_tags.py > src/html_lexer/html_tags.inc
+"""
+from __future__ import print_function
+import sys
+
+from perfect_hash import perfect_hash
+
+__author__ = 'Pedro Larroy'
+__version__ = '1.0'
+
+# HTML5 elements, plus the obsolete ones that are still found in the wild
+TAGS = '''
+    a abbr acronym address applet area article aside audio b base basefont bdi bdo big blink
+    blockquote body br button canvas caption center cite code col colgroup data datalist dd del
+    details dfn dialog dir div dl dt em embed fieldset figcaption figure font footer form frame
+    frameset h1 h2 h3 h4 h5 h6 head header hgroup hr html i iframe img input ins kbd label legend li
+    link main map mark marquee math menu meta meter nav nobr noembed noframes noscript object ol
+    optgroup option output p param picture plaintext pre progress q rp rt ruby s samp script search
+    section select slot small source span strike strong style sub summary sup svg table tbody td
+    template textarea tfoot th thead time title tr track tt u ul var video wbr xmp
+'''.split()
+
+
+def main():
+    if len(sys.argv) != 1:
+        print(__doc__, file=sys.stderr)
+        return 1
+    tags = sorted(TAGS)
+    # tag_t values, 0 is UNKNOWN
+    ids = dict((tag, i + 1) for i, tag in enumerate(tags))
+    displacements, slots = perfect_hash([tag.encode('ascii') for tag in tags])
+    assert len(tags) < 256
+
+    print('// Generated by utils/gen_html_tags.py, do not edit.')
+    print('// %d tags' % len(tags))
+    print('#ifdef HTML_TAG')
+    for tag in tags:
+        print('HTML_TAG(%s, "%s")' % (tag.upper(), tag))
+    print('#else')
+    print('const size_t TAG_COUNT = %d;' % len(tags))
+    print()
+    print('/// displacement of each bucket, the slot itself as -slot - 1 if negative')
+    print('const int16_t TAG_DISPLACEMENTS[TAG_COUNT] = {')
+    for i in range(0, len(displacements), 16):
+        print('    ' + ' '.join('%d,' % d for d in displacements[i:i + 16]))
+    print('};')
+    print()
+    print('/// tag_t in each slot')
+    print('const uint8_t TAG_SLOTS[TAG_COUNT] = {')
+    for i in range(0, len(slots), 16):
+        print('    ' + ' '.join('%d,' % ids[tag.decode('ascii')] for tag in slots[i:i + 16]))
+    print('};')
+    print('#endif')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+"""
+Generates src/common/public_suffix_rules.inc from the public suffix list
+(https://publicsuffix.org/list/public_suffix_list.dat).
+
+Only the ICANN section is used, private registrations like blogspot.com are served by the same
+operator so for politeness they are better grouped under their registered domain. The whole ICANN
+section is embedded. With --subset the table is smaller but coarser: only the top level rules, and
+for the country codes in SECOND_LEVEL the rules with two labels, plus the wildcards and exceptions,
+so that for instance every host under ayabe.kyoto.jp would share the registered domain
+ayabe.kyoto.jp.
+
+Usage: gen_public_suffix.py [--subset] public_suffix_list.dat > src/common/public_suffix_rules.inc
+"""
+from __future__ import print_function
+import codecs
+import sys
+
+__author__ = 'Pedro Larroy'
+__version__ = '1.0'
+
+# country codes where registrations are usually under a second level like co.uk
+SECOND_LEVEL = set('''
+    ar au br cn co hk id il in jp kr mx my ng nz pe ph pk sg th tr tw ua uk uy ve vn za
+'''.split())
+
+
+def to_ascii(rule):
+    """idna encode the labels, the hosts we get are already in punycode"""
+    prefix = ''
+    if rule[0] in '!':
+        prefix, rule = rule[0], rule[1:]
+    labels = []
+    for label in rule.split('.'):
+        if label == '*':
+            labels.append(label)
+        else:
+            labels.append(label.encode('idna').decode('ascii'))
+    return prefix + '.'.join(labels).lower()
+
+
+def wanted(rule, everything):
+    if everything or rule[0] in '*!':
+        return True
+    labels = rule.split('.')
+    return len(labels) == 1 or (len(labels) == 2 and labels[-1] in SECOND_LEVEL)
+
+
+def read_rules(path, everything):
+    rules = set()
+    icann = False
+    with codecs.open(path, 'r', 'utf-8') as f:
+        for line in f:
+            line = line.strip()
+            if '===BEGIN ICANN DOMAINS===' in line:
+                icann = True
+            elif '===END ICANN DOMAINS===' in line:
+                icann = False
+            if not icann or not line or line.startswith('//'):
+                continue
+            try:
+                rule = to_ascii(line.split()[0])
+            except UnicodeError:
+                continue
+            if wanted(rule, everything):
+                rules.add(rule)
+    return sorted(rules)
+
+
+def main():
+    args = sys.argv[1:]
+    everything = '--subset' not in args
+    args = [a for a in args if a != '--subset']
+    if len(args) != 1:
+        print(__doc__, file=sys.stderr)
+        return 1
+    rules = read_rules(args[0], everything)
+    print('// Generated by utils/gen_public_suffix.py from the public suffix list, do not edit.')
+    print('// The list is subject to the Mozilla Public License, v. 2.0: https://mozilla.org/MPL/2.0/')
+    print('// %d rules, sorted so that they can be binary searched' % len(rules))
+    for rule in rules:
+        print('"%s",' % rule)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
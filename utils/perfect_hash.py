@@ -0,0 +1,57 @@
+# -*- coding: utf-8 -*-
+"""
+Minimal perfect hashing of a fixed set of keys, for the tables generated into the sources.
+
+The hash is FNV-1a seeded by a per bucket displacement (hash and displace): the first hash picks a
+bucket, and the displacement of the bucket either seeds a second hash that gives the slot or, if
+negative, is the slot itself. src/html_lexer/perfect_hash.hh must hash the same way.
+"""
+
+__author__ = 'Pedro Larroy'
+__version__ = '1.0'
+
+FNV_OFFSET = 0x811c9dc5
+FNV_PRIME = 0x01000193
+MASK = 0xffffffff
+
+
+def fnv(key, seed):
+    """@param key bytes"""
+    h = (FNV_OFFSET ^ seed) & MASK
+    for c in bytearray(key):
+        h = ((h ^ c) * FNV_PRIME) & MASK
+    return h
+
+
+def perfect_hash(keys):
+    """@return (displacements, slots) with keys[i] at slots[lookup(keys[i])], both as long as keys"""
+    n = len(keys)
+    buckets = [[] for _ in range(n)]
+    for key in keys:
+        buckets[fnv(key, 0) % n].append(key)
+    order = sorted(range(n), key=lambda b: len(buckets[b]), reverse=True)
+
+    displacements = [0] * n
+    slots = [None] * n
+    for b in order:
+        if len(buckets[b]) <= 1:
+            break
+        seed = 1
+        while True:
+            taken = [fnv(key, seed) % n for key in buckets[b]]
+            if len(set(taken)) == len(taken) and all(slots[i] is None for i in taken):
+                break
+            seed += 1
+        displacements[b] = seed
+        for key, i in zip(buckets[b], taken):
+            slots[i] = key
+
+    free = [i for i in range(n) if slots[i] is None]
+    for b in order:
+        if len(buckets[b]) != 1:
+            continue
+        i = free.pop()
+        displacements[b] = -i - 1
+        slots[i] = buckets[b][0]
+    assert all(-32768 <= d < 32768 for d in displacements)
+    return displacements, slots